@@ -119,10 +119,8 @@ public:
             } else if (a.type == MESSAGE) {
                 unique_lock<mutex> lock(m_connection_lock);
 
-                con_list::iterator it;
-                for (it = m_connections.begin(); it != m_connections.end(); ++it) {
-                    m_server.send(*it,a.msg);
-                }
+                m_server.broadcast(m_connections.begin(),m_connections.end(),
+                    a.msg);
             } else {
                 // undefined.
             }
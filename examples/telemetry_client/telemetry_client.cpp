@@ -134,7 +134,18 @@ public:
             val.str("this is a fixed message");
 
             m_client.get_alog().write(websocketpp::log::alevel::app, val.str());
-            m_client.send(m_hdl,val.str(),websocketpp::frame::opcode::text,ec);
+
+            // Only the latest reading matters. Tagging it with a conflation
+            // key lets it replace an older reading that is still waiting in
+            // the send queue if the connection falls behind.
+            client::connection_ptr con = m_client.get_con_from_hdl(m_hdl,ec);
+            if (!ec) {
+                client::message_ptr msg = con->get_message(
+                    websocketpp::frame::opcode::text,val.str().size());
+                msg->set_payload(val.str());
+                msg->set_conflation_key("count");
+                ec = con->send(msg);
+            }
 
             // The most likely error that we will get is that the connection is
             // not in the right state. Usually this means we tried to send a
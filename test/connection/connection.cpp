@@ -30,6 +30,9 @@
 
 #include "connection_tu2.hpp"
 
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+#include <websocketpp/http/view_request.hpp>
+
 // NOTE: these tests currently test against hardcoded output values. I am not
 // sure how problematic this will be. If issues arise like order of headers the
 // output should be parsed by http::response and have values checked directly
@@ -113,6 +116,12 @@ void http_func(server* s, websocketpp::connection_hdl hdl) {
     con->set_status(websocketpp::http::status_code::ok);
 }
 
+void echo_view_func(server* s, websocketpp::connection_hdl hdl,
+    websocketpp::message_buffer::message_view const & view)
+{
+    s->send(hdl, view.payload, view.length, view.opcode);
+}
+
 BOOST_AUTO_TEST_CASE( connection_extensions ) {
     connection_setup env(true);
 
@@ -134,6 +143,269 @@ BOOST_AUTO_TEST_CASE( basic_websocket_request ) {
     BOOST_CHECK(run_server_test(s,input) == output);
 }
 
+BOOST_AUTO_TEST_CASE( zero_copy_echo ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string output = "HTTP/1.1 101 Switching Protocols\r\nConnection: upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\nServer: ";
+    output+=websocketpp::user_agent;
+    output+="\r\nUpgrade: websocket\r\n\r\n";
+
+    unsigned char frames[8] = {0x82,0x82,0xFF,0xFF,0xFF,0xFF,0xD5,0xD5};
+    input.append(reinterpret_cast<char*>(frames),8);
+    output+="\x82\x02**";
+
+	server s;
+	s.set_message_view_handler(bind(&echo_view_func,&s,::_1,::_2));
+
+    BOOST_CHECK_EQUAL(run_server_test(s,input), output);
+}
+
+void record_chunk_func(std::string * log, websocketpp::connection_hdl hdl,
+    websocketpp::message_buffer::message_chunk const & chunk)
+{
+    std::stringstream s;
+    s << chunk.sequence << "/" << chunk.offset << "/" << chunk.fin << ":"
+      << std::string(chunk.payload,chunk.length) << ";";
+    *log += s.str();
+}
+
+BOOST_AUTO_TEST_CASE( streaming_receive ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string output = "HTTP/1.1 101 Switching Protocols\r\nConnection: upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\nServer: ";
+    output+=websocketpp::user_agent;
+    output+="\r\nUpgrade: websocket\r\n\r\n";
+
+    // "abc" + ping + "de" as one fragmented text message, then "f"
+    unsigned char frames[36] = {0x01,0x83,0x00,0x00,0x00,0x00,'a','b','c',
+                                0x89,0x80,0x00,0x00,0x00,0x00,
+                                0x80,0x82,0x00,0x00,0x00,0x00,'d','e',
+                                0x81,0x81,0x00,0x00,0x00,0x00,'f',
+                                0x82,0x80,0x00,0x00,0x00,0x00};
+    input.append(reinterpret_cast<char*>(frames),36);
+    output+="\x8A";
+    output.append(1,'\0');
+
+    std::string log;
+	server s;
+	s.set_message_handler(bind(&echo_func,&s,::_1,::_2));
+	s.set_message_chunk_handler(bind(&record_chunk_func,&log,::_1,::_2));
+
+    BOOST_CHECK_EQUAL(run_server_test(s,input), output);
+    BOOST_CHECK_EQUAL(log, "0/0/0:abc;0/3/1:de;1/0/1:f;2/0/1:;");
+}
+
+void stream_reply_func(server* s, websocketpp::connection_hdl hdl,
+    message_ptr msg)
+{
+    server::connection_ptr con = s->get_con_from_hdl(hdl);
+
+    BOOST_CHECK( !con->send_stream_begin(websocketpp::frame::opcode::text) );
+    BOOST_CHECK_EQUAL( con->send_stream_begin(),
+        websocketpp::error::send_stream_active );
+    BOOST_CHECK( !con->send_stream_append(std::string("ab")) );
+    // the codepoint is split between two frames
+    BOOST_CHECK( !con->send_stream_append(std::string("\xC3")) );
+    BOOST_CHECK_EQUAL( con->send_stream_end(),
+        websocketpp::error::invalid_utf8 );
+    BOOST_CHECK_EQUAL( con->send(std::string("x")),
+        websocketpp::error::send_stream_active );
+    con->ping("p");
+    BOOST_CHECK( !con->send_stream_append(std::string("\xA9" "cd")) );
+    BOOST_CHECK( !con->send_stream_end() );
+
+    // whole messages may be sent again
+    BOOST_CHECK( !con->send(std::string("x")) );
+    BOOST_CHECK_EQUAL( con->send_stream_append(std::string("y")),
+        websocketpp::processor::error::invalid_continuation );
+
+    // a stream without appends is a single empty frame
+    BOOST_CHECK( !con->send_stream_begin() );
+    BOOST_CHECK( !con->send_stream_end() );
+}
+
+void stream_abort_func(server* s, websocketpp::connection_hdl hdl,
+    message_ptr msg)
+{
+    server::connection_ptr con = s->get_con_from_hdl(hdl);
+
+    // nothing has been sent yet, so the stream is simply dropped
+    BOOST_CHECK( !con->send_stream_begin(websocketpp::frame::opcode::text) );
+    BOOST_CHECK( !con->send_stream_abort() );
+    BOOST_CHECK( !con->send(std::string("x")) );
+    BOOST_CHECK_EQUAL( con->send_stream_abort(),
+        websocketpp::processor::error::invalid_continuation );
+
+    // a text stream stuck in the middle of a codepoint closes with 1007
+    BOOST_CHECK( !con->send_stream_begin(websocketpp::frame::opcode::text) );
+    BOOST_CHECK( !con->send_stream_append(std::string("\xC3")) );
+    BOOST_CHECK_EQUAL( con->send_stream_end(),
+        websocketpp::error::invalid_utf8 );
+    BOOST_CHECK( !con->send_stream_abort() );
+    BOOST_CHECK_EQUAL( con->send(std::string("y")),
+        websocketpp::error::invalid_state );
+}
+
+BOOST_AUTO_TEST_CASE( streaming_send_abort ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string output = "HTTP/1.1 101 Switching Protocols\r\nConnection: upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\nServer: ";
+    output+=websocketpp::user_agent;
+    output+="\r\nUpgrade: websocket\r\n\r\n";
+
+    unsigned char frames[7] = {0x81,0x81,0x00,0x00,0x00,0x00,'a'};
+    input.append(reinterpret_cast<char*>(frames),7);
+    unsigned char reply[10] = {0x81,0x01,'x',
+                               0x01,0x01,0xC3,
+                               0x88,0x1A,0x03,0xEF};
+    output.append(reinterpret_cast<char*>(reply),10);
+    output+="Streamed message aborted";
+
+    server s;
+    s.set_message_handler(bind(&stream_abort_func,&s,::_1,::_2));
+
+    BOOST_CHECK_EQUAL(run_server_test(s,input), output);
+}
+
+BOOST_AUTO_TEST_CASE( streaming_send ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string output = "HTTP/1.1 101 Switching Protocols\r\nConnection: upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\nServer: ";
+    output+=websocketpp::user_agent;
+    output+="\r\nUpgrade: websocket\r\n\r\n";
+
+    unsigned char frames[7] = {0x81,0x81,0x00,0x00,0x00,0x00,'a'};
+    input.append(reinterpret_cast<char*>(frames),7);
+    unsigned char reply[22] = {0x01,0x02,'a','b',
+                               0x00,0x01,0xC3,
+                               0x89,0x01,'p',
+                               0x00,0x03,0xA9,'c','d',
+                               0x80,0x00,
+                               0x81,0x01,'x',
+                               0x82,0x00};
+    output.append(reinterpret_cast<char*>(reply),22);
+
+	server s;
+	s.set_message_handler(bind(&stream_reply_func,&s,::_1,::_2));
+
+    BOOST_CHECK_EQUAL(run_server_test(s,input), output);
+}
+
+BOOST_AUTO_TEST_CASE( max_message_size ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string output = "HTTP/1.1 101 Switching Protocols\r\nConnection: upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\nServer: ";
+    output+=websocketpp::user_agent;
+    output+="\r\nUpgrade: websocket\r\n\r\n";
+
+    // a 3 byte message against a 2 byte limit
+    unsigned char frames[9] = {0x82,0x83,0x00,0x00,0x00,0x00,'a','b','c'};
+    input.append(reinterpret_cast<char*>(frames),9);
+
+    server s;
+    s.set_message_handler(bind(&echo_func,&s,::_1,::_2));
+    s.set_max_message_size(2);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+
+    // close frame with status 1009 and a reason
+    std::string result = run_server_test(s,input);
+    BOOST_REQUIRE_GT( result.size(), output.size()+4 );
+    BOOST_CHECK_EQUAL( result.substr(0,output.size()), output );
+    BOOST_CHECK_EQUAL( result[output.size()], '\x88' );
+    BOOST_CHECK_EQUAL( result.substr(output.size()+2,2),
+        std::string("\x03\xF1") );
+}
+
+bool ping_func(std::string * log, websocketpp::connection_hdl hdl,
+    std::string payload)
+{
+    *log += payload + ";";
+    return payload != "no";
+}
+
+BOOST_AUTO_TEST_CASE( ping_pong ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string output = "HTTP/1.1 101 Switching Protocols\r\nConnection: upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\nServer: ";
+    output+=websocketpp::user_agent;
+    output+="\r\nUpgrade: websocket\r\n\r\n";
+
+    // pings "ab", "no" and "c"; the reused pong frame shrinks between them
+    unsigned char frames[23] = {0x89,0x82,0x00,0x00,0x00,0x00,'a','b',
+                                0x89,0x82,0x00,0x00,0x00,0x00,'n','o',
+                                0x89,0x81,0x00,0x00,0x00,0x00,'c'};
+    input.append(reinterpret_cast<char*>(frames),23);
+
+    std::string no_handler = output + "\x8A\x02" "ab\x8A\x02no\x8A\x01" "c";
+    output+="\x8A\x02" "ab\x8A\x01" "c";
+
+    server s1;
+    BOOST_CHECK_EQUAL(run_server_test(s1,input), no_handler);
+
+    // a ping handler still sees every payload and can suppress the pong
+    std::string log;
+    server s2;
+    s2.set_ping_handler(bind(&ping_func,&log,::_1,::_2));
+    BOOST_CHECK_EQUAL(run_server_test(s2,input), output);
+    BOOST_CHECK_EQUAL(log, "ab;no;c;");
+}
+
+BOOST_AUTO_TEST_CASE( multiple_message_echo ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string output = "HTTP/1.1 101 Switching Protocols\r\nConnection: upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\nServer: ";
+    output+=websocketpp::user_agent;
+    output+="\r\nUpgrade: websocket\r\n\r\n";
+
+    unsigned char frames[15] = {0x82,0x82,0xFF,0xFF,0xFF,0xFF,0xD5,0xD5,
+                                0x81,0x81,0xFF,0xFF,0xFF,0xFF,0xBE};
+    input.append(reinterpret_cast<char*>(frames),15);
+    output+="\x82\x02**\x81\x01" "A";
+
+	server s;
+	s.set_message_handler(bind(&echo_func,&s,::_1,::_2));
+
+    BOOST_CHECK_EQUAL(run_server_test(s,input), output);
+}
+
+BOOST_AUTO_TEST_CASE( broadcast_message ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string handshake = "HTTP/1.1 101 Switching Protocols\r\nConnection: upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\nServer: ";
+    handshake+=websocketpp::user_agent;
+    handshake+="\r\nUpgrade: websocket\r\n\r\n";
+
+    server s;
+    std::stringstream output;
+
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&output);
+
+    std::vector<server::connection_ptr> cons;
+    std::vector<websocketpp::connection_hdl> hdls;
+
+    for (int i = 0; i < 2; i++) {
+        server::connection_ptr con = s.get_connection();
+        con->start();
+
+        std::stringstream channel;
+        channel << input;
+        channel >> *con;
+
+        cons.push_back(con);
+        hdls.push_back(con->get_handle());
+    }
+
+    // handles to connections that no longer exist are skipped
+    hdls.push_back(websocketpp::connection_hdl());
+
+    BOOST_CHECK_EQUAL(s.broadcast(hdls.begin(),hdls.end(),"foo",
+        websocketpp::frame::opcode::text), 2);
+    BOOST_CHECK_EQUAL(output.str(), handshake + handshake + "\x81\x03" "foo"
+        "\x81\x03" "foo");
+
+    // invalid payloads are rejected before anything is queued
+    websocketpp::lib::error_code ec;
+    BOOST_CHECK_EQUAL(s.broadcast(hdls.begin(),hdls.end(),"\xFF",
+        websocketpp::frame::opcode::text,ec), 0);
+    BOOST_CHECK(ec);
+    BOOST_CHECK_EQUAL(output.str(), handshake + handshake + "\x81\x03" "foo"
+        "\x81\x03" "foo");
+}
+
 BOOST_AUTO_TEST_CASE( http_request ) {
     std::string input = "GET /foo/bar HTTP/1.1\r\nHost: www.example.com\r\nOrigin: http://www.example.com\r\n\r\n";
     std::string output = "HTTP/1.1 200 OK\r\nContent-Length: 8\r\nServer: ";
@@ -193,6 +465,624 @@ BOOST_AUTO_TEST_CASE( basic_client_websocket ) {
     BOOST_CHECK_EQUAL(ref, output.str());
 }
 
+struct view_request_config : public websocketpp::config::core {
+    typedef websocketpp::http::parser::view_request request_type;
+
+    struct transport_config : public core::transport_config {
+        typedef view_request_config::request_type request_type;
+    };
+    typedef websocketpp::transport::iostream::endpoint<transport_config>
+        transport_type;
+
+    struct permessage_deflate_config : public core::permessage_deflate_config {
+        typedef view_request_config::request_type request_type;
+    };
+    typedef websocketpp::extensions::permessage_deflate::disabled
+        <permessage_deflate_config> permessage_deflate_type;
+
+    struct mobile_signaling_config : public core::mobile_signaling_config {
+        typedef view_request_config::request_type request_type;
+    };
+    typedef websocketpp::extensions::mobile_signaling::disabled
+        <mobile_signaling_config> mobile_signaling_type;
+};
+
+typedef websocketpp::server<view_request_config> view_server;
+
+void view_echo_func(view_server* s, websocketpp::connection_hdl hdl,
+    view_server::message_ptr msg)
+{
+    s->send(hdl, msg);
+}
+
+BOOST_AUTO_TEST_CASE( view_request_echo ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string output = "HTTP/1.1 101 Switching Protocols\r\nConnection: upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\nServer: ";
+    output+=websocketpp::user_agent;
+    output+="\r\nUpgrade: websocket\r\n\r\n";
+
+    unsigned char frames[8] = {0x82,0x82,0xFF,0xFF,0xFF,0xFF,0xD5,0xD5};
+    input.append(reinterpret_cast<char*>(frames),8);
+    output+="\x82\x02**";
+
+    view_server s;
+    std::stringstream out;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&out);
+
+    view_server::connection_ptr con = s.get_connection();
+    con->set_message_handler(bind(&view_echo_func,&s,::_1,::_2));
+    con->start();
+
+    std::stringstream channel;
+    channel << input;
+    channel >> *con;
+
+    BOOST_CHECK_EQUAL(out.str(), output);
+    BOOST_CHECK_EQUAL(con->get_request_header("host"), "www.example.com");
+}
+
+struct lockfree_config : public websocketpp::config::core {
+    static const bool enable_lockfree_send_queue = true;
+};
+
+typedef websocketpp::server<lockfree_config> lockfree_server;
+
+void lockfree_send_func(lockfree_server::connection_ptr con, char id,
+    int count)
+{
+    for (int i = 0; i < count; i++) {
+        std::string payload(1,id);
+        payload += static_cast<char>(i);
+        con->send(payload,websocketpp::frame::opcode::binary);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( lockfree_send_queue ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+    std::string handshake = "HTTP/1.1 101 Switching Protocols\r\nConnection: upgrade\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\nServer: ";
+    handshake+=websocketpp::user_agent;
+    handshake+="\r\nUpgrade: websocket\r\n\r\n";
+
+    lockfree_server s;
+    std::stringstream output;
+
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&output);
+
+    lockfree_server::connection_ptr con = s.get_connection();
+    con->start();
+
+    std::stringstream channel;
+    channel << input;
+    channel >> *con;
+
+    int const num_threads = 4;
+    int const per_thread = 100;
+
+    std::vector<websocketpp::lib::shared_ptr<websocketpp::lib::thread> > threads;
+    for (int i = 0; i < num_threads; i++) {
+        threads.push_back(websocketpp::lib::shared_ptr<websocketpp::lib::thread>(
+            new websocketpp::lib::thread(bind(&lockfree_send_func,con,
+                static_cast<char>('a'+i),per_thread))));
+    }
+    for (int i = 0; i < num_threads; i++) {
+        threads[i]->join();
+    }
+
+    BOOST_CHECK_EQUAL(con->get_buffered_amount(), 0);
+
+    // Every message arrives exactly once and each thread's messages arrive in
+    // the order they were sent.
+    std::string out = output.str();
+    BOOST_REQUIRE_EQUAL(out.size(),
+        handshake.size() + num_threads * per_thread * 4);
+    BOOST_CHECK_EQUAL(out.substr(0,handshake.size()), handshake);
+
+    std::vector<int> next(num_threads,0);
+    for (size_t i = handshake.size(); i + 4 <= out.size(); i += 4) {
+        BOOST_REQUIRE_EQUAL(out[i], '\x82');
+        BOOST_REQUIRE_EQUAL(out[i+1], '\x02');
+
+        int id = out[i+2] - 'a';
+        BOOST_REQUIRE(id >= 0 && id < num_threads);
+        BOOST_CHECK_EQUAL(static_cast<int>(out[i+3]), next[id]);
+        next[id]++;
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        BOOST_CHECK_EQUAL(next[i], per_thread);
+    }
+}
+
+struct lazy_read_config : public websocketpp::config::core {
+    static const bool enable_lazy_read_buffer = true;
+};
+
+typedef websocketpp::server<lazy_read_config> lazy_read_server;
+
+void lazy_read_echo(lazy_read_server::connection_ptr con,
+    websocketpp::connection_hdl, lazy_read_server::message_ptr msg)
+{
+    con->send(msg->get_payload(),msg->get_opcode());
+}
+
+void lazy_read_feed(lazy_read_server::connection_ptr con,
+    std::string const & data)
+{
+    size_t p = 0;
+    while (p < data.size()) {
+        size_t n = con->read_some(data.data()+p,data.size()-p);
+        BOOST_REQUIRE(n > 0);
+        p += n;
+    }
+}
+
+BOOST_AUTO_TEST_CASE( lazy_read_buffer ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+
+    // 200 byte binary frame with an all zero masking key
+    std::string payload(200,'*');
+    std::string frame("\x82\xFE\x00\xC8\x00\x00\x00\x00",8);
+    frame += payload;
+    std::string echo("\x82\x7E\x00\xC8",4);
+    echo += payload;
+
+    size_t const probe = lazy_read_config::connection_read_probe_size;
+    size_t const full = lazy_read_config::connection_read_buffer_size;
+
+    lazy_read_server s;
+    std::stringstream output;
+
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&output);
+
+    lazy_read_server::connection_ptr con = s.get_connection();
+    con->set_message_handler(bind(&lazy_read_echo,con,
+        websocketpp::lib::placeholders::_1,websocketpp::lib::placeholders::_2));
+    con->start();
+
+    // the handshake is read into a borrowed buffer
+    BOOST_CHECK_EQUAL(con->get_read_buffer_size(), full);
+
+    // frame bytes that arrive with the handshake are processed from it
+    lazy_read_feed(con,input+frame);
+    BOOST_CHECK_EQUAL(con->get_read_buffer_size(), probe);
+    size_t handshake_size = output.str().size() - echo.size();
+    BOOST_CHECK_EQUAL(output.str().substr(handshake_size), echo);
+
+    // idle connections return the buffer to the pool
+    size_t cached = lazy_read_server::connection_type::read_buffer_pool::cached();
+    BOOST_CHECK(cached > 0);
+
+    // a frame larger than the probe borrows a buffer until it is complete
+    lazy_read_feed(con,frame.substr(0,probe));
+    BOOST_CHECK_EQUAL(con->get_read_buffer_size(), full);
+    BOOST_CHECK_EQUAL(
+        lazy_read_server::connection_type::read_buffer_pool::cached(),
+        cached-1);
+    lazy_read_feed(con,frame.substr(probe,10));
+    BOOST_CHECK_EQUAL(con->get_read_buffer_size(), full);
+    lazy_read_feed(con,frame.substr(probe+10));
+    BOOST_CHECK_EQUAL(con->get_read_buffer_size(), probe);
+    BOOST_CHECK_EQUAL(
+        lazy_read_server::connection_type::read_buffer_pool::cached(),
+        cached);
+
+    // several frames in one read
+    lazy_read_feed(con,frame+frame+frame);
+    BOOST_CHECK_EQUAL(con->get_read_buffer_size(), probe);
+    BOOST_CHECK_EQUAL(output.str().substr(handshake_size), echo+echo+echo+echo+echo);
+}
+
+struct release_handshake_config : public websocketpp::config::core {
+    static const bool release_handshake_state = true;
+};
+
+typedef websocketpp::server<release_handshake_config> release_handshake_server;
+
+void release_handshake_open(release_handshake_server::connection_ptr con,
+    std::string * host, websocketpp::connection_hdl)
+{
+    *host = con->get_request_header("Host");
+}
+
+BOOST_AUTO_TEST_CASE( release_handshake_state ) {
+    std::string input = "GET /chat HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Protocol: foo\r\nOrigin: http://www.example.com\r\n\r\n";
+
+    release_handshake_server s;
+    std::stringstream output;
+
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&output);
+
+    std::string host;
+    release_handshake_server::connection_ptr con = s.get_connection();
+    con->set_open_handler(bind(&release_handshake_open,con,&host,
+        websocketpp::lib::placeholders::_1));
+    con->start();
+
+    std::stringstream channel;
+    channel << input;
+    channel >> *con;
+
+    BOOST_CHECK_EQUAL(con->get_state(), websocketpp::session::state::open);
+
+    // available to the open handler, released afterwards
+    BOOST_CHECK_EQUAL(host, "www.example.com");
+    BOOST_CHECK_EQUAL(con->get_request_header("Host"), "");
+    BOOST_CHECK_EQUAL(con->get_response_header("Upgrade"), "");
+    BOOST_CHECK(con->get_requested_subprotocols().empty());
+
+    // the URI is kept
+    BOOST_CHECK_EQUAL(con->get_resource(), "/chat");
+
+    con->send(std::string("x"),websocketpp::frame::opcode::text);
+    std::string out = output.str();
+    BOOST_CHECK_EQUAL(out.substr(out.size()-3), "\x81\x01x");
+}
+
+/// stringbuf that runs a callback the next time something is written to it
+class callback_buf : public std::stringbuf {
+public:
+    websocketpp::lib::function<void()> on_write;
+protected:
+    std::streamsize xsputn(char const * s, std::streamsize n) {
+        std::streamsize ret = std::stringbuf::xsputn(s,n);
+        if (on_write) {
+            websocketpp::lib::function<void()> f = on_write;
+            on_write = websocketpp::lib::function<void()>();
+            f();
+        }
+        return ret;
+    }
+};
+
+void watermark_event(std::vector<std::string> * events, std::string event,
+    websocketpp::connection_hdl)
+{
+    events->push_back(event);
+}
+
+void watermark_send(server::connection_ptr con,
+    std::vector<std::string> * events)
+{
+    std::string payload(100,'*');
+    for (int i = 0; i < 5; i++) {
+        websocketpp::lib::error_code ec = con->send(payload,
+            websocketpp::frame::opcode::binary);
+        if (ec == websocketpp::error::send_queue_full) {
+            events->push_back("full");
+        }
+    }
+    events->push_back("buffered");
+}
+
+BOOST_AUTO_TEST_CASE( send_watermarks ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+
+    std::vector<std::string> events;
+    callback_buf buf;
+    std::ostream output(&buf);
+
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&output);
+    s.set_high_watermark_handler(bind(&watermark_event,&events,"high",::_1));
+    s.set_low_watermark_handler(bind(&watermark_event,&events,"low",::_1));
+
+    server::connection_ptr con = s.get_connection();
+    con->set_send_watermarks(250,100);
+    con->set_max_buffered_amount(450);
+    con->start();
+
+    std::stringstream channel;
+    channel << input;
+    channel >> *con;
+
+    // Messages sent while the first write is in progress stay buffered until
+    // it completes.
+    buf.on_write = bind(&watermark_send,con,&events);
+    BOOST_CHECK(!con->send(std::string("x"),websocketpp::frame::opcode::text));
+
+    std::vector<std::string> expected;
+    expected.push_back("high");
+    expected.push_back("full");
+    expected.push_back("buffered");
+    expected.push_back("low");
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(events.begin(),events.end(),
+        expected.begin(),expected.end());
+    BOOST_CHECK_EQUAL(con->get_buffered_amount(), 0);
+}
+
+struct deflate_config : public websocketpp::config::core {
+    typedef websocketpp::extensions::permessage_deflate::enabled
+        <permessage_deflate_config> permessage_deflate_type;
+};
+
+typedef websocketpp::server<deflate_config> deflate_server;
+typedef websocketpp::extensions::permessage_deflate::enabled
+    <deflate_config::permessage_deflate_config> deflate_type;
+
+/// Inflate the short unmasked frames a server wrote, in wire order
+std::vector<std::string> inflate_frames(std::string const & wire) {
+    deflate_type inflater;
+    inflater.init(false);
+
+    std::vector<std::string> messages;
+    size_t i = 0;
+    while (i + 2 <= wire.size()) {
+        bool compressed = (wire[i] & 0x40) != 0;
+        size_t len = static_cast<unsigned char>(wire[i+1]);
+        BOOST_REQUIRE(len < 126 && i + 2 + len <= wire.size());
+
+        std::string payload = wire.substr(i+2,len);
+        std::string out;
+        if (compressed) {
+            payload.append("\x00\x00\xff\xff",4);
+            websocketpp::lib::error_code ec = inflater.decompress(
+                reinterpret_cast<uint8_t const *>(payload.data()),
+                payload.size(),out);
+            BOOST_CHECK(!ec);
+        } else {
+            out = payload;
+        }
+        messages.push_back(out);
+        i += 2 + len;
+    }
+    return messages;
+}
+
+void deflate_priority_send(deflate_server::connection_ptr con) {
+    char const * payloads[3] = {"low low low low","high high high","normal"};
+    websocketpp::message_buffer::priority::value priorities[3] = {
+        websocketpp::message_buffer::priority::low,
+        websocketpp::message_buffer::priority::high,
+        websocketpp::message_buffer::priority::normal
+    };
+    for (int i = 0; i < 3; i++) {
+        deflate_server::message_ptr msg = con->get_message(
+            websocketpp::frame::opcode::text,32);
+        msg->set_payload(payloads[i]);
+        msg->set_priority(priorities[i]);
+        msg->set_compressed(true);
+        BOOST_CHECK( !con->send(msg) );
+    }
+
+    // uncompressed messages still jump the queue
+    deflate_server::message_ptr msg = con->get_message(
+        websocketpp::frame::opcode::text,6);
+    msg->set_payload("urgent");
+    msg->set_priority(websocketpp::message_buffer::priority::high);
+    BOOST_CHECK( !con->send(msg) );
+}
+
+BOOST_AUTO_TEST_CASE( deflate_priority_send_order ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Extensions: permessage-deflate\r\nOrigin: http://www.example.com\r\n\r\n";
+
+    callback_buf buf;
+    std::ostream output(&buf);
+
+    deflate_server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&output);
+
+    deflate_server::connection_ptr con = s.get_connection();
+    con->start();
+
+    std::stringstream channel;
+    channel << input;
+    channel >> *con;
+    size_t handshake_size = buf.str().size();
+    BOOST_CHECK(buf.str().find("permessage-deflate") != std::string::npos);
+
+    buf.on_write = bind(&deflate_priority_send,con);
+    BOOST_CHECK(!con->send(std::string("first first"),
+        websocketpp::frame::opcode::text));
+
+    std::vector<std::string> messages = inflate_frames(
+        buf.str().substr(handshake_size));
+
+    std::vector<std::string> expected;
+    expected.push_back("first first");
+    expected.push_back("urgent");
+    expected.push_back("low low low low");
+    expected.push_back("high high high");
+    expected.push_back("normal");
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(messages.begin(),messages.end(),
+        expected.begin(),expected.end());
+}
+
+void conflated_send(server::connection_ptr con, size_t * depth,
+    size_t * buffered)
+{
+    char const * updates[4][2] = {{"a","a1"},{"b","b1"},{"a","a2"},{"a","a3"}};
+    for (int i = 0; i < 4; i++) {
+        message_ptr msg = con->get_message(websocketpp::frame::opcode::text,2);
+        msg->set_payload(updates[i][1]);
+        msg->set_conflation_key(updates[i][0]);
+        BOOST_CHECK( !con->send(msg) );
+    }
+    *depth = con->get_send_queue_depth(websocketpp::message_buffer::lane::normal);
+    *buffered = con->get_buffered_amount();
+}
+
+BOOST_AUTO_TEST_CASE( conflated_send_queue ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+
+    callback_buf buf;
+    std::ostream output(&buf);
+
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&output);
+
+    server::connection_ptr con = s.get_connection();
+    con->start();
+
+    std::stringstream channel;
+    channel << input;
+    channel >> *con;
+    size_t handshake_size = buf.str().size();
+
+    // updates queued behind the first write collapse to one per key
+    size_t depth = 0;
+    size_t buffered = 0;
+    buf.on_write = bind(&conflated_send,con,&depth,&buffered);
+    BOOST_CHECK(!con->send(std::string("x"),websocketpp::frame::opcode::text));
+
+    BOOST_CHECK_EQUAL(depth, 2);
+    BOOST_CHECK_EQUAL(buffered, 4);
+    BOOST_CHECK_EQUAL(buf.str().substr(handshake_size),
+        "\x81\x01x\x81\x02" "a3\x81\x02" "b1");
+    BOOST_CHECK_EQUAL(con->get_buffered_amount(), 0);
+}
+
+void deflate_conflated_send(deflate_server::connection_ptr con) {
+    char const * updates[3] = {"value 1","value 2","value 3"};
+    for (int i = 0; i < 3; i++) {
+        deflate_server::message_ptr msg = con->get_message(
+            websocketpp::frame::opcode::text,7);
+        msg->set_payload(updates[i]);
+        msg->set_conflation_key("k");
+        msg->set_compressed(true);
+        BOOST_CHECK( !con->send(msg) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( deflate_not_conflated ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Extensions: permessage-deflate\r\nOrigin: http://www.example.com\r\n\r\n";
+
+    callback_buf buf;
+    std::ostream output(&buf);
+
+    deflate_server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&output);
+
+    deflate_server::connection_ptr con = s.get_connection();
+    con->start();
+
+    std::stringstream channel;
+    channel << input;
+    channel >> *con;
+    size_t handshake_size = buf.str().size();
+
+    buf.on_write = bind(&deflate_conflated_send,con);
+    BOOST_CHECK(!con->send(std::string("value 0"),
+        websocketpp::frame::opcode::text));
+
+    std::vector<std::string> messages = inflate_frames(
+        buf.str().substr(handshake_size));
+
+    std::vector<std::string> expected;
+    expected.push_back("value 0");
+    expected.push_back("value 1");
+    expected.push_back("value 2");
+    expected.push_back("value 3");
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(messages.begin(),messages.end(),
+        expected.begin(),expected.end());
+}
+
+void expiring_send(server::connection_ptr con) {
+    message_ptr late = con->get_message(websocketpp::frame::opcode::text,4);
+    late->set_payload("late");
+    late->set_deadline(1);
+    BOOST_CHECK( !con->send(late) );
+
+    message_ptr fresh = con->get_message(websocketpp::frame::opcode::text,5);
+    fresh->set_payload("fresh");
+    fresh->set_ttl(60000);
+    BOOST_CHECK( !con->send(fresh) );
+}
+
+BOOST_AUTO_TEST_CASE( expired_messages_dropped ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: http://www.example.com\r\n\r\n";
+
+    callback_buf buf;
+    std::ostream output(&buf);
+
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&output);
+
+    server::connection_ptr con = s.get_connection();
+    con->start();
+
+    std::stringstream channel;
+    channel << input;
+    channel >> *con;
+    size_t handshake_size = buf.str().size();
+
+    buf.on_write = bind(&expiring_send,con);
+    BOOST_CHECK(!con->send(std::string("x"),websocketpp::frame::opcode::text));
+
+    BOOST_CHECK_EQUAL(buf.str().substr(handshake_size),
+        "\x81\x01x\x81\x05" "fresh");
+    BOOST_CHECK_EQUAL(con->get_expired_message_count(), 1);
+    BOOST_CHECK_EQUAL(con->get_buffered_amount(), 0);
+}
+
+void deflate_expiring_send(deflate_server::connection_ptr con) {
+    deflate_server::message_ptr msg = con->get_message(
+        websocketpp::frame::opcode::text,9);
+    msg->set_payload("late late");
+    msg->set_deadline(1);
+    msg->set_compressed(true);
+    BOOST_CHECK( !con->send(msg) );
+
+    BOOST_CHECK( !con->send(std::string("late again"),
+        websocketpp::frame::opcode::text) );
+}
+
+BOOST_AUTO_TEST_CASE( deflate_not_expired ) {
+    std::string input = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Extensions: permessage-deflate\r\nOrigin: http://www.example.com\r\n\r\n";
+
+    callback_buf buf;
+    std::ostream output(&buf);
+
+    deflate_server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.register_ostream(&output);
+
+    deflate_server::connection_ptr con = s.get_connection();
+    con->start();
+
+    std::stringstream channel;
+    channel << input;
+    channel >> *con;
+    size_t handshake_size = buf.str().size();
+
+    buf.on_write = bind(&deflate_expiring_send,con);
+    BOOST_CHECK(!con->send(std::string("late"),
+        websocketpp::frame::opcode::text));
+
+    std::vector<std::string> messages = inflate_frames(
+        buf.str().substr(handshake_size));
+
+    std::vector<std::string> expected;
+    expected.push_back("late");
+    expected.push_back("late late");
+    expected.push_back("late again");
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(messages.begin(),messages.end(),
+        expected.begin(),expected.end());
+    BOOST_CHECK_EQUAL(con->get_expired_message_count(), 0);
+}
+
 /*
 
 BOOST_AUTO_TEST_CASE( user_reject_origin ) {
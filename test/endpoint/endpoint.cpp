@@ -99,3 +99,53 @@ BOOST_AUTO_TEST_CASE( endpoint_extensions ) {
 
     BOOST_CHECK( s.is_server() == true );
 }
+
+struct pooled_config : public websocketpp::config::core {
+    static const bool enable_connection_pool = true;
+    static const size_t connection_pool_size = 2;
+};
+
+BOOST_AUTO_TEST_CASE( connection_pool ) {
+    typedef websocketpp::server<pooled_config> server;
+    typedef server::connection_pool::stats stats;
+
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.prewarm_connections(5);
+    BOOST_CHECK_EQUAL( server::connection_pool::cached(), 2 );
+
+    stats before = s.get_connection_pool_stats();
+
+    server::connection_ptr a = s.get_connection();
+    server::connection_ptr b = s.get_connection();
+    server::connection_ptr c = s.get_connection();
+    BOOST_REQUIRE( a && b && c );
+    BOOST_CHECK_EQUAL( server::connection_pool::cached(), 0 );
+
+    // storage of a destroyed connection is used for the next one
+    server::connection_type * addr = c.get();
+    c.reset();
+    c = s.get_connection();
+    BOOST_CHECK_EQUAL( c.get(), addr );
+    BOOST_CHECK_EQUAL( c->get_state(), websocketpp::session::state::connecting );
+
+    // the block also holds the control block, so a handle keeps it in use
+    websocketpp::connection_hdl hdl = a->get_handle();
+    a.reset();
+    BOOST_CHECK( hdl.expired() );
+    BOOST_CHECK_EQUAL( server::connection_pool::cached(), 0 );
+    hdl.reset();
+    BOOST_CHECK_EQUAL( server::connection_pool::cached(), 1 );
+
+    b.reset();
+    c.reset();
+
+    stats after = s.get_connection_pool_stats();
+    BOOST_CHECK_EQUAL( after.hits - before.hits, 3 );
+    BOOST_CHECK_EQUAL( after.misses - before.misses, 1 );
+    BOOST_CHECK_EQUAL( after.recycled - before.recycled, 3 );
+    BOOST_CHECK_EQUAL( after.discarded - before.discarded, 1 );
+    BOOST_CHECK_EQUAL( server::connection_pool::cached(), 2 );
+
+    server::connection_pool::trim();
+}
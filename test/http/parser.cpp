@@ -964,3 +964,43 @@ BOOST_AUTO_TEST_CASE( write_request_with_body ) {
 
     BOOST_CHECK_EQUAL( r.raw(), raw );
 }
+
+BOOST_AUTO_TEST_CASE( swap_request ) {
+    websocketpp::http::parser::request r;
+    websocketpp::http::parser::request empty;
+
+    std::string raw = "GET /foo HTTP/1.1\r\nHost: www.example.com\r\n\r\n";
+    r.consume(raw.c_str(),raw.size());
+    BOOST_REQUIRE( r.ready() );
+
+    swap(r,empty);
+
+    BOOST_CHECK( !r.ready() );
+    BOOST_CHECK_EQUAL( r.get_uri(), "" );
+    BOOST_CHECK_EQUAL( r.get_header("Host"), "" );
+
+    BOOST_CHECK( empty.ready() );
+    BOOST_CHECK_EQUAL( empty.get_uri(), "/foo" );
+    BOOST_CHECK_EQUAL( empty.get_header("Host"), "www.example.com" );
+}
+
+BOOST_AUTO_TEST_CASE( swap_response ) {
+    websocketpp::http::parser::response r;
+    websocketpp::http::parser::response empty;
+
+    std::string raw = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n\r\n";
+    r.consume(raw.c_str(),raw.size());
+    BOOST_REQUIRE( r.headers_ready() );
+
+    swap(r,empty);
+
+    BOOST_CHECK( !r.headers_ready() );
+    BOOST_CHECK_EQUAL( r.get_status_code(),
+        websocketpp::http::status_code::uninitialized );
+    BOOST_CHECK_EQUAL( r.get_header("Upgrade"), "" );
+
+    BOOST_CHECK( empty.headers_ready() );
+    BOOST_CHECK_EQUAL( empty.get_status_code(),
+        websocketpp::http::status_code::switching_protocols );
+    BOOST_CHECK_EQUAL( empty.get_header("Upgrade"), "websocket" );
+}
@@ -25,7 +25,8 @@
  *
  */
 
-#include <websocketpp/http/parser.hpp>
+#include <websocketpp/http/request.hpp>
+#include <websocketpp/http/view_request.hpp>
 
 #include <chrono>
 
@@ -53,89 +54,93 @@ private:
 	std::chrono::steady_clock::time_point m_start;
 };
 
-int main() {
-	std::string raw = "GET / HTTP/1.1\r\nHost: www.example.com\r\n\r\n";
-
-	std::string firefox = "GET / HTTP/1.1\r\nHost: localhost:5000\r\nUser-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10.7; rv:10.0) Gecko/20100101 Firefox/10.0\r\nAccept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\nAccept-Language: en-us,en;q=0.5\r\nAccept-Encoding: gzip, deflate\r\nConnection: keep-alive, Upgrade\r\nSec-WebSocket-Version: 8\r\nSec-WebSocket-Origin: http://zaphoyd.com\r\nSec-WebSocket-Key: pFik//FxwFk0riN4ZiPFjQ==\r\nPragma: no-cache\r\nCache-Control: no-cache\r\nUpgrade: websocket\r\n\r\n";
+template <typename request_type>
+void run_one_chop(std::string id, std::string const & raw) {
+	scoped_timer timer(id);
+	for (int i = 0; i < 1000; i++) {
+		request_type r;
 
-	std::string firefox1 = "GET / HTTP/1.1\r\nHost: localhost:5000\r\nUser-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10.7; rv:10.0) Gecko/20100101 Firefox/10.0\r\nAccept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\nAccept-Language: en-us,en;q=0.5\r\n";
-
-	std::string firefox2 = "Accept-Encoding: gzip, deflate\r\nConnection: keep-alive, Upgrade\r\nSec-WebSocket-Version: 8\r\nSec-WebSocket-Origin: http://zaphoyd.com\r\nSec-WebSocket-Key: pFik//FxwFk0riN4ZiPFjQ==\r\nPragma: no-cache\r\nCache-Control: no-cache\r\nUpgrade: websocket\r\n\r\n";
+		try {
+			r.consume(raw.c_str(),raw.size());
+		} catch (...) {
+			std::cout << "exception" << std::endl;
+		}
 
-	{
-		scoped_timer timer("Simplest 1 chop");
-		for (int i = 0; i < 1000; i++) {
-			websocketpp::http::parser::request r;
-
-			try {
-				r.consume(raw.c_str(),raw.size());
-			} catch (...) {
-				std::cout << "exception" << std::endl;
-			}
-
-			if (!r.ready()) {
-				std::cout << "error" << std::endl;
-				break;
-			}
+		if (!r.ready()) {
+			std::cout << "error" << std::endl;
+			break;
 		}
 	}
+}
 
-	{
-		scoped_timer timer("FireFox, 1 chop, consume old");
-		for (int i = 0; i < 1000; i++) {
-			websocketpp::http::parser::request r;
-
-			try {
-				r.consume2(firefox.c_str(),firefox.size());
-			} catch (...) {
-				std::cout << "exception" << std::endl;
-			}
-
-			if (!r.ready()) {
-				std::cout << "error" << std::endl;
-				break;
-			}
+template <typename request_type>
+void run_two_chop(std::string id, std::string const & raw1,
+	std::string const & raw2)
+{
+	scoped_timer timer(id);
+	for (int i = 0; i < 1000; i++) {
+		request_type r;
+
+		try {
+			r.consume(raw1.c_str(),raw1.size());
+			r.consume(raw2.c_str(),raw2.size());
+		} catch (...) {
+			std::cout << "exception" << std::endl;
 		}
-	}
 
-	{
-		scoped_timer timer("FireFox, 1 chop");
-		for (int i = 0; i < 1000; i++) {
-			websocketpp::http::parser::request r;
-
-			try {
-				r.consume(firefox.c_str(),firefox.size());
-			} catch (...) {
-				std::cout << "exception" << std::endl;
-			}
-
-			if (!r.ready()) {
-				std::cout << "error" << std::endl;
-				break;
-			}
+		if (!r.ready()) {
+			std::cout << "error" << std::endl;
+			break;
 		}
 	}
+}
+
+template <typename request_type>
+void run_handshake_lookup(std::string id, std::string const & raw) {
+	scoped_timer timer(id);
+	size_t total = 0;
+	for (int i = 0; i < 1000; i++) {
+		request_type r;
+
+		r.consume(raw.c_str(),raw.size());
+
+		// the headers read by hybi13 while processing an opening handshake
+		total += r.get_header("Host").size();
+		total += r.get_header("Upgrade").size();
+		total += r.get_header("Connection").size();
+		total += r.get_header("Sec-WebSocket-Version").size();
+		total += r.get_header("Sec-WebSocket-Key").size();
+		total += r.get_header("Sec-WebSocket-Extensions").size();
+		total += r.get_header("Origin").size();
+	}
+	if (total == 0) {
+		std::cout << "error" << std::endl;
+	}
+}
 
+int main() {
+	typedef websocketpp::http::parser::request request;
+	typedef websocketpp::http::parser::view_request view_request;
 
+	std::string raw = "GET / HTTP/1.1\r\nHost: www.example.com\r\n\r\n";
 
-	{
-		scoped_timer timer("FireFox, 2 chop");
-		for (int i = 0; i < 1000; i++) {
-			websocketpp::http::parser::request r;
+	std::string firefox = "GET / HTTP/1.1\r\nHost: localhost:5000\r\nUser-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10.7; rv:10.0) Gecko/20100101 Firefox/10.0\r\nAccept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\nAccept-Language: en-us,en;q=0.5\r\nAccept-Encoding: gzip, deflate\r\nConnection: keep-alive, Upgrade\r\nSec-WebSocket-Version: 8\r\nSec-WebSocket-Origin: http://zaphoyd.com\r\nSec-WebSocket-Key: pFik//FxwFk0riN4ZiPFjQ==\r\nPragma: no-cache\r\nCache-Control: no-cache\r\nUpgrade: websocket\r\n\r\n";
 
-			try {
-				r.consume(firefox1.c_str(),firefox1.size());
-				r.consume(firefox2.c_str(),firefox2.size());
-			} catch (...) {
-				std::cout << "exception" << std::endl;
-			}
+	std::string firefox1 = "GET / HTTP/1.1\r\nHost: localhost:5000\r\nUser-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10.7; rv:10.0) Gecko/20100101 Firefox/10.0\r\nAccept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\nAccept-Language: en-us,en;q=0.5\r\n";
 
-			if (!r.ready()) {
-				std::cout << "error" << std::endl;
-				break;
-			}
-		}
-	}
+	std::string firefox2 = "Accept-Encoding: gzip, deflate\r\nConnection: keep-alive, Upgrade\r\nSec-WebSocket-Version: 8\r\nSec-WebSocket-Origin: http://zaphoyd.com\r\nSec-WebSocket-Key: pFik//FxwFk0riN4ZiPFjQ==\r\nPragma: no-cache\r\nCache-Control: no-cache\r\nUpgrade: websocket\r\n\r\n";
+
+	run_one_chop<request>("Simplest 1 chop",raw);
+	run_one_chop<view_request>("Simplest 1 chop, view",raw);
+
+	run_one_chop<request>("FireFox, 1 chop",firefox);
+	run_one_chop<view_request>("FireFox, 1 chop, view",firefox);
+
+	run_two_chop<request>("FireFox, 2 chop",firefox1,firefox2);
+	run_two_chop<view_request>("FireFox, 2 chop, view",firefox1,firefox2);
+
+	run_handshake_lookup<request>("FireFox, 1 chop + lookups",firefox);
+	run_handshake_lookup<view_request>("FireFox, 1 chop + lookups, view",firefox);
 
 	return 0;
 }
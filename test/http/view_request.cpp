@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE http_view_request
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <string>
+
+#include <websocketpp/http/request.hpp>
+#include <websocketpp/http/view_request.hpp>
+
+typedef websocketpp::http::parser::view_request request_type;
+
+BOOST_AUTO_TEST_CASE( blank_request ) {
+    request_type r;
+
+    std::string raw = "\r\n\r\n";
+
+    bool exception = false;
+
+    try {
+        r.consume(raw.c_str(),raw.size());
+    } catch (...) {
+        exception = true;
+    }
+
+    BOOST_CHECK( exception == true );
+    BOOST_CHECK( r.ready() == false );
+}
+
+BOOST_AUTO_TEST_CASE( bad_request_no_host ) {
+    request_type r;
+
+    std::string raw = "GET / HTTP/1.1\r\n\r\n";
+
+    bool exception = false;
+
+    try {
+        r.consume(raw.c_str(),raw.size());
+    } catch (...) {
+        exception = true;
+    }
+
+    BOOST_CHECK( exception == true );
+    BOOST_CHECK( r.ready() == false );
+}
+
+BOOST_AUTO_TEST_CASE( bad_method ) {
+    request_type r;
+
+    std::string raw = "GE]T / HTTP/1.1\r\nHost: www.example.com\r\n\r\n";
+
+    bool exception = false;
+
+    try {
+        r.consume(raw.c_str(),raw.size());
+    } catch (...) {
+        exception = true;
+    }
+
+    BOOST_CHECK( exception == true );
+    BOOST_CHECK( r.ready() == false );
+}
+
+BOOST_AUTO_TEST_CASE( bad_header_line ) {
+    request_type r;
+
+    std::string raw = "GET / HTTP/1.1\r\nHost www.example.com\r\n\r\n";
+
+    bool exception = false;
+
+    try {
+        r.consume(raw.c_str(),raw.size());
+    } catch (...) {
+        exception = true;
+    }
+
+    BOOST_CHECK( exception == true );
+}
+
+BOOST_AUTO_TEST_CASE( basic_request ) {
+    request_type r;
+
+    std::string raw = "GET / HTTP/1.1\r\nHost: www.example.com\r\n\r\na";
+
+    size_t pos = r.consume(raw.c_str(),raw.size());
+
+    BOOST_CHECK_EQUAL( pos, 41 );
+    BOOST_CHECK( r.ready() == true );
+    BOOST_CHECK_EQUAL( r.get_version(), "HTTP/1.1" );
+    BOOST_CHECK_EQUAL( r.get_method(), "GET" );
+    BOOST_CHECK_EQUAL( r.get_uri(), "/" );
+    BOOST_CHECK_EQUAL( r.get_header("Host"), "www.example.com" );
+    BOOST_CHECK_EQUAL( r.get_header("host"), "www.example.com" );
+    BOOST_CHECK_EQUAL( r.get_header("Upgrade"), "" );
+    BOOST_CHECK_EQUAL( r.consume(raw.c_str(),raw.size()), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( split_at_every_byte ) {
+    std::string raw = "GET /chat HTTP/1.1\r\nHost: www.example.com\r\nUpgrade: websocket\r\n\r\nab";
+
+    request_type r;
+    size_t pos = 0;
+
+    for (size_t i = 0; i < raw.size() && !r.ready(); i++) {
+        pos += r.consume(raw.c_str()+i,1);
+    }
+
+    BOOST_CHECK_EQUAL( pos, raw.size()-2 );
+    BOOST_CHECK( r.ready() == true );
+    BOOST_CHECK_EQUAL( r.get_uri(), "/chat" );
+    BOOST_CHECK_EQUAL( r.get_header("Host"), "www.example.com" );
+    BOOST_CHECK_EQUAL( r.get_header("Upgrade"), "websocket" );
+}
+
+BOOST_AUTO_TEST_CASE( max_header_len ) {
+    request_type r;
+
+    std::string raw(websocketpp::http::max_header_size+1,'*');
+
+    bool exception = false;
+
+    try {
+        r.consume(raw.c_str(),raw.size());
+    } catch (const websocketpp::http::exception& e) {
+        if (e.m_error_code == websocketpp::http::status_code::request_header_fields_too_large) {
+            exception = true;
+        }
+    }
+
+    BOOST_CHECK( exception == true );
+}
+
+BOOST_AUTO_TEST_CASE( max_header_len_split ) {
+    request_type r;
+
+    std::string raw(websocketpp::http::max_header_size-1,'*');
+    std::string raw2(2,'*');
+
+    bool exception = false;
+
+    try {
+        r.consume(raw.c_str(),raw.size());
+        r.consume(raw2.c_str(),raw2.size());
+    } catch (const websocketpp::http::exception& e) {
+        if (e.m_error_code == websocketpp::http::status_code::request_header_fields_too_large) {
+            exception = true;
+        }
+    }
+
+    BOOST_CHECK( exception == true );
+}
+
+BOOST_AUTO_TEST_CASE( matches_default_request ) {
+    std::string raw = "GET / HTTP/1.1\r\nHost: localhost:5000\r\nUser-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10.7; rv:10.0) Gecko/20100101 Firefox/10.0\r\nAccept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\nAccept-Language: en-us,en;q=0.5\r\nAccept-Encoding: gzip, deflate\r\nConnection: keep-alive, Upgrade\r\nSec-WebSocket-Version: 13\r\nOrigin: http://zaphoyd.com\r\nSec-WebSocket-Key: pFik//FxwFk0riN4ZiPFjQ==\r\nSec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\nPragma: no-cache\r\nCache-Control: no-cache\r\nUpgrade: websocket\r\n\r\n";
+
+    websocketpp::http::parser::request d;
+    request_type r;
+
+    BOOST_CHECK_EQUAL( d.consume(raw.c_str(),raw.size()), raw.size() );
+    BOOST_CHECK_EQUAL( r.consume(raw.c_str(),raw.size()), raw.size() );
+    BOOST_CHECK_EQUAL( r.get_header_count(), 13 );
+
+    char const * names[] = {"Host","User-Agent","Accept","Accept-Language",
+        "Accept-Encoding","CONNECTION","Sec-WebSocket-Version","Origin",
+        "sec-websocket-key","Sec-WebSocket-Extensions","Pragma",
+        "Cache-Control","Upgrade","Missing"};
+
+    for (size_t i = 0; i < sizeof(names)/sizeof(names[0]); i++) {
+        BOOST_CHECK_EQUAL( r.get_header(names[i]), d.get_header(names[i]) );
+    }
+
+    websocketpp::http::parameter_list pd;
+    websocketpp::http::parameter_list pr;
+
+    BOOST_CHECK( !d.get_header_as_plist("Sec-WebSocket-Extensions",pd) );
+    BOOST_CHECK( !r.get_header_as_plist("Sec-WebSocket-Extensions",pr) );
+    BOOST_REQUIRE_EQUAL( pr.size(), pd.size() );
+    BOOST_CHECK_EQUAL( pr[0].first, "permessage-deflate" );
+    BOOST_CHECK( pr[0].second == pd[0].second );
+}
+
+BOOST_AUTO_TEST_CASE( repeated_header ) {
+    request_type r;
+
+    std::string raw = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: keep-alive\r\nconnection:Upgrade  \r\n\r\n";
+
+    r.consume(raw.c_str(),raw.size());
+
+    BOOST_CHECK( r.ready() == true );
+    BOOST_CHECK_EQUAL( r.get_header_count(), 2 );
+    BOOST_CHECK_EQUAL( r.get_header("Connection"), "keep-alive, Upgrade" );
+}
+
+BOOST_AUTO_TEST_CASE( modify_parsed_headers ) {
+    request_type r;
+
+    std::string raw = "GET / HTTP/1.1\r\nHost: www.example.com\r\nX-Foo: bar\r\nUpgrade: websocket\r\n\r\n";
+
+    r.consume(raw.c_str(),raw.size());
+
+    r.remove_header("x-foo");
+    r.append_header("Upgrade","h2c");
+    r.replace_header("Host","example.org");
+    r.append_header("X-Bar","baz");
+
+    BOOST_CHECK_EQUAL( r.get_header("X-Foo"), "" );
+    BOOST_CHECK_EQUAL( r.get_header("Upgrade"), "websocket, h2c" );
+    BOOST_CHECK_EQUAL( r.get_header("Host"), "example.org" );
+    BOOST_CHECK_EQUAL( r.raw(), "GET / HTTP/1.1\r\nHost: example.org\r\nUpgrade: websocket, h2c\r\nX-Bar: baz\r\n\r\n" );
+
+    bool exception = false;
+    try {
+        r.append_header("Bad Name","x");
+    } catch (...) {
+        exception = true;
+    }
+    BOOST_CHECK( exception == true );
+}
+
+BOOST_AUTO_TEST_CASE( write_request_with_body ) {
+    request_type r;
+
+    std::string raw = "POST / HTTP/1.1\r\nHost: http://example.com\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: 48\r\n\r\nlicenseID=string&content=string&paramsXML=string";
+
+    r.set_version("HTTP/1.1");
+    r.set_method("POST");
+    r.set_uri("/");
+    r.replace_header("Host","http://example.com");
+    r.replace_header("Content-Type","application/x-www-form-urlencoded");
+    r.set_body("licenseID=string&content=string&paramsXML=string");
+
+    BOOST_CHECK_EQUAL( r.raw(), raw );
+
+    r.set_body("");
+    BOOST_CHECK_EQUAL( r.get_header("Content-Length"), "" );
+}
+
+BOOST_AUTO_TEST_CASE( parse_complete ) {
+    request_type r;
+
+    std::stringstream s;
+    s << "GET /foo HTTP/1.1\r\nHost: www.example.com\r\n\r\n";
+
+    BOOST_CHECK( r.parse_complete(s) );
+    BOOST_CHECK_EQUAL( r.get_uri(), "/foo" );
+    BOOST_CHECK_EQUAL( r.get_header("Host"), "www.example.com" );
+}
+
+BOOST_AUTO_TEST_CASE( swap_request ) {
+    request_type r;
+    request_type empty;
+
+    std::string raw = "GET /foo HTTP/1.1\r\nHost: www.example.com\r\n\r\n";
+    r.consume(raw.c_str(),raw.size());
+    BOOST_REQUIRE( r.ready() );
+
+    swap(r,empty);
+
+    BOOST_CHECK( !r.ready() );
+    BOOST_CHECK_EQUAL( r.get_uri(), "" );
+    BOOST_CHECK_EQUAL( r.get_header("Host"), "" );
+    BOOST_CHECK_EQUAL( r.get_header_count(), 0 );
+
+    BOOST_CHECK( empty.ready() );
+    BOOST_CHECK_EQUAL( empty.get_uri(), "/foo" );
+    BOOST_CHECK_EQUAL( empty.get_header("Host"), "www.example.com" );
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2012, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE message_buffer_block_pool
+#include <boost/test/unit_test.hpp>
+
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/message_buffer/block_pool.hpp>
+
+#include <cstring>
+
+typedef websocketpp::message_buffer::block_pool<256,2> pool_type;
+
+BOOST_AUTO_TEST_CASE( reuse_released_blocks ) {
+    pool_type::trim();
+    BOOST_CHECK_EQUAL(pool_type::cached(), 0);
+
+    char * a = pool_type::acquire();
+    BOOST_REQUIRE(a);
+    std::memset(a,'a',256);
+
+    pool_type::release(a);
+    BOOST_CHECK_EQUAL(pool_type::cached(), 1);
+
+    char * b = pool_type::acquire();
+    BOOST_CHECK(a == b);
+    BOOST_CHECK_EQUAL(pool_type::cached(), 0);
+
+    pool_type::release(b);
+    pool_type::release(NULL);
+    BOOST_CHECK_EQUAL(pool_type::cached(), 1);
+
+    pool_type::trim();
+    BOOST_CHECK_EQUAL(pool_type::cached(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( cache_limit ) {
+    char * blocks[3];
+    for (int i = 0; i < 3; i++) {
+        blocks[i] = pool_type::acquire();
+    }
+    for (int i = 0; i < 3; i++) {
+        pool_type::release(blocks[i]);
+    }
+
+    // the third block is freed rather than cached
+    BOOST_CHECK_EQUAL(pool_type::cached(), 2);
+
+    pool_type::trim();
+}
+
+void cache_on_thread(char * block, size_t * cached_before,
+    size_t * cached_after)
+{
+    *cached_before = pool_type::cached();
+    pool_type::release(block);
+    *cached_after = pool_type::cached();
+    pool_type::trim();
+}
+
+BOOST_AUTO_TEST_CASE( per_thread_cache ) {
+    pool_type::release(pool_type::acquire());
+    BOOST_CHECK_EQUAL(pool_type::cached(), 1);
+
+    // blocks may be released on another thread, which caches them separately
+    size_t before = 99;
+    size_t after = 99;
+    websocketpp::lib::thread t(websocketpp::lib::bind(&cache_on_thread,
+        pool_type::acquire(),&before,&after));
+    t.join();
+
+    BOOST_CHECK_EQUAL(before, 0);
+    BOOST_CHECK_EQUAL(after, 1);
+    BOOST_CHECK_EQUAL(pool_type::cached(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( reserve_and_stats ) {
+    typedef websocketpp::message_buffer::block_pool<64,4> small_pool;
+
+    small_pool::reserve(10);
+    BOOST_CHECK_EQUAL(small_pool::cached(), 4);
+
+    char * blocks[5];
+    for (int i = 0; i < 5; i++) {
+        blocks[i] = small_pool::acquire();
+    }
+    for (int i = 0; i < 5; i++) {
+        small_pool::release(blocks[i]);
+    }
+
+    small_pool::stats s = small_pool::get_stats();
+    BOOST_CHECK_EQUAL(s.hits, 4);
+    BOOST_CHECK_EQUAL(s.misses, 1);
+    BOOST_CHECK_EQUAL(s.recycled, 4);
+    BOOST_CHECK_EQUAL(s.discarded, 1);
+
+    small_pool::trim();
+}
+
+BOOST_AUTO_TEST_CASE( allocate_shared_from_pool ) {
+    typedef websocketpp::message_buffer::block_pool_allocator<int,pool_type>
+        allocator_type;
+    pool_type::trim();
+    pool_type::reserve(2);
+
+    // the int and its control block share one block
+    websocketpp::lib::shared_ptr<int> p =
+        websocketpp::lib::allocate_shared<int>(allocator_type(),42);
+    BOOST_CHECK_EQUAL(*p, 42);
+    BOOST_CHECK_EQUAL(pool_type::cached(), 1);
+
+    websocketpp::lib::weak_ptr<int> w(p);
+    p.reset();
+    BOOST_CHECK_EQUAL(pool_type::cached(), 1);
+    w.reset();
+    BOOST_CHECK_EQUAL(pool_type::cached(), 2);
+
+    // arrays don't fit a block and bypass the pool
+    allocator_type a;
+    int * array = a.allocate(100);
+    BOOST_CHECK_EQUAL(pool_type::cached(), 2);
+    a.deallocate(array,100);
+    BOOST_CHECK_EQUAL(pool_type::cached(), 2);
+
+    pool_type::trim();
+}
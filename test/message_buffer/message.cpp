@@ -70,3 +70,24 @@ BOOST_AUTO_TEST_CASE( recycle ) {
 	BOOST_CHECK(s->recycled == true);
 }
 
+
+BOOST_AUTO_TEST_CASE( deadline ) {
+	typedef websocketpp::message_buffer::message<stub> message_type;
+	typedef stub<message_type> stub_type;
+
+	stub_type::ptr s(new stub_type());
+	message_type::ptr msg(new message_type(s,websocketpp::frame::opcode::TEXT,500));
+
+	uint64_t now = websocketpp::lib::now_ms();
+	BOOST_CHECK(!msg->get_expired(now));
+
+	msg->set_deadline(now);
+	BOOST_CHECK(!msg->get_expired(now));
+	BOOST_CHECK(msg->get_expired(now+1));
+
+	msg->set_ttl(60000);
+	BOOST_CHECK(!msg->get_expired(websocketpp::lib::now_ms()));
+
+	msg->set_deadline(0);
+	BOOST_CHECK(!msg->get_expired(now+1));
+}
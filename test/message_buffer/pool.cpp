@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2011, Peter Thorson. All rights reserved.
+ * Copyright (c) 2012, Peter Thorson. All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions are met:
@@ -25,132 +25,161 @@
  *
  */
 //#define BOOST_TEST_DYN_LINK
-#define BOOST_TEST_MODULE hybi_00_processor
+#define BOOST_TEST_MODULE message_buffer_pool
 #include <boost/test/unit_test.hpp>
 
 #include <iostream>
 #include <string>
 
-#include <websocketpp/processors/hybi00.hpp>
-#include <websocketpp/http/request.hpp>
-#include <websocketpp/http/response.hpp>
-
-
-BOOST_AUTO_TEST_CASE( exact_match ) {
-    websocketpp::http::parser::request r;
-    websocketpp::http::parser::response response;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
-
-    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nOrigin: http://example.com\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
-
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","WjN}|M(6");
-
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(p.validate_handshake_request(r));
-
-    websocketpp::uri_ptr u;
-    bool exception;
+#include <websocketpp/message_buffer/message.hpp>
+#include <websocketpp/message_buffer/pool.hpp>
+
+typedef websocketpp::message_buffer::message<
+    websocketpp::message_buffer::pool::con_msg_manager> message_type;
+typedef websocketpp::message_buffer::pool::con_msg_manager<message_type>
+    con_msg_man_type;
+typedef websocketpp::message_buffer::pool::endpoint_msg_manager
+    <con_msg_man_type> endpoint_manager_type;
+
+BOOST_AUTO_TEST_CASE( basic_get_message ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type());
+    message_type::ptr msg = manager->get_message(websocketpp::frame::opcode::TEXT,512);
+
+    BOOST_CHECK(msg);
+    BOOST_CHECK(msg->get_opcode() == websocketpp::frame::opcode::TEXT);
+    BOOST_CHECK(msg->get_payload().capacity() >= 1024);
+    BOOST_CHECK_EQUAL(manager->get_stats().misses, 1);
+    BOOST_CHECK_EQUAL(manager->get_stats().hits, 0);
+}
 
-    try {
-    	u = p.get_uri(r);
-    } catch (const websocketpp::uri_exception& e) {
-    	exception = true;
+BOOST_AUTO_TEST_CASE( recycle_and_reuse ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type());
+
+    message_type * raw;
+    {
+        message_type::ptr msg = manager->get_message(websocketpp::frame::opcode::BINARY,100);
+        msg->set_payload("foo");
+        msg->set_header("bar");
+        msg->set_fin(false);
+        msg->set_prepared(true);
+        raw = msg.get();
     }
 
-    BOOST_CHECK(exception == false);
-    BOOST_CHECK(u->get_secure() == false);
-    BOOST_CHECK(u->get_host() == "www.example.com");
-    BOOST_CHECK(u->get_resource() == "/");
-    BOOST_CHECK(u->get_port() == websocketpp::URI_DEFAULT_PORT);
-
-    p.process_handshake_request(r,response);
+    BOOST_CHECK_EQUAL(manager->get_stats().recycled, 1);
+    BOOST_CHECK_EQUAL(manager->get_cached_count(), 1);
 
-    BOOST_CHECK(response.get_header("Connection") == "Upgrade");
-    BOOST_CHECK(response.get_header("Upgrade") == "websocket");
-    BOOST_CHECK(response.get_header("Sec-WebSocket-Origin") == "http://example.com");
+    message_type::ptr msg = manager->get_message(websocketpp::frame::opcode::TEXT,200);
 
-    BOOST_CHECK(response.get_header("Sec-WebSocket-Location") == "ws://www.example.com/");
-    BOOST_CHECK(response.get_header("Sec-WebSocket-Key3") == "n`9eBk9z$R8pOtVb");
+    BOOST_CHECK(msg.get() == raw);
+    BOOST_CHECK(msg->get_opcode() == websocketpp::frame::opcode::TEXT);
+    BOOST_CHECK(msg->get_payload().empty());
+    BOOST_CHECK(msg->get_header().empty());
+    BOOST_CHECK(msg->get_fin());
+    BOOST_CHECK(!msg->get_prepared());
+    BOOST_CHECK_EQUAL(manager->get_stats().hits, 1);
+    BOOST_CHECK_EQUAL(manager->get_cached_count(), 0);
 }
 
-BOOST_AUTO_TEST_CASE( non_get_method ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
+BOOST_AUTO_TEST_CASE( size_classes ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type());
 
-    std::string handshake = "POST / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
+    manager->get_message(websocketpp::frame::opcode::TEXT,100);
 
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
-
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake_request(r));
+    // a small cached message can't satisfy a larger request
+    message_type::ptr msg = manager->get_message(websocketpp::frame::opcode::TEXT,5000);
+    BOOST_CHECK(msg->get_payload().capacity() >= 16384);
+    BOOST_CHECK_EQUAL(manager->get_stats().misses, 2);
+    BOOST_CHECK_EQUAL(manager->get_cached_count(), 1);
 }
 
-BOOST_AUTO_TEST_CASE( old_http_version ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
-
-    std::string handshake = "GET / HTTP/1.0\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
+BOOST_AUTO_TEST_CASE( cache_bound ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type(2048));
 
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
+    {
+        message_type::ptr a = manager->get_message(websocketpp::frame::opcode::TEXT,1024);
+        message_type::ptr b = manager->get_message(websocketpp::frame::opcode::TEXT,1024);
+        message_type::ptr c = manager->get_message(websocketpp::frame::opcode::TEXT,4096);
+    }
 
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake_request(r));
+    websocketpp::message_buffer::pool::stats s = manager->get_stats();
+    BOOST_CHECK_EQUAL(s.misses, 3);
+    BOOST_CHECK(s.recycled + s.discarded == 3);
+    BOOST_CHECK(s.discarded >= 1);
+    BOOST_CHECK(manager->get_cached_count() <= 2);
 }
 
-BOOST_AUTO_TEST_CASE( missing_handshake_key1 ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
+BOOST_AUTO_TEST_CASE( oversize_not_pooled ) {
+    con_msg_man_type::ptr manager(new con_msg_man_type());
 
-    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key1: 3e6b263  4 17 80\r\n\r\n";
+    manager->get_message(websocketpp::frame::opcode::BINARY,1000000);
 
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
+    BOOST_CHECK_EQUAL(manager->get_stats().discarded, 1);
+    BOOST_CHECK_EQUAL(manager->get_cached_count(), 0);
+}
 
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake_request(r));
+BOOST_AUTO_TEST_CASE( message_outlives_manager ) {
+    message_type::ptr msg;
+    {
+        con_msg_man_type::ptr manager(new con_msg_man_type());
+        msg = manager->get_message(websocketpp::frame::opcode::TEXT,512);
+    }
+    msg->set_payload("foo");
+    BOOST_CHECK_EQUAL(msg->get_payload(), "foo");
 }
 
-BOOST_AUTO_TEST_CASE( missing_handshake_key2 ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
+BOOST_AUTO_TEST_CASE( basic_get_manager ) {
+    endpoint_manager_type em;
+    con_msg_man_type::ptr manager = em.get_manager();
+    message_type::ptr msg = manager->get_message(websocketpp::frame::opcode::TEXT,512);
 
-    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
+    BOOST_CHECK(msg);
+    BOOST_CHECK(msg->get_opcode() == websocketpp::frame::opcode::TEXT);
+    BOOST_CHECK_EQUAL(em.get_stats().created, 1);
+}
 
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
+BOOST_AUTO_TEST_CASE( manager_reuse ) {
+    endpoint_manager_type em;
 
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake_request(r));
-}
+    message_type * raw;
+    con_msg_man_type * real;
+    {
+        con_msg_man_type::ptr manager = em.get_manager();
+        raw = manager->get_message(websocketpp::frame::opcode::TEXT,512).get();
+        real = manager.get();
+    }
 
-BOOST_AUTO_TEST_CASE( bad_host ) {
-    websocketpp::http::parser::request r;
-    websocketpp::processor::hybi00<websocketpp::http::parser::request,websocketpp::http::parser::response> p(false);
-    websocketpp::uri_ptr u;
-    bool exception = false;
+    BOOST_CHECK_EQUAL(em.get_idle_count(), 1);
 
-    std::string handshake = "GET / HTTP/1.1\r\nHost: www.example.com:70000\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Key2: 17  9 G`ZD9   2 2b 7X 3 /r90\r\n\r\n";
+    con_msg_man_type::ptr manager = em.get_manager();
+    BOOST_CHECK(manager.get() == real);
+    BOOST_CHECK_EQUAL(em.get_stats().created, 1);
+    BOOST_CHECK_EQUAL(em.get_stats().reused, 1);
+    BOOST_CHECK_EQUAL(em.get_idle_count(), 0);
 
-    r.consume(handshake.c_str(),handshake.size());
-    r.replace_header("Sec-WebSocket-Key3","janelle!");
+    // the warm cache came along with the manager
+    message_type::ptr msg = manager->get_message(websocketpp::frame::opcode::TEXT,512);
+    BOOST_CHECK(msg.get() == raw);
+    BOOST_CHECK_EQUAL(manager->get_stats().hits, 1);
+}
 
-    BOOST_CHECK(websocketpp::processor::is_websocket_handshake(r));
-    BOOST_CHECK(websocketpp::processor::get_websocket_version(r) == p.get_version());
-    BOOST_CHECK(!p.validate_handshake_request(r));
+BOOST_AUTO_TEST_CASE( idle_bound ) {
+    endpoint_manager_type em(1);
 
-    try {
-    	u = p.get_uri(r);
-    } catch (const websocketpp::uri_exception& e) {
-    	exception = true;
+    {
+        con_msg_man_type::ptr a = em.get_manager();
+        con_msg_man_type::ptr b = em.get_manager();
     }
 
-    BOOST_CHECK(exception == true);
+    BOOST_CHECK_EQUAL(em.get_idle_count(), 1);
+    BOOST_CHECK_EQUAL(em.get_stats().created, 2);
+}
+
+BOOST_AUTO_TEST_CASE( manager_outlives_endpoint_manager ) {
+    con_msg_man_type::ptr manager;
+    {
+        endpoint_manager_type em;
+        manager = em.get_manager();
+    }
+    message_type::ptr msg = manager->get_message(websocketpp::frame::opcode::TEXT,512);
+    BOOST_CHECK(msg);
 }
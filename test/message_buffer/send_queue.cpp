@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2012, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE message_buffer_send_queue
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+#include <websocketpp/message_buffer/message.hpp>
+#include <websocketpp/message_buffer/alloc.hpp>
+#include <websocketpp/message_buffer/send_queue.hpp>
+
+typedef websocketpp::message_buffer::message<
+    websocketpp::message_buffer::alloc::con_msg_manager> message_type;
+typedef websocketpp::message_buffer::alloc::con_msg_manager<message_type>
+    con_msg_man_type;
+typedef websocketpp::message_buffer::send_queue<message_type::ptr> queue_type;
+
+namespace priority = websocketpp::message_buffer::priority;
+namespace lane = websocketpp::message_buffer::lane;
+namespace opcode = websocketpp::frame::opcode;
+
+struct queue_setup {
+    queue_setup() : manager(new con_msg_man_type()) {}
+
+    message_type::ptr push(std::string const & payload, opcode::value op,
+        priority::value p = priority::normal, bool fin = true,
+        std::string const & key = "", bool compressed = false)
+    {
+        message_type::ptr msg = manager->get_message(op,0);
+        msg->set_payload(payload);
+        msg->set_priority(p);
+        msg->set_fin(fin);
+        msg->set_conflation_key(key);
+        msg->set_compressed(compressed);
+        replaced = q.push(msg);
+        return msg;
+    }
+
+    std::string drain() {
+        std::string out;
+        while (q.ready()) {
+            out += q.front()->get_payload();
+            q.pop();
+        }
+        return out;
+    }
+
+    con_msg_man_type::ptr manager;
+    queue_type q;
+    message_type::ptr replaced;
+};
+
+BOOST_AUTO_TEST_CASE( empty_queue ) {
+    queue_type q;
+
+    BOOST_CHECK( q.empty() );
+    BOOST_CHECK( !q.ready() );
+    BOOST_CHECK_EQUAL( q.size(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( lanes_drain_in_order ) {
+    queue_setup env;
+
+    env.push("c",opcode::CLOSE);
+    env.push("1",opcode::BINARY);
+    env.push("l",opcode::TEXT,priority::low);
+    env.push("2",opcode::TEXT);
+    env.push("h",opcode::BINARY,priority::high);
+    env.push("p",opcode::PONG);
+    env.push("i",opcode::PING);
+
+    BOOST_CHECK_EQUAL( env.q.size(), 7 );
+    BOOST_CHECK_EQUAL( env.q.size(lane::control), 2 );
+    BOOST_CHECK_EQUAL( env.q.size(lane::high), 1 );
+    BOOST_CHECK_EQUAL( env.q.size(lane::normal), 2 );
+    BOOST_CHECK_EQUAL( env.q.size(lane::low), 1 );
+    BOOST_CHECK_EQUAL( env.q.size(lane::close), 1 );
+
+    BOOST_CHECK_EQUAL( env.drain(), "pih12lc" );
+    BOOST_CHECK( env.q.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( priority_ignored_for_control ) {
+    queue_setup env;
+
+    env.push("d",opcode::BINARY,priority::high);
+    env.push("p",opcode::PONG,priority::low);
+    env.push("c",opcode::CLOSE,priority::high);
+
+    BOOST_CHECK_EQUAL( env.drain(), "pdc" );
+}
+
+BOOST_AUTO_TEST_CASE( compressed_messages_keep_order ) {
+    queue_setup env;
+
+    env.push("1",opcode::TEXT,priority::low,true,"",true);
+    env.push("2",opcode::TEXT,priority::high,true,"",true);
+    env.push("h",opcode::TEXT,priority::high);
+    env.push("3",opcode::BINARY,priority::normal,true,"",true);
+
+    BOOST_CHECK_EQUAL( env.q.size(lane::normal), 3 );
+    BOOST_CHECK_EQUAL( env.drain(), "h123" );
+}
+
+BOOST_AUTO_TEST_CASE( fragments_not_interleaved ) {
+    queue_setup env;
+
+    env.push("a",opcode::TEXT,priority::normal,false);
+    env.push("b",opcode::CONTINUATION,priority::normal,false);
+    env.push("x",opcode::BINARY,priority::low);
+
+    // first fragment goes out, then a higher priority message arrives
+    BOOST_CHECK_EQUAL( env.q.front()->get_payload(), "a" );
+    env.q.pop();
+    env.push("h",opcode::BINARY,priority::high);
+    env.push("p",opcode::PING);
+
+    // control frames may still be injected, data must wait for the fin
+    BOOST_CHECK_EQUAL( env.drain(), "pb" );
+    BOOST_CHECK( !env.q.empty() );
+    BOOST_CHECK( !env.q.ready() );
+
+    env.push("c",opcode::CONTINUATION);
+    BOOST_CHECK_EQUAL( env.drain(), "chx" );
+    BOOST_CHECK( env.q.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( close_during_fragmented_message ) {
+    queue_setup env;
+
+    env.push("a",opcode::TEXT,priority::normal,false);
+    env.push("x",opcode::BINARY,priority::high);
+    env.push("c",opcode::CLOSE);
+
+    // an abandoned fragmented message doesn't hold back the close frame
+    BOOST_CHECK_EQUAL( env.drain(), "xac" );
+}
+
+BOOST_AUTO_TEST_CASE( conflation_replaces_queued ) {
+    queue_setup env;
+
+    env.push("a1",opcode::TEXT,priority::normal,true,"a");
+    env.push("b1",opcode::TEXT,priority::normal,true,"b");
+    env.push("x",opcode::TEXT);
+    BOOST_CHECK( !env.replaced );
+
+    // replacements keep the position of the message they replace
+    env.push("a2",opcode::TEXT,priority::normal,true,"a");
+    BOOST_REQUIRE( env.replaced );
+    BOOST_CHECK_EQUAL( env.replaced->get_payload(), "a1" );
+    env.push("a3",opcode::TEXT,priority::normal,true,"a");
+    BOOST_CHECK_EQUAL( env.replaced->get_payload(), "a2" );
+
+    BOOST_CHECK_EQUAL( env.q.size(), 3 );
+    BOOST_CHECK_EQUAL( env.drain(), "a3b1x" );
+}
+
+BOOST_AUTO_TEST_CASE( conflation_after_write ) {
+    queue_setup env;
+
+    env.push("a1",opcode::BINARY,priority::normal,true,"a");
+    env.q.pop();
+
+    // a written message is never replaced
+    env.push("a2",opcode::BINARY,priority::normal,true,"a");
+    BOOST_CHECK( !env.replaced );
+    env.push("a3",opcode::BINARY,priority::normal,true,"a");
+    BOOST_CHECK( env.replaced );
+    BOOST_CHECK_EQUAL( env.drain(), "a3" );
+    BOOST_CHECK( env.q.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( conflation_scope ) {
+    queue_setup env;
+
+    // keys are per lane, fragments and compressed messages are never
+    // conflated
+    env.push("h",opcode::TEXT,priority::high,true,"k");
+    env.push("n",opcode::TEXT,priority::normal,true,"k");
+    env.push("z",opcode::TEXT,priority::normal,true,"k",true);
+    env.push("f",opcode::TEXT,priority::low,false,"k");
+    env.push("c",opcode::CONTINUATION,priority::low,true,"k");
+    env.push("p",opcode::PING,priority::normal,true,"k");
+    env.push("q",opcode::PING,priority::normal,true,"k");
+    BOOST_CHECK( !env.replaced );
+
+    BOOST_CHECK_EQUAL( env.drain(), "pqhnzfc" );
+}
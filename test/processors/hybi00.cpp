@@ -270,3 +270,17 @@ BOOST_AUTO_TEST_CASE( short_frame ) {
     BOOST_CHECK_EQUAL( env.p.get_message()->get_payload(), "foo" );
     BOOST_CHECK_EQUAL( env.p.ready(), false );
 }
+
+BOOST_AUTO_TEST_CASE( message_too_big ) {
+    uint8_t frame[7] = {0x00, 0x66, 0x6f, 0x6f, 0x66, 0x6f, 0xff};
+
+    processor_setup env(true);
+    env.p.set_max_message_size(4);
+
+    // the limit applies across reads
+    BOOST_CHECK_EQUAL( env.p.consume(frame,3,env.ec), 3 );
+    BOOST_CHECK( !env.ec );
+    env.p.consume(frame+3,4,env.ec);
+    BOOST_CHECK_EQUAL( env.ec, websocketpp::processor::error::message_too_big );
+    BOOST_CHECK_EQUAL( env.p.ready(), false );
+}
@@ -67,6 +67,7 @@ struct stub_config {
     struct mobile_signaling_config {
         typedef stub_config::request_type request_type;
         typedef stub_config::response_type response_type;
+        typedef stub_config::rng_type rng_type;
     };
     typedef websocketpp::extensions::mobile_signaling::disabled
         <mobile_signaling_config> mobile_signaling_type;
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE transport_asio_accept
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include "test_server.hpp"
+
+BOOST_AUTO_TEST_CASE( concurrent_accepts_setting ) {
+    size_t const initial = websocketpp::config::asio::concurrent_accepts;
+
+    server s;
+    BOOST_CHECK_EQUAL(s.get_concurrent_accepts(), initial);
+
+    s.set_concurrent_accepts(8);
+    BOOST_CHECK_EQUAL(s.get_concurrent_accepts(), 8);
+
+    s.set_concurrent_accepts(0);
+    BOOST_CHECK_EQUAL(s.get_concurrent_accepts(), 1);
+}
+
+BOOST_AUTO_TEST_CASE( concurrent_accepts ) {
+    server s;
+    open_counter c;
+    unsigned short const port = free_port();
+    size_t const threads = 4;
+    size_t const connections = 64;
+
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.set_open_handler(websocketpp::lib::bind(&open_counter::on_open,&c,
+        websocketpp::lib::placeholders::_1));
+
+    s.init_asio();
+    s.set_concurrent_accepts(8);
+    s.listen(boost::asio::ip::tcp::v4(),port);
+    s.start_accept();
+
+    std::vector<websocketpp::lib::shared_ptr<websocketpp::lib::thread> > tv;
+    for (size_t i = 0; i < threads; i++) {
+        tv.push_back(websocketpp::lib::shared_ptr<websocketpp::lib::thread>(
+            new websocketpp::lib::thread(websocketpp::lib::bind(&run_server,
+                &s))));
+    }
+
+    boost::asio::io_service io_service;
+    std::vector<websocketpp::lib::shared_ptr<boost::asio::ip::tcp::socket> >
+        sockets;
+
+    for (size_t i = 0; i < connections; i++) {
+        websocketpp::lib::shared_ptr<boost::asio::ip::tcp::socket> socket(
+            new boost::asio::ip::tcp::socket(io_service));
+        BOOST_CHECK(upgraded(handshake(*socket,port)));
+        sockets.push_back(socket);
+    }
+
+    BOOST_CHECK(c.wait_for(connections));
+    BOOST_CHECK_EQUAL(c.get(), connections);
+
+    // The outstanding accepts are cancelled without ending the io_service,
+    // which still runs handlers posted to it afterwards.
+    s.stop_listening();
+    s.get_io_service().post(websocketpp::lib::bind(&open_counter::on_open,&c,
+        websocketpp::connection_hdl()));
+    BOOST_CHECK(c.wait_for(connections+1));
+    BOOST_CHECK(!s.stopped());
+
+    s.stop();
+    for (size_t i = 0; i < threads; i++) {
+        tv[i]->join();
+    }
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2011, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Measures the rate at which a server accepts and handshakes connections from
+// loopback clients for different numbers of outstanding accepts. Each
+// configuration runs in its own process so sockets and threads left over from
+// one run cannot skew the next.
+
+#include "test_server.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+std::atomic<bool> g_running;
+std::atomic<size_t> g_opened;
+
+void on_open(websocketpp::connection_hdl) {
+    g_opened++;
+}
+
+// Connect, handshake and reset the connection in a loop until told to stop.
+void client_loop(unsigned short port) {
+    using boost::asio::ip::tcp;
+
+    boost::asio::io_service io_service;
+
+    while (g_running) {
+        tcp::socket socket(io_service);
+        boost::system::error_code ec;
+        socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(),
+            port),ec);
+        if (ec) {
+            continue;
+        }
+
+        boost::asio::write(socket,boost::asio::buffer(upgrade_request),ec);
+        boost::asio::streambuf res;
+        boost::asio::read_until(socket,res,"\r\n\r\n",ec);
+
+        // close with a reset so the client side doesn't pile up TIME_WAIT
+        // sockets and run out of ephemeral ports
+        socket.set_option(boost::asio::socket_base::linger(true,0),ec);
+        socket.close(ec);
+    }
+}
+
+void run(size_t accepts, size_t server_threads, size_t client_threads) {
+    unsigned short const port = free_port();
+
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.set_open_handler(&on_open);
+
+    s.init_asio();
+    s.set_listen_backlog(1024);
+    s.set_concurrent_accepts(accepts);
+    s.listen(boost::asio::ip::tcp::v4(),port);
+    s.start_accept();
+
+    std::vector<std::shared_ptr<std::thread> > st;
+    for (size_t i = 0; i < server_threads; i++) {
+        st.push_back(std::make_shared<std::thread>([&s]() { s.run(); }));
+    }
+
+    g_opened = 0;
+    g_running = true;
+
+    std::vector<std::shared_ptr<std::thread> > ct;
+    for (size_t i = 0; i < client_threads; i++) {
+        ct.push_back(std::make_shared<std::thread>(&client_loop,port));
+    }
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    size_t opened = g_opened;
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    g_running = false;
+    for (size_t i = 0; i < ct.size(); i++) {
+        ct[i]->join();
+    }
+
+    s.stop();
+    for (size_t i = 0; i < st.size(); i++) {
+        st[i]->join();
+    }
+
+    std::cout << accepts << " outstanding accepts, " << server_threads
+              << " server threads: " << size_t(opened/elapsed.count())
+              << " accepts/s" << std::endl;
+}
+
+int main() {
+    size_t const accepts[] = {1, 4, 16, 64};
+    size_t const server_threads = 4;
+    size_t const client_threads = 16;
+
+    for (size_t i = 0; i < sizeof(accepts)/sizeof(accepts[0]); i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            run(accepts[i],server_threads,client_threads);
+            return 0;
+        } else if (pid > 0) {
+            waitpid(pid,NULL,0);
+        } else {
+            std::cout << "fork failed" << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
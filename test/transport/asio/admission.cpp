@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE transport_asio_admission
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+#include "test_server.hpp"
+
+typedef websocketpp::transport::asio::accept_limiter accept_limiter;
+
+boost::asio::ip::address addr(std::string const & s) {
+    return boost::asio::ip::address::from_string(s);
+}
+
+BOOST_AUTO_TEST_CASE( limiter_disabled ) {
+    accept_limiter l;
+
+    BOOST_CHECK(!l.enabled());
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK(l.admit(addr("10.0.0.1"),0));
+    }
+    BOOST_CHECK_EQUAL(l.get_num_prefixes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( limiter_global ) {
+    accept_limiter l;
+    l.set_global_limit(2,3);
+    BOOST_CHECK(l.enabled());
+
+    // starts with a full burst
+    BOOST_CHECK(l.admit(addr("10.0.0.1"),1000));
+    BOOST_CHECK(l.admit(addr("10.0.1.1"),1000));
+    BOOST_CHECK(l.admit(addr("10.0.2.1"),1000));
+    BOOST_CHECK(!l.admit(addr("10.0.3.1"),1000));
+
+    // refills at two per second
+    BOOST_CHECK(!l.admit(addr("10.0.3.1"),1499));
+    BOOST_CHECK(l.admit(addr("10.0.3.1"),1500));
+    BOOST_CHECK(!l.admit(addr("10.0.3.1"),1500));
+    BOOST_CHECK(l.admit(addr("10.0.3.1"),2000));
+
+    // but never beyond the burst
+    BOOST_CHECK(l.admit(addr("10.0.3.1"),60000));
+    BOOST_CHECK(l.admit(addr("10.0.3.1"),60000));
+    BOOST_CHECK(l.admit(addr("10.0.3.1"),60000));
+    BOOST_CHECK(!l.admit(addr("10.0.3.1"),60000));
+}
+
+BOOST_AUTO_TEST_CASE( limiter_prefix ) {
+    accept_limiter l;
+    l.set_prefix_limit(1,2,24,64);
+
+    BOOST_CHECK(l.admit(addr("10.0.0.1"),1000));
+    BOOST_CHECK(l.admit(addr("10.0.0.2"),1000));
+    // same /24
+    BOOST_CHECK(!l.admit(addr("10.0.0.200"),1000));
+    // IPv4 mapped addresses share the IPv4 bucket
+    BOOST_CHECK(!l.admit(addr("::ffff:10.0.0.3"),1000));
+    // other prefixes are unaffected
+    BOOST_CHECK(l.admit(addr("10.0.1.1"),1000));
+    BOOST_CHECK(l.admit(addr("2001:db8:0:1::1"),1000));
+    BOOST_CHECK(l.admit(addr("2001:db8:0:1::2"),1000));
+    BOOST_CHECK(!l.admit(addr("2001:db8:0:1:ffff::3"),1000));
+    BOOST_CHECK(l.admit(addr("2001:db8:0:2::1"),1000));
+
+    BOOST_CHECK_EQUAL(l.get_num_prefixes(), 4);
+    BOOST_CHECK(l.admit(addr("10.0.0.1"),2000));
+}
+
+BOOST_AUTO_TEST_CASE( limiter_prefix_partial_byte ) {
+    accept_limiter l;
+    l.set_prefix_limit(1,1,12,64);
+
+    BOOST_CHECK(l.admit(addr("172.16.0.1"),0));
+    BOOST_CHECK(!l.admit(addr("172.31.255.255"),0));
+    BOOST_CHECK(l.admit(addr("172.32.0.1"),0));
+}
+
+BOOST_AUTO_TEST_CASE( limiter_rejection_keeps_tokens ) {
+    accept_limiter l;
+    l.set_global_limit(1,2);
+    l.set_prefix_limit(1,1);
+
+    BOOST_CHECK(l.admit(addr("10.0.0.1"),0));
+    // rejected by its prefix, the global token stays available
+    BOOST_CHECK(!l.admit(addr("10.0.0.2"),0));
+    BOOST_CHECK(l.admit(addr("10.0.1.1"),0));
+    BOOST_CHECK(!l.admit(addr("10.0.2.1"),0));
+}
+
+BOOST_AUTO_TEST_CASE( limiter_max_prefixes ) {
+    accept_limiter l;
+    l.set_prefix_limit(1,1);
+    l.set_max_prefixes(2);
+
+    BOOST_CHECK(l.admit(addr("10.0.0.1"),0));
+    BOOST_CHECK(l.admit(addr("10.0.1.1"),0));
+
+    // table full and nothing has refilled, checked against the global limit
+    // only, which is disabled
+    BOOST_CHECK(l.admit(addr("10.0.2.1"),500));
+    BOOST_CHECK(l.admit(addr("10.0.2.1"),500));
+    BOOST_CHECK_EQUAL(l.get_num_prefixes(), 2);
+
+    // once the tracked prefixes refill they are dropped to make room
+    BOOST_CHECK(l.admit(addr("10.0.2.1"),1500));
+    BOOST_CHECK(!l.admit(addr("10.0.2.1"),1500));
+    BOOST_CHECK_EQUAL(l.get_num_prefixes(), 1);
+}
+
+struct admission_state {
+    admission_state() : allow(false), checked(0) {}
+
+    bool on_admit(boost::asio::ip::tcp::endpoint const & ep) {
+        websocketpp::lib::lock_guard<websocketpp::lib::mutex> lock(mutex);
+        checked++;
+        return allow && ep.address().is_loopback();
+    }
+
+    websocketpp::lib::mutex mutex;
+    bool allow;
+    size_t checked;
+};
+
+BOOST_AUTO_TEST_CASE( admission_handler ) {
+    server s;
+    admission_state a;
+    open_counter c;
+    unsigned short const port = free_port();
+
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.set_open_handler(websocketpp::lib::bind(&open_counter::on_open,&c,
+        websocketpp::lib::placeholders::_1));
+    s.set_admission_handler(websocketpp::lib::bind(&admission_state::on_admit,
+        &a,websocketpp::lib::placeholders::_1));
+
+    s.init_asio();
+    s.listen(boost::asio::ip::tcp::v4(),port);
+    s.start_accept();
+
+    websocketpp::lib::thread t(websocketpp::lib::bind(&run_server,&s));
+
+    for (int i = 0; i < 3; i++) {
+        BOOST_CHECK_EQUAL(handshake(port), "");
+    }
+    BOOST_CHECK_EQUAL(s.get_rejected_accepts(), 3);
+
+    {
+        websocketpp::lib::lock_guard<websocketpp::lib::mutex> lock(a.mutex);
+        a.allow = true;
+    }
+    BOOST_CHECK(upgraded(handshake(port)));
+
+    BOOST_CHECK(c.wait_for(1));
+    BOOST_CHECK_EQUAL(c.get(), 1);
+    BOOST_CHECK_EQUAL(a.checked, 4);
+
+    s.stop();
+    t.join();
+}
+
+BOOST_AUTO_TEST_CASE( accept_rate_limit ) {
+    server s;
+    open_counter c;
+    unsigned short const port = free_port();
+
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.set_open_handler(websocketpp::lib::bind(&open_counter::on_open,&c,
+        websocketpp::lib::placeholders::_1));
+    // two connections, then one every 100 seconds
+    s.set_accept_rate_limit_per_prefix(0.01,2);
+
+    s.init_asio();
+    s.listen(boost::asio::ip::tcp::v4(),port);
+    s.start_accept();
+
+    websocketpp::lib::thread t(websocketpp::lib::bind(&run_server,&s));
+
+    BOOST_CHECK(upgraded(handshake(port)));
+    BOOST_CHECK(upgraded(handshake(port)));
+    BOOST_CHECK_EQUAL(handshake(port), "");
+    BOOST_CHECK_EQUAL(handshake(port), "");
+    BOOST_CHECK_EQUAL(s.get_rejected_accepts(), 2);
+    BOOST_CHECK_EQUAL(s.get_accept_limiter().get_num_prefixes(), 1);
+
+    s.stop();
+    t.join();
+}
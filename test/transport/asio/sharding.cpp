@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE transport_asio_sharding
+#include <boost/test/unit_test.hpp>
+
+#include "test_server.hpp"
+
+#include <websocketpp/concurrency/none.hpp>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/client.hpp>
+
+typedef websocketpp::client<websocketpp::config::asio_client> client;
+
+struct single_threaded_config : public websocketpp::config::asio {
+    typedef websocketpp::concurrency::none concurrency_type;
+
+    struct transport_config : public asio::transport_config {
+        typedef single_threaded_config::concurrency_type concurrency_type;
+        static bool const enable_multithreading = false;
+    };
+
+    typedef websocketpp::transport::asio::endpoint<transport_config>
+        transport_type;
+};
+
+typedef websocketpp::server<single_threaded_config> single_threaded_server;
+
+BOOST_AUTO_TEST_CASE( sharded_init ) {
+    server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+
+    BOOST_CHECK_EQUAL(s.get_num_shards(), 1);
+    s.init_asio_sharded(3);
+    BOOST_CHECK_EQUAL(s.get_num_shards(), 3);
+    BOOST_CHECK(&s.get_io_service(0) == &s.get_io_service());
+    BOOST_CHECK(&s.get_io_service(1) != &s.get_io_service(2));
+
+    websocketpp::lib::error_code ec;
+    s.init_asio_sharded(2,ec);
+    BOOST_CHECK_EQUAL(ec, websocketpp::error::invalid_state);
+}
+
+BOOST_AUTO_TEST_CASE( sharded_requires_multithreading ) {
+    single_threaded_server s;
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+
+    websocketpp::lib::error_code ec;
+    s.init_asio_sharded(2,ec);
+    BOOST_CHECK_EQUAL(ec,
+        websocketpp::transport::asio::error::sharding_requires_multithreading);
+    BOOST_CHECK_EQUAL(s.get_num_shards(), 1);
+}
+
+BOOST_AUTO_TEST_CASE( sharded_connect_rejected ) {
+    client c;
+    c.clear_access_channels(websocketpp::log::alevel::all);
+    c.clear_error_channels(websocketpp::log::elevel::all);
+    c.init_asio_sharded(2);
+
+    websocketpp::lib::error_code ec;
+    client::connection_ptr con = c.get_connection("ws://localhost:9",ec);
+    BOOST_REQUIRE(!ec);
+    c.connect(con);
+    BOOST_CHECK_EQUAL(con->get_ec(),
+        websocketpp::transport::asio::error::sharded_connect);
+}
+
+#ifdef SO_REUSEPORT
+BOOST_AUTO_TEST_CASE( sharded_accept ) {
+    server s;
+    open_counter c;
+    unsigned short const port = free_port();
+    size_t const connections = 32;
+
+    s.clear_access_channels(websocketpp::log::alevel::all);
+    s.clear_error_channels(websocketpp::log::elevel::all);
+    s.set_open_handler(websocketpp::lib::bind(&open_counter::on_open,&c,
+        websocketpp::lib::placeholders::_1));
+
+    s.init_asio_sharded(2);
+    s.listen(boost::asio::ip::tcp::v4(),port);
+    s.start_accept();
+
+    websocketpp::lib::thread st(websocketpp::lib::bind(&run_server,&s));
+
+    boost::asio::io_service io_service;
+    std::vector<websocketpp::lib::shared_ptr<boost::asio::ip::tcp::socket> >
+        sockets;
+
+    for (size_t i = 0; i < connections; i++) {
+        websocketpp::lib::shared_ptr<boost::asio::ip::tcp::socket> socket(
+            new boost::asio::ip::tcp::socket(io_service));
+        BOOST_CHECK(upgraded(handshake(*socket,port)));
+        sockets.push_back(socket);
+    }
+
+    BOOST_CHECK(c.wait_for(connections));
+
+    s.stop();
+    st.join();
+
+    BOOST_CHECK_EQUAL(c.count, connections);
+    // The kernel hashes connections across both acceptors. Each shard runs
+    // its connections on its own thread.
+    BOOST_CHECK_EQUAL(c.threads.size(), 2);
+}
+#endif
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Helpers shared by the asio transport tests that run a real server and talk
+// to it over loopback sockets.
+
+#include <set>
+#include <string>
+
+#include <websocketpp/common/thread.hpp>
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+
+#include <boost/asio.hpp>
+
+typedef websocketpp::server<websocketpp::config::asio> server;
+
+std::string const upgrade_request = "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: upgrade\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+
+inline void run_server(server * s) {
+    s->run();
+}
+
+// Ask the kernel for a port nothing is listening on, so concurrent test runs
+// don't fight over fixed port numbers. The port is released before returning,
+// sharded servers need the same number for every shard's acceptor.
+inline unsigned short free_port() {
+    using boost::asio::ip::tcp;
+
+    boost::asio::io_service io_service;
+    tcp::acceptor acceptor(io_service,tcp::endpoint(tcp::v4(),0));
+    return acceptor.local_endpoint().port();
+}
+
+// Sleep without pulling in a thread library the stl builds don't link.
+inline void sleep_ms(int ms) {
+    boost::asio::io_service io_service;
+    boost::asio::deadline_timer timer(io_service,
+        boost::posix_time::milliseconds(ms));
+    timer.wait();
+}
+
+// Connect a raw socket to the loopback port, send upgrade_request and return
+// the status line of the response, empty if the server closed the socket
+// instead.
+inline std::string handshake(boost::asio::ip::tcp::socket & socket,
+    unsigned short port)
+{
+    using boost::asio::ip::tcp;
+
+    socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(),port));
+
+    boost::system::error_code ec;
+    boost::asio::write(socket,boost::asio::buffer(upgrade_request),ec);
+
+    boost::asio::streambuf res;
+    boost::asio::read_until(socket,res,"\r\n\r\n",ec);
+    if (ec) {
+        return "";
+    }
+
+    std::istream is(&res);
+    std::string status;
+    std::getline(is,status);
+    return status;
+}
+
+// As above on a socket that is closed again before returning
+inline std::string handshake(unsigned short port) {
+    boost::asio::io_service io_service;
+    boost::asio::ip::tcp::socket socket(io_service);
+    return handshake(socket,port);
+}
+
+inline bool upgraded(std::string const & status) {
+    return status.find("101") != std::string::npos;
+}
+
+// Counts open handler calls and the threads they ran on
+struct open_counter {
+    open_counter() : count(0) {}
+
+    void on_open(websocketpp::connection_hdl) {
+        websocketpp::lib::lock_guard<websocketpp::lib::mutex> lock(mutex);
+        threads.insert(websocketpp::lib::this_thread::get_id());
+        count++;
+    }
+
+    size_t get() {
+        websocketpp::lib::lock_guard<websocketpp::lib::mutex> lock(mutex);
+        return count;
+    }
+
+    // The open handler runs after the handshake response has been written, so
+    // a client can see its handshake complete before the count goes up.
+    bool wait_for(size_t n, int timeout_ms = 2000) {
+        for (int waited = 0; get() < n && waited < timeout_ms; waited += 5) {
+            sleep_ms(5);
+        }
+        return get() >= n;
+    }
+
+    websocketpp::lib::mutex mutex;
+    std::set<websocketpp::lib::thread::id> threads;
+    size_t count;
+};
@@ -35,6 +35,7 @@
 
 #include <websocketpp/transport/asio/endpoint.hpp>
 #include <websocketpp/transport/asio/security/tls.hpp>
+#include <websocketpp/transport/asio/timer_wheel.hpp>
 
 // Concurrency
 #include <websocketpp/concurrency/none.hpp>
@@ -97,6 +98,10 @@ struct config {
 
     static const bool enable_multithreading = true;
 
+    static const bool enable_timer_wheel = false;
+    static const long timer_wheel_resolution = 50;
+    static const size_t timer_wheel_slots = 256;
+
     static const long timeout_socket_pre_init = 1000;
     static const long timeout_proxy = 1000;
     static const long timeout_socket_post_init = 1000;
@@ -185,3 +190,74 @@ BOOST_AUTO_TEST_CASE( tls_handshake_timeout ) {
     endpoint.connect("wss://localhost:9005");
     endpoint.run();
 }
+
+struct wheel_log {
+    void on_timer(int id, websocketpp::lib::error_code const & ec) {
+        ids.push_back(id);
+        codes.push_back(ec);
+    }
+
+    std::vector<int> ids;
+    std::vector<websocketpp::lib::error_code> codes;
+};
+
+BOOST_AUTO_TEST_CASE( timer_wheel_expiry_order ) {
+    using websocketpp::transport::asio::timer_wheel;
+    using websocketpp::lib::bind;
+    using websocketpp::lib::placeholders::_1;
+
+    boost::asio::io_service io_service;
+    timer_wheel::ptr wheel(new timer_wheel(io_service,10,8));
+    wheel_log log;
+
+    // 250ms wraps the 80ms wheel several times
+    wheel->set_timer(250,bind(&wheel_log::on_timer,&log,3,_1));
+    wheel->set_timer(5,bind(&wheel_log::on_timer,&log,1,_1));
+    wheel->set_timer(45,bind(&wheel_log::on_timer,&log,2,_1));
+
+    BOOST_CHECK_EQUAL(wheel->get_pending(), 3);
+
+    boost::posix_time::ptime start =
+        boost::posix_time::microsec_clock::universal_time();
+    io_service.run();
+    long elapsed = (boost::posix_time::microsec_clock::universal_time()
+        - start).total_milliseconds();
+
+    BOOST_REQUIRE_EQUAL(log.ids.size(), 3);
+    BOOST_CHECK_EQUAL(log.ids[0], 1);
+    BOOST_CHECK_EQUAL(log.ids[1], 2);
+    BOOST_CHECK_EQUAL(log.ids[2], 3);
+    BOOST_CHECK(!log.codes[2]);
+    BOOST_CHECK(elapsed >= 250);
+    BOOST_CHECK_EQUAL(wheel->get_pending(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( timer_wheel_cancel ) {
+    using websocketpp::transport::asio::timer_wheel;
+    using websocketpp::lib::bind;
+    using websocketpp::lib::placeholders::_1;
+
+    boost::asio::io_service io_service;
+    timer_wheel::ptr wheel(new timer_wheel(io_service,10,8));
+    wheel_log log;
+
+    timer_wheel::timer_ptr t = wheel->set_timer(5000,
+        bind(&wheel_log::on_timer,&log,1,_1));
+    BOOST_CHECK(!t->expires_from_now().is_negative());
+
+    t->cancel();
+    t->cancel();
+    BOOST_CHECK_EQUAL(wheel->get_pending(), 0);
+
+    // the cancelled timer does not hold the io_service open for 5 seconds
+    boost::posix_time::ptime start =
+        boost::posix_time::microsec_clock::universal_time();
+    io_service.run();
+    long elapsed = (boost::posix_time::microsec_clock::universal_time()
+        - start).total_milliseconds();
+
+    BOOST_REQUIRE_EQUAL(log.ids.size(), 1);
+    BOOST_CHECK_EQUAL(log.codes[0],
+        websocketpp::transport::error::operation_aborted);
+    BOOST_CHECK(elapsed < 1000);
+}
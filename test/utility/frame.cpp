@@ -536,3 +536,90 @@ BOOST_AUTO_TEST_CASE( continuous_word_mask2 ) {
 	frame::word_mask_circ(buffer,12,pkey);
 	BOOST_CHECK( std::equal(buffer,buffer+12,unmasked) );
 }
+
+// Checks a masking kernel against byte_mask for a range of lengths and
+// unaligned starting offsets, including the returned prepared key.
+void check_mask_kernel(frame::simd::mask_kernel kernel) {
+	uint8_t input[300];
+	uint8_t output[300];
+	uint8_t expected[300];
+
+	for (size_t i = 0; i < 300; i++) {
+		input[i] = static_cast<uint8_t>(i*7+3);
+	}
+
+	frame::masking_key_type key;
+	key.c[0] = 0xEE;
+	key.c[1] = 0x70;
+	key.c[2] = 0xFB;
+	key.c[3] = 0xD5;
+
+	size_t pkey = frame::prepare_masking_key(key);
+
+	for (size_t offset = 0; offset < 4; offset++) {
+		for (size_t len = 0; len < 260; len++) {
+			frame::byte_mask(input+offset,input+offset+len,expected,key,0);
+			std::fill_n(output,300,0x00);
+
+			size_t pkey_out = kernel(input+offset,output,len,pkey);
+
+			BOOST_CHECK( std::equal(expected,expected+len,output) );
+			BOOST_CHECK_EQUAL( pkey_out,
+				frame::circshift_prepared_key(pkey,len%sizeof(size_t)) );
+		}
+	}
+
+	// streaming: feed the output key of one call into the next
+	size_t pkey_temp = pkey;
+	frame::byte_mask(input,input+255,expected,key,0);
+	std::fill_n(output,300,0x00);
+	pkey_temp = kernel(input,output,37,pkey_temp);
+	pkey_temp = kernel(input+37,output+37,100,pkey_temp);
+	pkey_temp = kernel(input+137,output+137,118,pkey_temp);
+	BOOST_CHECK( std::equal(expected,expected+255,output) );
+}
+
+BOOST_AUTO_TEST_CASE( simd_mask_portable ) {
+	check_mask_kernel(&frame::simd::mask_portable);
+}
+
+BOOST_AUTO_TEST_CASE( simd_mask_sse2 ) {
+#ifdef WEBSOCKETPP_X86_SIMD
+	if (lib::cpu::get_features().sse2) {
+		check_mask_kernel(&frame::simd::mask_sse2);
+	}
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( simd_mask_avx2 ) {
+#ifdef WEBSOCKETPP_X86_SIMD
+	if (lib::cpu::get_features().avx2) {
+		check_mask_kernel(&frame::simd::mask_avx2);
+	}
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( simd_mask_dispatch ) {
+	check_mask_kernel(frame::simd::get_mask_kernel());
+	check_mask_kernel(&frame::word_mask_circ);
+}
+
+BOOST_AUTO_TEST_CASE( simd_word_mask_exact ) {
+	uint8_t input[67];
+	uint8_t output[67];
+	uint8_t expected[67];
+
+	for (size_t i = 0; i < 67; i++) {
+		input[i] = static_cast<uint8_t>(i);
+	}
+
+	frame::masking_key_type key;
+	key.i = 0x12345678;
+
+	frame::byte_mask(input,input+67,expected,key,0);
+	frame::word_mask_exact(input,output,67,key);
+	BOOST_CHECK( std::equal(expected,expected+67,output) );
+
+	frame::word_mask_exact(input,67,key);
+	BOOST_CHECK( std::equal(expected,expected+67,input) );
+}
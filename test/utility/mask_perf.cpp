@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2011, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <websocketpp/frame.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace websocketpp;
+
+class scoped_timer {
+public:
+	scoped_timer(std::string i, size_t bytes)
+	  : m_id(i)
+	  , m_bytes(bytes)
+	  , m_start(std::chrono::steady_clock::now())
+	{
+		std::cout << "Clock " << i << ": ";
+	}
+	~scoped_timer() {
+		std::chrono::nanoseconds time_taken = std::chrono::steady_clock::now()-m_start;
+
+		// bytes per nanosecond == GB/s
+		std::cout << double(m_bytes)/double(time_taken.count()) << " GB/s"
+		          << std::endl;
+	}
+
+private:
+	std::string m_id;
+	size_t m_bytes;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+size_t run(std::string const & name, frame::simd::mask_kernel kernel,
+	std::vector<uint8_t> & buf, size_t chunk, size_t iterations)
+{
+	frame::masking_key_type key;
+	key.i = 0x12345678;
+	size_t pkey = frame::prepare_masking_key(key);
+
+	scoped_timer timer(name,chunk*iterations);
+	for (size_t i = 0; i < iterations; i++) {
+		pkey = kernel(&buf[0],&buf[0],chunk,pkey);
+	}
+	return pkey;
+}
+
+int main() {
+	size_t const sizes[] = {64, 1024, 16384, 1048576};
+	size_t const total = 1 << 30;
+	size_t sink = 0;
+
+	for (size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++) {
+		std::vector<uint8_t> buf(sizes[s]+1,0x55);
+		size_t iterations = total/sizes[s];
+
+		std::cout << "-- " << sizes[s] << " byte chunks" << std::endl;
+
+		sink ^= run("portable",&frame::simd::mask_portable,buf,sizes[s],
+			iterations);
+#ifdef WEBSOCKETPP_X86_SIMD
+		if (lib::cpu::get_features().sse2) {
+			sink ^= run("sse2",&frame::simd::mask_sse2,buf,sizes[s],
+				iterations);
+		}
+		if (lib::cpu::get_features().avx2) {
+			sink ^= run("avx2",&frame::simd::mask_avx2,buf,sizes[s],
+				iterations);
+		}
+#endif
+		sink ^= run("word_mask_circ",&frame::word_mask_circ,buf,sizes[s],
+			iterations);
+	}
+
+	return sink == 0xdeadbeef ? 1 : 0;
+}
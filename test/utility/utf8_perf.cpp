@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2011, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <websocketpp/utf8_validator.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+using namespace websocketpp;
+
+class scoped_timer {
+public:
+	scoped_timer(std::string i, size_t bytes)
+	  : m_id(i)
+	  , m_bytes(bytes)
+	  , m_start(std::chrono::steady_clock::now())
+	{
+		std::cout << "Clock " << i << ": ";
+	}
+	~scoped_timer() {
+		std::chrono::nanoseconds time_taken = std::chrono::steady_clock::now()-m_start;
+
+		// bytes per nanosecond == GB/s
+		std::cout << double(m_bytes)/double(time_taken.count()) << " GB/s"
+		          << std::endl;
+	}
+
+private:
+	std::string m_id;
+	size_t m_bytes;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+// The byte by byte DFA, as validator::decode ran before the vector kernels
+bool dfa(uint8_t const * data, size_t length, uint32_t & state,
+	uint32_t & codepoint)
+{
+	for (size_t i = 0; i < length; i++) {
+		if (utf8_validator::decode(&state,&codepoint,data[i])
+			== utf8_validator::utf8_reject)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t run(std::string const & name, utf8_validator::simd::utf8_kernel kernel,
+	std::string const & buf, size_t iterations)
+{
+	uint8_t const * data = reinterpret_cast<uint8_t const *>(buf.data());
+	size_t valid = 0;
+
+	scoped_timer timer(name,buf.size()*iterations);
+	for (size_t i = 0; i < iterations; i++) {
+		uint32_t state = utf8_validator::utf8_accept;
+		uint32_t codepoint = 0;
+		valid += kernel(data,buf.size(),state,codepoint);
+	}
+	return valid;
+}
+
+std::string fill(std::string const & pattern, size_t size) {
+	std::string s;
+	while (s.size() < size) {
+		s += pattern;
+	}
+	return s;
+}
+
+int main() {
+	size_t const total = 1 << 30;
+	size_t sink = 0;
+
+	std::string const corpora[] = {
+		"{\"id\":12345,\"type\":\"quote\",\"symbol\":\"EURUSD\",\"bid\":1.0842},",
+		"{\"user\":\"J\xC3\xBCrgen\",\"city\":\"M\xC3\xBCnchen\",\"msg\":\"ok\"},",
+		"\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE3\x81\xAE\xE3\x83\x86\xE3\x82"
+		"\xAD\xE3\x82\xB9\xE3\x83\x88"
+	};
+	char const * const names[] = {"ascii json", "latin json", "cjk"};
+	size_t const sizes[] = {64, 1024, 16384, 1048576};
+
+	for (size_t c = 0; c < 3; c++) {
+		for (size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++) {
+			std::string buf = fill(corpora[c],sizes[s]);
+			size_t iterations = total/buf.size();
+
+			std::cout << "-- " << names[c] << ", " << buf.size() << " bytes"
+			          << std::endl;
+
+			sink += run("dfa",&dfa,buf,iterations);
+			sink += run("portable",&utf8_validator::simd::validate_portable,
+				buf,iterations);
+#ifdef WEBSOCKETPP_X86_SIMD
+			if (lib::cpu::get_features().avx2) {
+				sink += run("avx2",&utf8_validator::simd::validate_avx2,buf,
+					iterations);
+			}
+#endif
+		}
+	}
+
+	return sink == 0 ? 1 : 0;
+}
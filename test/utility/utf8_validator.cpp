@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2011, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+//#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE utf8_validator
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <websocketpp/utf8_validator.hpp>
+
+using namespace websocketpp;
+
+// Result of feeding a buffer through a validator: whether any byte was
+// rejected and, if not, whether it ended on a codepoint boundary.
+struct result {
+	result(bool d, bool c) : decoded(d), complete(c) {}
+	bool operator==(result const & o) const {
+		return decoded == o.decoded && (!decoded || complete == o.complete);
+	}
+	bool decoded;
+	bool complete;
+};
+
+result reference(std::string const & s) {
+	utf8_validator::validator v;
+	bool d = v.decode(s.begin(),s.end());
+	return result(d,v.complete());
+}
+
+result run_kernel(utf8_validator::simd::utf8_kernel kernel,
+	std::string const & s, size_t split)
+{
+	uint8_t const * data = reinterpret_cast<uint8_t const *>(s.data());
+	uint32_t state = utf8_validator::utf8_accept;
+	uint32_t codepoint = 0;
+
+	if (!kernel(data,split,state,codepoint)) {
+		return result(false,false);
+	}
+	if (!kernel(data+split,s.size()-split,state,codepoint)) {
+		return result(false,false);
+	}
+	return result(true,state == utf8_validator::utf8_accept);
+}
+
+std::vector<std::string> sequences() {
+	char const * const raw[] = {
+		"a", "\x7F", "\xC2\x80", "\xDF\xBF", "\xE0\xA0\x80", "\xE2\x82\xAC",
+		"\xED\x9F\xBF", "\xEE\x80\x80", "\xEF\xBF\xBF", "\xF0\x90\x80\x80",
+		"\xF4\x8F\xBF\xBF",
+		// invalid
+		"\x80", "\xBF", "\xC0\x80", "\xC1\xBF", "\xE0\x80\x80",
+		"\xE0\x9F\xBF", "\xED\xA0\x80", "\xED\xBF\xBF", "\xF0\x80\x80\x80",
+		"\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80",
+		"\xF8\x88\x80\x80\x80", "\xFE", "\xFF", "\xC2", "\xE2\x82",
+		"\xF0\x90\x80", "\xC2\x41", "\xE2\x41\x82", "\x80\x80",
+		"\xC2\x80\x80"
+	};
+	return std::vector<std::string>(raw,raw+sizeof(raw)/sizeof(raw[0]));
+}
+
+// Checks a validation kernel against the byte by byte DFA with every test
+// sequence placed at every offset around the vector block boundaries, in
+// ASCII and in multibyte surroundings, split into two fragments.
+void check_utf8_kernel(utf8_validator::simd::utf8_kernel kernel) {
+	std::vector<std::string> seqs = sequences();
+	std::string const fills[] = {"x", "\xC3\xA9", "\xE6\x97\xA5"};
+
+	for (size_t f = 0; f < 3; f++) {
+		for (size_t q = 0; q < seqs.size(); q++) {
+			for (size_t offset = 0; offset < 70; offset++) {
+				std::string s;
+				while (s.size() < offset) {
+					s += fills[f];
+				}
+				s += seqs[q];
+				while (s.size() < 100) {
+					s += fills[f];
+				}
+
+				result expected = reference(s);
+				BOOST_CHECK( run_kernel(kernel,s,0) == expected );
+				BOOST_CHECK( run_kernel(kernel,s,offset+1) == expected );
+			}
+		}
+	}
+
+	// random mixtures of valid and invalid pieces, split at every position
+	std::srand(42);
+	for (size_t n = 0; n < 500; n++) {
+		std::string s;
+		size_t pieces = std::rand() % 60;
+		for (size_t p = 0; p < pieces; p++) {
+			int r = std::rand() % 100;
+			if (r < 60) {
+				s += static_cast<char>('A' + std::rand() % 26);
+			} else if (r < 97) {
+				s += seqs[std::rand() % 11];
+			} else {
+				s += seqs[std::rand() % seqs.size()];
+			}
+		}
+
+		result expected = reference(s);
+		for (size_t split = 0; split <= s.size(); split++) {
+			BOOST_CHECK( run_kernel(kernel,s,split) == expected );
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( simd_utf8_portable ) {
+	check_utf8_kernel(&utf8_validator::simd::validate_portable);
+}
+
+BOOST_AUTO_TEST_CASE( simd_utf8_avx2 ) {
+#ifdef WEBSOCKETPP_X86_SIMD
+	if (lib::cpu::get_features().avx2) {
+		check_utf8_kernel(&utf8_validator::simd::validate_avx2);
+	}
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( validate_strings ) {
+	BOOST_CHECK( utf8_validator::validate("") );
+	BOOST_CHECK( utf8_validator::validate("{\"key\":\"value\",\"n\":[1,2,3]}") );
+	BOOST_CHECK( utf8_validator::validate(
+		"Hello-\xC2\xB5@\xC3\x9F\xC3\xB6\xC3\xA4\xC3\xBC\xC3\xA0\xC3\xA1-UTF-8!!") );
+	BOOST_CHECK( !utf8_validator::validate(
+		"Hello-\xC2\xB5@\xC3\x9F\xC3\xB6\xC3\xA4\xC3\xBC\xC3\xA0\xC3\xA1-UTF-8!!\xC0") );
+	BOOST_CHECK( !utf8_validator::validate(
+		"0123456789012345678901234567890123456789\xED\xA0\x80") );
+}
+
+BOOST_AUTO_TEST_CASE( streaming_across_fragments ) {
+	// a 4 byte codepoint split between three fragments
+	std::string s(40,'a');
+	s += "\xF0\x9F\x98\x80";
+	s += std::string(40,'b');
+
+	uint8_t const * data = reinterpret_cast<uint8_t const *>(s.data());
+
+	utf8_validator::validator v;
+	BOOST_CHECK( v.decode(data,41) );
+	BOOST_CHECK( v.decode(data+41,2) );
+	BOOST_CHECK( !v.complete() );
+	BOOST_CHECK( v.decode(data+43,s.size()-43) );
+	BOOST_CHECK( v.complete() );
+
+	// the same codepoint truncated at the end of the message
+	v.reset();
+	BOOST_CHECK( v.decode(data,42) );
+	BOOST_CHECK( !v.complete() );
+
+	// and followed by an ASCII byte in the next fragment
+	BOOST_CHECK( !v.decode(data+80,4) );
+}
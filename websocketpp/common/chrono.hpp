@@ -34,10 +34,14 @@
     #endif
 #endif
 
+#include <websocketpp/common/stdint.hpp>
+
 #ifdef _WEBSOCKETPP_CPP11_CHRONO_
     #include <chrono>
 #else
     #include <boost/chrono.hpp>
+    #include <boost/date_time/gregorian/gregorian_types.hpp>
+    #include <boost/date_time/posix_time/posix_time_types.hpp>
 #endif
 
 namespace websocketpp {
@@ -49,6 +53,25 @@ namespace lib {
     using boost::chrono::system_clock;
 #endif
 
+/// Current time in milliseconds, used for deadlines
+/**
+ * Monotonic when std::chrono is available. Boost builds use the header only
+ * Boost.Date_Time clock rather than Boost.Chrono's steady_clock, which needs
+ * its compiled library, and follow the system time.
+ *
+ * @return Milliseconds since an unspecified epoch.
+ */
+inline uint64_t now_ms() {
+#ifdef _WEBSOCKETPP_CPP11_CHRONO_
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    static boost::posix_time::ptime const epoch(boost::gregorian::date(1970,1,1));
+    return (boost::posix_time::microsec_clock::universal_time() - epoch)
+        .total_milliseconds();
+#endif
+}
+
 } // namespace lib
 } // namespace websocketpp
 
@@ -53,6 +53,9 @@
     #ifndef _WEBSOCKETPP_INITIALIZER_LISTS_
         #define _WEBSOCKETPP_INITIALIZER_LISTS_
     #endif
+    #ifndef _WEBSOCKETPP_THREAD_LOCAL_
+        #define _WEBSOCKETPP_THREAD_LOCAL_
+    #endif
 #else
     // Test for noexcept
     #ifndef _WEBSOCKETPP_NOEXCEPT_TOKEN_
@@ -90,6 +93,11 @@
     #if __has_feature(cxx_generalized_initializers) && !defined(_WEBSOCKETPP_INITIALIZER_LISTS_)
         #define _WEBSOCKETPP_INITIALIZER_LISTS_
     #endif
+
+    // Enable thread_local on clang when available.
+    #if __has_feature(cxx_thread_local) && !defined(_WEBSOCKETPP_THREAD_LOCAL_)
+        #define _WEBSOCKETPP_THREAD_LOCAL_
+    #endif
 #endif
 
 #endif // WEBSOCKETPP_COMMON_CPP11_HPP
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_COMMON_CPU_HPP
+#define WEBSOCKETPP_COMMON_CPU_HPP
+
+/**
+ * Runtime CPU feature detection used to select vectorized code paths. Only
+ * x86 and x86-64 targets built with GCC, Clang, or MSVC are probed. Defining
+ * WEBSOCKETPP_NO_SIMD disables all detection and every query reports false.
+ */
+
+#if !defined(WEBSOCKETPP_NO_SIMD)
+    #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        #include <intrin.h>
+        #define WEBSOCKETPP_X86_SIMD
+    #elif (defined(__GNUC__) || defined(__clang__)) && \
+          (defined(__x86_64__) || defined(__i386__))
+        #include <cpuid.h>
+        #define WEBSOCKETPP_X86_SIMD
+    #endif
+#endif
+
+#ifdef WEBSOCKETPP_X86_SIMD
+    #include <emmintrin.h>
+    #include <immintrin.h>
+
+    // GCC and Clang only emit vector instructions for ISAs enabled on the
+    // command line unless a function is explicitly retargeted.
+    #if defined(__GNUC__) || defined(__clang__)
+        #define WEBSOCKETPP_TARGET_SSE2 __attribute__((target("sse2")))
+        #define WEBSOCKETPP_TARGET_AVX2 __attribute__((target("avx2")))
+    #else
+        #define WEBSOCKETPP_TARGET_SSE2
+        #define WEBSOCKETPP_TARGET_AVX2
+    #endif
+#endif
+
+namespace websocketpp {
+namespace lib {
+namespace cpu {
+
+/// Set of instruction set extensions relevant to the library
+struct features {
+    features() : sse2(false), avx2(false) {}
+
+    bool sse2;
+    bool avx2;
+};
+
+#ifdef WEBSOCKETPP_X86_SIMD
+namespace detail {
+
+inline void cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r,leaf,subleaf);
+    for (int i = 0; i < 4; i++) {
+        regs[i] = static_cast<unsigned int>(r[i]);
+    }
+#else
+    __cpuid_count(leaf,subleaf,regs[0],regs[1],regs[2],regs[3]);
+#endif
+}
+
+inline unsigned int cpuid_max_leaf() {
+#ifdef _MSC_VER
+    int r[4];
+    __cpuid(r,0);
+    return static_cast<unsigned int>(r[0]);
+#else
+    return __get_cpuid_max(0,0);
+#endif
+}
+
+/// Read the low word of extended control register 0
+inline unsigned long long xgetbv0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+inline features probe() {
+    features f;
+    unsigned int regs[4] = {0,0,0,0};
+
+    unsigned int max_leaf = cpuid_max_leaf();
+    if (max_leaf < 1) {
+        return f;
+    }
+
+    cpuid(1,0,regs);
+    f.sse2 = (regs[3] & (1u << 26)) != 0;
+
+    // AVX state must be enabled by the OS (OSXSAVE + XCR0 bits 1 and 2)
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+    if (!osxsave || !avx || (xgetbv0() & 0x6) != 0x6 || max_leaf < 7) {
+        return f;
+    }
+
+    cpuid(7,0,regs);
+    f.avx2 = (regs[1] & (1u << 5)) != 0;
+
+    return f;
+}
+
+} // namespace detail
+#endif // WEBSOCKETPP_X86_SIMD
+
+/// Returns the instruction set extensions supported by the running CPU
+/**
+ * Detection runs once, the result is cached for the life of the process.
+ *
+ * @return The detected feature set
+ */
+inline features const & get_features() {
+#ifdef WEBSOCKETPP_X86_SIMD
+    static features const f = detail::probe();
+#else
+    static features const f;
+#endif
+    return f;
+}
+
+} // namespace cpu
+} // namespace lib
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_COMMON_CPU_HPP
@@ -53,12 +53,14 @@ namespace lib {
     using std::thread;
     using std::unique_lock;
     using std::condition_variable;
+    namespace this_thread = std::this_thread;
 #else
     using boost::mutex;
     using boost::lock_guard;
     using boost::thread;
     using boost::unique_lock;
     using boost::condition_variable;
+    namespace this_thread = boost::this_thread;
 #endif
 
 } // namespace lib
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_CONCURRENCY_MPSC_QUEUE_HPP
+#define WEBSOCKETPP_CONCURRENCY_MPSC_QUEUE_HPP
+
+#include <websocketpp/common/atomic.hpp>
+
+#include <cstddef>
+
+namespace websocketpp {
+namespace concurrency {
+
+/// Lock-free multi-producer single-consumer queue
+/**
+ * Producers push onto an intrusive singly linked stack with a single
+ * compare-and-swap. The consumer takes the whole stack with one atomic
+ * exchange and reverses it, so values are delivered in the order they were
+ * pushed. Producers never wait on the consumer or on each other beyond
+ * retrying a failed compare-and-swap.
+ *
+ * push may be called from any number of threads concurrently. pop_all must
+ * only be called by one thread at a time.
+ */
+template <typename T>
+class mpsc_queue {
+public:
+    mpsc_queue() : m_head(NULL) {}
+
+    ~mpsc_queue() {
+        node * n = m_head.exchange(NULL,lib::memory_order_acquire);
+        while (n) {
+            node * next = n->next;
+            delete n;
+            n = next;
+        }
+    }
+
+    /// Push a value onto the queue
+    /**
+     * Thread safe with respect to other calls to push and pop_all.
+     *
+     * @param value The value to push
+     * @return Whether the queue was empty before this value was pushed. A
+     * producer that sees true is the first since the last pop_all.
+     */
+    bool push(T const & value) {
+        node * n = new node(value);
+        node * old_head = m_head.load(lib::memory_order_relaxed);
+
+        do {
+            n->next = old_head;
+        } while (!m_head.compare_exchange_weak(old_head,n,
+            lib::memory_order_release,lib::memory_order_relaxed));
+
+        return (old_head == NULL);
+    }
+
+    /// Remove all values from the queue
+    /**
+     * Values are passed to `out` in the order they were pushed. Only one
+     * thread may call pop_all at a time.
+     *
+     * @param out A functor called once with each value
+     * @return The number of values removed
+     */
+    template <typename Functor>
+    size_t pop_all(Functor & out) {
+        node * n = m_head.exchange(NULL,lib::memory_order_acquire);
+
+        if (!n) {
+            return 0;
+        }
+
+        // reverse the stack into push order
+        node * ordered = NULL;
+        while (n) {
+            node * next = n->next;
+            n->next = ordered;
+            ordered = n;
+            n = next;
+        }
+
+        size_t count = 0;
+        while (ordered) {
+            node * next = ordered->next;
+            out(ordered->value);
+            delete ordered;
+            ordered = next;
+            ++count;
+        }
+
+        return count;
+    }
+
+    /// Returns whether the queue was empty at the time of the call
+    bool empty() const {
+        return (m_head.load(lib::memory_order_acquire) == NULL);
+    }
+private:
+    struct node {
+        explicit node(T const & v) : value(v), next(NULL) {}
+
+        T value;
+        node * next;
+    };
+
+    // non-copyable
+    mpsc_queue(mpsc_queue const &);
+    mpsc_queue & operator=(mpsc_queue const &);
+
+    lib::atomic<node *> m_head;
+};
+
+} // namespace concurrency
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_CONCURRENCY_MPSC_QUEUE_HPP
@@ -110,6 +110,21 @@ struct core_client {
         /// threaded applications
         static bool const enable_multithreading = true;
 
+        /// Controls compile time selection of the asio transport's timers
+        /**
+         * When false each timer is its own asio deadline_timer. When true the
+         * timers of all connections on an io_service are entries in one
+         * hashed timer wheel driven by a single deadline_timer. Wheel timers
+         * fire on the first tick after their deadline.
+         */
+        static bool const enable_timer_wheel = false;
+
+        /// Length of one timer wheel tick (in ms)
+        static const long timer_wheel_resolution = 50;
+
+        /// Number of ticks in one revolution of the timer wheel
+        static const size_t timer_wheel_slots = 256;
+
         /// Default timer values (in ms)
 
         /// Length of time to wait for socket pre-initialization
@@ -193,6 +208,117 @@ struct core_client {
     ///
     static const size_t connection_read_buffer_size = 16384;
 
+    /// Borrow the read buffer only while data is arriving
+    /**
+     * When true, an idle open connection waits for data with a small embedded
+     * buffer of connection_read_probe_size bytes instead of holding a full
+     * connection_read_buffer_size buffer. A full buffer is borrowed from a
+     * per-thread pool for the opening handshake and while a read fills the
+     * probe buffer or a frame is partially received, and is returned once the
+     * connection reaches a message boundary with no more data pending.
+     */
+    static const bool enable_lazy_read_buffer = false;
+
+    /// Size of the embedded read buffer used by idle connections
+    /**
+     * Only used when enable_lazy_read_buffer is set.
+     */
+    static const size_t connection_read_probe_size = 64;
+
+    /// Free handshake state once the connection is open
+    /**
+     * When true, the handshake request and response, the raw handshake
+     * buffer and the list of requested subprotocols are cleared after the
+     * open handler returns, freeing the memory they hold for the rest of the
+     * connection's life. Request and response headers are then only
+     * available up to and during the open handler. The URI and the selected
+     * subprotocol are kept.
+     */
+    static const bool release_handshake_state = false;
+
+    /// Recycle connection storage through a per-thread pool
+    /**
+     * When true, endpoints allocate each new connection together with its
+     * shared_ptr control block from a per-thread free list, and return the
+     * storage there once the last connection_ptr and connection_hdl are
+     * gone, rather than allocating and freeing every connection on the heap.
+     *
+     * Only the storage is pooled. Each connection is still constructed from
+     * scratch and destroyed with its last connection_ptr, no state carries
+     * over from one connection to the next. See
+     * endpoint::prewarm_connections and endpoint::get_connection_pool_stats.
+     */
+    static const bool enable_connection_pool = false;
+
+    /// Maximum number of free connection blocks cached per thread
+    static const size_t connection_pool_size = 256;
+
+    /// Default number of accepts a server keeps outstanding per shard
+    /**
+     * Each outstanding accept holds a connection created ahead of time. With
+     * more than one, several connection attempts can be accepted and
+     * handshaked in parallel by the threads running the transport instead of
+     * one accept being re-armed at a time. See server::set_concurrent_accepts.
+     */
+    static const size_t concurrent_accepts = 1;
+
+    /// Maximum number of queued messages to coalesce into a single write
+    /**
+     * When more than one message is waiting in a connection's send queue they
+     * are flushed together with one scatter/gather transport write. This
+     * value limits how many messages a single write may contain. A value of
+     * 1 disables coalescing.
+     */
+    static const size_t connection_write_coalesce_messages = 64;
+
+    /// Maximum number of bytes to coalesce into a single write
+    /**
+     * Additional queued messages are only added to a write while the total
+     * header and payload size stays within this limit. The first message of a
+     * write is always sent regardless of its size.
+     */
+    static const size_t connection_write_coalesce_bytes = 65536;
+
+    /// Use a lock-free queue for outgoing data messages
+    /**
+     * When true, send frames data messages without holding the connection's
+     * write lock and hands them to the writer through a lock-free
+     * multi-producer queue. This reduces contention when many threads send on
+     * the same connection. Messages whose framing depends on shared state,
+     * such as compressed messages, are still framed one at a time.
+     */
+    static const bool enable_lockfree_send_queue = false;
+
+    /// Default high watermark for buffered outgoing bytes
+    /**
+     * When the payload bytes queued on a connection but not yet written rise
+     * to this value the high watermark handler is called. A value of 0
+     * disables the watermark handlers. See connection::set_send_watermarks.
+     */
+    static const size_t send_high_watermark = 0;
+
+    /// Default low watermark for buffered outgoing bytes
+    /**
+     * After the high watermark handler was called, the low watermark handler
+     * is called once the buffered bytes fall to this value.
+     */
+    static const size_t send_low_watermark = 0;
+
+    /// Default maximum number of buffered outgoing bytes
+    /**
+     * Sends that would exceed this limit fail with error::send_queue_full. A
+     * value of 0 disables the limit. See connection::set_max_buffered_amount.
+     */
+    static const size_t send_buffer_limit = 0;
+
+    /// Default maximum message size
+    /**
+     * Incoming messages larger than this are rejected with close code 1009
+     * (message too big). A value of 0 disables the limit. See
+     * connection::set_max_message_size.
+     */
+    static const size_t max_message_size = 32000000;
+
     /// Drop connections immediately on protocol error.
     /**
      * Drop connections on protocol error rather than sending a close frame.
@@ -29,6 +29,8 @@
 #define WEBSOCKETPP_CONNECTION_HPP
 
 #include <websocketpp/close.hpp>
+#include <websocketpp/concurrency/mpsc_queue.hpp>
+#include <websocketpp/common/atomic.hpp>
 #include <websocketpp/common/connection_hdl.hpp>
 #include <websocketpp/common/cpp11.hpp>
 #include <websocketpp/common/functional.hpp>
@@ -36,8 +38,11 @@
 #include <websocketpp/frame.hpp>
 #include <websocketpp/http/constants.hpp>
 #include <websocketpp/logger/levels.hpp>
+#include <websocketpp/message_buffer/block_pool.hpp>
+#include <websocketpp/message_buffer/send_queue.hpp>
 #include <websocketpp/processors/processor.hpp>
 #include <websocketpp/transport/base/connection.hpp>
+#include <websocketpp/utf8_validator.hpp>
 
 #include <algorithm>
 #include <iostream>
@@ -149,6 +154,25 @@ typedef lib::function<bool(connection_hdl)> validate_handler;
  */
 typedef lib::function<void(connection_hdl)> http_handler;
 
+/// The type and function signature of a high watermark handler
+/**
+ * The high watermark handler is called when the number of buffered outgoing
+ * payload bytes rises to or above the connection's high watermark. It is
+ * typically used to pause producers until the low watermark handler is called.
+ *
+ * It is called from the thread that queued the message that crossed the mark.
+ */
+typedef lib::function<void(connection_hdl)> high_watermark_handler;
+
+/// The type and function signature of a low watermark handler
+/**
+ * The low watermark handler is called when the number of buffered outgoing
+ * payload bytes falls to or below the connection's low watermark after the
+ * high watermark handler was called. It is called from the thread that
+ * dispatches writes to the transport.
+ */
+typedef lib::function<void(connection_hdl)> low_watermark_handler;
+
 //
 typedef lib::function<void(lib::error_code const & ec, size_t bytes_transferred)> read_handler;
 typedef lib::function<void(lib::error_code const & ec)> write_frame_handler;
@@ -262,9 +286,27 @@ public:
     typedef processor::processor<config> processor_type;
     typedef lib::shared_ptr<processor_type> processor_ptr;
 
+    /// Type of the per-thread pool read buffers are borrowed from
+    typedef message_buffer::block_pool<config::connection_read_buffer_size>
+        read_buffer_pool;
+
     // Message handler (needs to know message type)
     typedef lib::function<void(connection_hdl,message_ptr)> message_handler;
 
+    /// Type of a non-owning view of a received message
+    typedef message_buffer::message_view message_view;
+
+    /// Zero copy message handler
+    typedef lib::function<void(connection_hdl,message_view const &)>
+        message_view_handler;
+
+    /// Type of a partial received message
+    typedef message_buffer::message_chunk message_chunk;
+
+    /// Streaming message handler
+    typedef lib::function<void(connection_hdl,message_chunk const &)>
+        message_chunk_handler;
+
     /// Type of a pointer to a transport timer handle
     typedef typename transport_con_type::timer_ptr timer_ptr;
 
@@ -280,7 +322,8 @@ private:
 public:
 
     explicit connection(bool is_server, std::string const & ua, alog_type& alog,
-        elog_type& elog, rng_type & rng)
+        elog_type& elog, rng_type & rng,
+        con_msg_manager_ptr msg_manager = con_msg_manager_ptr())
       : transport_con_type(is_server,alog,elog)
       , m_handle_read_frame(lib::bind(
             &type::handle_read_frame,
@@ -297,10 +340,21 @@ public:
       , m_open_handshake_timeout_dur(config::timeout_open_handshake)
       , m_close_handshake_timeout_dur(config::timeout_close_handshake)
       , m_pong_timeout_dur(config::timeout_pong)
+      , m_send_high_watermark(config::send_high_watermark)
+      , m_send_low_watermark(config::send_low_watermark)
+      , m_max_buffered_amount(config::send_buffer_limit)
+      , m_max_message_size(config::max_message_size)
       , m_state(session::state::connecting)
       , m_internal_state(session::internal_state::USER_INIT)
-      , m_msg_manager(new con_msg_manager_type())
+      , m_read_block(NULL)
+      , m_msg_manager(msg_manager ? msg_manager :
+            con_msg_manager_ptr(new con_msg_manager_type()))
+      , m_expired_messages(0)
       , m_send_buffer_size(0)
+      , m_above_high_watermark(false)
+      , m_send_stream_active(false)
+      , m_send_stream_op(frame::opcode::binary)
+      , m_send_stream_started(false)
       , m_write_flag(false)
       , m_is_server(is_server)
       , m_alog(alog)
@@ -313,6 +367,10 @@ public:
         m_alog.write(log::alevel::devel,"connection constructor");
     }
 
+    ~connection() {
+        this->release_read_buffer();
+    }
+
     /// Get a shared pointer to this component
     ptr get_shared() {
         return lib::static_pointer_cast<type>(transport_con_type::get_shared());
@@ -455,6 +513,75 @@ public:
         m_message_handler = h;
     }
 
+    /// Set zero copy message handler
+    /**
+     * Opts this connection into zero copy message delivery. When set, the
+     * message view handler is called for every data message in place of the
+     * regular message handler.
+     *
+     * Unfragmented, uncompressed messages that arrive whole in a single read
+     * are unmasked in place and the view points directly into the connection's
+     * read buffer; no message object is allocated and the payload is not
+     * copied. Other messages are assembled as usual and the view points into
+     * the assembled message.
+     *
+     * In both cases the view is only valid for the duration of the handler
+     * call. Handlers that need the payload afterwards must copy it.
+     *
+     * Must be set before the WebSocket handshake completes.
+     *
+     * @param h The new message_view_handler
+     */
+    void set_message_view_handler(message_view_handler h) {
+        m_message_view_handler = h;
+    }
+
+    /// Set streaming message handler
+    /**
+     * Opts this connection into streaming message delivery. When set, data
+     * messages are never assembled in memory. The chunk handler is called in
+     * place of the message and message view handlers with the payload bytes
+     * decoded from each read as they arrive, so memory use stays constant
+     * regardless of message size.
+     *
+     * Each chunk carries the opcode of its message, the message sequence
+     * number, the chunk's offset in the message and whether it is the last
+     * one. Every message ends with a chunk with fin set, which may be empty.
+     * Text chunks are validated incrementally and may split a UTF8 sequence.
+     * Control messages are handled as usual.
+     *
+     * The chunk payload is only valid for the duration of the handler call.
+     * Only the RFC6455 processor supports streaming; connections using older
+     * protocol versions continue to deliver whole messages.
+     *
+     * Must be set before the WebSocket handshake completes.
+     *
+     * @param h The new message_chunk_handler
+     */
+    void set_message_chunk_handler(message_chunk_handler h) {
+        m_message_chunk_handler = h;
+    }
+
+    /// Set high watermark handler
+    /**
+     * See set_send_watermarks for details.
+     *
+     * @param h The new high_watermark_handler
+     */
+    void set_high_watermark_handler(high_watermark_handler h) {
+        m_high_watermark_handler = h;
+    }
+
+    /// Set low watermark handler
+    /**
+     * See set_send_watermarks for details.
+     *
+     * @param h The new low_watermark_handler
+     */
+    void set_low_watermark_handler(low_watermark_handler h) {
+        m_low_watermark_handler = h;
+    }
+
     /////////////////////////
     // Connection timeouts //
     /////////////////////////
@@ -528,6 +655,78 @@ public:
         m_pong_timeout_dur = dur;
     }
 
+    //////////////////////////
+    // Outgoing backpressure //
+    //////////////////////////
+
+    /// Set the buffered amount watermarks
+    /**
+     * When the number of outgoing payload bytes that have not yet been
+     * dispatched to the transport (see get_buffered_amount) rises to `high`
+     * or above, the high watermark handler is called. Once it has been called
+     * the low watermark handler is called the next time the buffered amount
+     * falls to `low` or below. Each handler is called once per crossing, so
+     * the application does not need to poll get_buffered_amount.
+     *
+     * The default values are specified via the compile time config values
+     * `send_high_watermark` and `send_low_watermark`. A high watermark of 0
+     * disables both handlers.
+     *
+     * @param high The high watermark in bytes
+     * @param low The low watermark in bytes. Should be less than `high`.
+     */
+    void set_send_watermarks(size_t high, size_t low) {
+        m_send_high_watermark = high;
+        m_send_low_watermark = low;
+    }
+
+    /// Set the maximum buffered amount
+    /**
+     * Sends that would raise the number of buffered outgoing payload bytes
+     * above this limit are rejected with error::send_queue_full. Control
+     * frames are not subject to the limit. The check is made before the
+     * message is queued, so when several threads send on the same connection
+     * at once the limit may be exceeded by the messages in flight.
+     *
+     * The default value is specified via the compile time config value
+     * `send_buffer_limit`. A value of 0 disables the limit.
+     *
+     * @param limit The maximum buffered amount in bytes
+     */
+    void set_max_buffered_amount(size_t limit) {
+        m_max_buffered_amount = limit;
+    }
+
+    /// Get maximum message size
+    /**
+     * @return The maximum incoming message size in bytes, 0 if unlimited
+     */
+    size_t get_max_message_size() const {
+        return m_max_message_size;
+    }
+
+    /// Set maximum message size
+    /**
+     * Incoming messages larger than this are rejected and the connection is
+     * closed with close code 1009 (message too big). The announced length of
+     * each frame is checked as soon as its header is read, before any payload
+     * is buffered, and the assembled message is checked as fragments and
+     * decompressed bytes accumulate. Messages received through a
+     * message_chunk_handler are never assembled and are not limited.
+     *
+     * The default value is specified via the compile time config value
+     * `max_message_size`, or the endpoint's set_max_message_size. A value of
+     * 0 disables the limit.
+     *
+     * @param new_value The maximum message size in bytes
+     */
+    void set_max_message_size(size_t new_value) {
+        m_max_message_size = new_value;
+        if (m_processor) {
+            m_processor->set_max_message_size(new_value);
+        }
+    }
+
     //////////////////////////////////
     // Uncategorized public methods //
     //////////////////////////////////
@@ -539,8 +738,6 @@ public:
      * that are presently cancelable without uncleanly ending the websocket
      * connection
      *
-     * This method invokes the m_write_lock mutex
-     *
      * @return The current number of bytes in the outgoing send buffer.
      */
     size_t get_buffered_amount() const;
@@ -550,6 +747,44 @@ public:
         return get_buffered_amount();
     }
 
+    /// Get the number of messages waiting in one lane of the send queue
+    /**
+     * Control frames, each data message priority and close frames are queued
+     * in separate lanes that are written in that order. Messages sent through
+     * the lock-free send queue are counted once the writer has moved them into
+     * the lanes.
+     *
+     * This method locks the m_write_lock mutex
+     *
+     * @param lane The lane to report on
+     * @return The number of messages queued in that lane.
+     */
+    size_t get_send_queue_depth(message_buffer::lane::value lane) const;
+
+    /// Get the number of queued messages dropped because they expired
+    /**
+     * Counts messages whose deadline (see message::set_deadline) passed
+     * before they reached the front of the send queue.
+     *
+     * This method locks the m_write_lock mutex
+     *
+     * @return The number of expired messages discarded by this connection.
+     */
+    size_t get_expired_message_count() const;
+
+    /// Get the size of the read buffer this connection currently holds
+    /**
+     * With lazy read buffers enabled this is connection_read_probe_size while
+     * the connection is idle and connection_read_buffer_size while a buffer is
+     * borrowed from read_buffer_pool. Otherwise it is always
+     * connection_read_buffer_size.
+     *
+     * @return The size in bytes of the buffer the next read will use.
+     */
+    size_t get_read_buffer_size() const {
+        return m_read_block ? config::connection_read_buffer_size : sizeof(m_buf);
+    }
+
     ////////////////////
     // Action Methods //
     ////////////////////
@@ -595,12 +830,118 @@ public:
      * Errors are returned via an exception
      * \todo make exception system_error rather than error_code
      *
-     * This method invokes the m_write_lock mutex
+     * This method invokes the m_write_lock mutex. If
+     * config::enable_lockfree_send_queue is set it instead frames the message
+     * without holding any lock and adds it to a lock-free queue that the
+     * writer drains. Only messages whose framing changes processor state,
+     * such as compressed messages, are framed under a lock.
      *
      * @param msg A message_ptr to the message to send.
      */
     lib::error_code send(message_ptr msg);
 
+    /// Start sending a message as a stream of frames
+    /**
+     * Opens a streamed message whose payload is supplied incrementally with
+     * send_stream_append and finished with send_stream_end. Each append is
+     * framed and queued right away, the first as a text or binary frame and
+     * the rest as continuation frames, so the whole payload never needs to
+     * be held in memory.
+     *
+     * Control frames (ping, pong, close) may be sent while the stream is
+     * open. Other data messages may not; send returns
+     * error::send_stream_active until send_stream_end succeeds. Streamed
+     * frames are never compressed.
+     *
+     * Only one thread may drive a stream, and begin must not race with other
+     * calls to send. Requires an RFC6455 (or draft 7/8) connection.
+     *
+     * @param op The opcode of the message, frame::opcode::text or
+     * frame::opcode::binary
+     * @return A status code, zero on success
+     */
+    lib::error_code send_stream_begin(frame::opcode::value op =
+        frame::opcode::binary);
+
+    /// Send the next part of a streamed message
+    /**
+     * Queues payload as the next frame of the message opened with
+     * send_stream_begin. Text streams are validated incrementally, a UTF8
+     * sequence may be split between appends.
+     *
+     * Appends are subject to the same buffered amount limit as send. If the
+     * limit would be exceeded error::send_queue_full is returned and nothing
+     * is queued; the append may be retried once the low watermark handler
+     * has been called.
+     *
+     * @param payload The bytes to append
+     * @return A status code, zero on success
+     */
+    lib::error_code send_stream_append(std::string const & payload);
+
+    /// Send the next part of a streamed message (raw array overload)
+    /**
+     * @see send_stream_append(std::string const &)
+     *
+     * @param payload A pointer to the bytes to append
+     * @param len Number of bytes to append
+     * @return A status code, zero on success
+     */
+    lib::error_code send_stream_append(void const * payload, size_t len);
+
+    /// Finish a streamed message
+    /**
+     * Queues an empty final frame and closes the stream so whole messages
+     * may be sent again. Text streams that end in the middle of a UTF8
+     * sequence fail with error::invalid_utf8 and remain open, they may be
+     * completed with further appends or abandoned with send_stream_abort.
+     *
+     * @return A status code, zero on success
+     */
+    lib::error_code send_stream_end();
+
+    /// Abandon a streamed message
+    /**
+     * Closes the stream so that it no longer blocks send. If no part of the
+     * message has been queued yet nothing is sent. Otherwise the peer holds a
+     * partial message that can never be completed, so the connection is
+     * closed, with close::status::invalid_payload if a text stream ends in the
+     * middle of a UTF8 sequence and close::status::internal_endpoint_error
+     * otherwise.
+     *
+     * @return A status code, zero on success
+     */
+    lib::error_code send_stream_abort();
+
+    /// Get the key used to share prepared frames with other connections
+    /**
+     * Connections that return the same non-negative key for a message would
+     * put identical bytes on the wire for it. A frame prepared by one of them
+     * with prepare_data_frame may be passed to send on all of them. A negative
+     * key means the message must be prepared by this connection alone.
+     *
+     * @param msg The unprepared message that would be sent
+     *
+     * @return The shared framing key, or -1 if frames can't be shared
+     */
+    int get_shared_frame_key(message_ptr msg);
+
+    /// Prepare a data message using this connection's processor
+    /**
+     * Validates and frames in, storing the wire format in out, without adding
+     * anything to the send queue. Used to prepare a frame once for sharing
+     * between the connections that report the same shared frame key.
+     *
+     * This method locks the m_write_lock mutex
+     *
+     * @param in The unprepared message
+     *
+     * @param out The message buffer to store the prepared frame in
+     *
+     * @return Status code, zero on success, non-zero on failure
+     */
+    lib::error_code prepare_data_frame(message_ptr in, message_ptr out);
+
     /// Asyncronously invoke handler::on_inturrupt
     /**
      * Signals to the connection to asyncronously invoke the on_inturrupt
@@ -645,6 +986,10 @@ public:
      *
      * There is no feedback from a pong once sent.
      *
+     * The pong is framed into a message owned by the connection that is reused
+     * for every pong once the previous one has been written, so answering
+     * pings doesn't allocate.
+     *
      * Pong locks the m_write_lock mutex
      *
      * @param payload Payload to be used for the pong
@@ -754,7 +1099,9 @@ public:
     /// Gets all of the subprotocols requested by the client
     /**
      * Retrieves the subprotocols that were requested during the handshake. This
-     * method is valid in the validate handler and later.
+     * method is valid in the validate handler and later. If
+     * config::release_handshake_state is set the list is empty after the open
+     * handler returns.
      *
      * @return A vector of the requested subprotocol
      */
@@ -822,7 +1169,9 @@ public:
 
     /// Retrieve a request header
     /**
-     * Retrieve the value of a header from the handshake HTTP request.
+     * Retrieve the value of a header from the handshake HTTP request. If
+     * config::release_handshake_state is set headers are only available until
+     * the open handler returns.
      *
      * @param key Name of the header to get
      * @return The value of the header
@@ -937,6 +1286,9 @@ public:
      * configured HTTP policy. Such behavior may not work with alternate HTTP
      * policies.
      *
+     * If config::release_handshake_state is set the request is cleared after
+     * the open handler returns.
+     *
      * @since 0.3.0-alpha3
      *
      * @return A const reference to the raw request object
@@ -955,6 +1307,9 @@ public:
      * configured HTTP policy. Such behavior may not work with alternate HTTP
      * policies.
      *
+     * If config::release_handshake_state is set the response is cleared after
+     * the open handler returns.
+     *
      * @return A const reference to the raw response object
      */
     response_type const & get_response() const {
@@ -1129,6 +1484,20 @@ public:
      */
     void write_frame();
 
+    /// Frame a pong and push it onto the send queue
+    /**
+     * Reuses m_pong_msg when no queued or in progress write holds it,
+     * otherwise a new message is allocated and becomes the reusable one.
+     *
+     * This method locks the m_write_lock mutex
+     *
+     * @param payload Payload to be used for the pong
+     * @param needs_writing Set to whether a write must be started
+     * @return A status code, zero on success, non-zero otherwise
+     */
+    lib::error_code queue_pong(std::string const & payload,
+        bool & needs_writing);
+
     /// Process the results of a frame write operation and start the next write
     /**
      * \todo unit tests
@@ -1277,6 +1646,94 @@ private:
      */
     message_ptr write_pop();
 
+    /// Frame a message and add it to the lock-free send queue
+    /**
+     * Used by send when config::enable_lockfree_send_queue is set.
+     *
+     * @param msg The message to send
+     * @return A status code
+     */
+    lib::error_code send_lockfree(message_ptr msg);
+
+    /// Frame and queue a data frame
+    /**
+     * Implements send without the check for an open stream so it can also
+     * queue the frames of streamed messages.
+     *
+     * @param msg The message to send
+     * @return A status code
+     */
+    lib::error_code send_frame(message_ptr msg);
+
+    /// Move messages from the lock-free send queue to the write queue
+    /**
+     * Must be called while holding m_write_lock
+     */
+    void drain_send_queue();
+
+    /// Calls the high watermark handler if the buffered amount has risen to
+    /// the high watermark
+    /**
+     * Must not be called while holding m_write_lock.
+     */
+    void check_high_watermark();
+
+    /// Calls the low watermark handler if the buffered amount has fallen to
+    /// the low watermark since the high watermark handler was called.
+    /**
+     * Must not be called while holding m_write_lock.
+     */
+    void check_low_watermark();
+
+    /// Free the handshake request, response and buffers
+    /**
+     * Called once the connection is open when config::release_handshake_state
+     * is set.
+     */
+    void clear_handshake_state();
+
+    /// Get the buffer the next read will be made into
+    char * get_read_buffer() {
+        return m_read_block ? m_read_block : m_buf;
+    }
+
+    /// Borrow a full size read buffer from the per-thread pool
+    /**
+     * Does nothing if lazy read buffers are disabled or a buffer is already
+     * borrowed. The contents of the embedded buffer are not copied.
+     */
+    void acquire_read_buffer();
+
+    /// Return the borrowed read buffer to the per-thread pool
+    /**
+     * Must only be called while no read into the borrowed buffer is in
+     * progress and none of its contents are still needed.
+     */
+    void release_read_buffer();
+
+    /// Discard expired messages from the front of the send queue
+    /**
+     * Only whole data messages are dropped, fragments and control frames are
+     * always written. Must be called while holding m_write_lock.
+     */
+    void drop_expired_messages();
+
+    /// Appends messages drained from the lock-free send queue
+    struct send_queue_appender {
+        send_queue_appender(message_buffer::send_queue<message_ptr> & q,
+            lib::atomic<size_t> & s) : queue(q), buffer_size(s) {}
+
+        void operator()(message_ptr const & msg) {
+            message_ptr replaced = queue.push(msg);
+            if (replaced) {
+                buffer_size -= replaced->get_payload().size();
+            }
+        }
+
+        message_buffer::send_queue<message_ptr> & queue;
+        lib::atomic<size_t> & buffer_size;
+    };
+
     /// Prints information about the incoming connection to the access log
     /**
      * Prints information about the incoming connection to the access log.
@@ -1318,11 +1775,19 @@ private:
     http_handler            m_http_handler;
     validate_handler        m_validate_handler;
     message_handler         m_message_handler;
+    message_view_handler    m_message_view_handler;
+    message_chunk_handler   m_message_chunk_handler;
+    high_watermark_handler  m_high_watermark_handler;
+    low_watermark_handler   m_low_watermark_handler;
 
     /// constant values
     long                    m_open_handshake_timeout_dur;
     long                    m_close_handshake_timeout_dur;
     long                    m_pong_timeout_dur;
+    size_t                  m_send_high_watermark;
+    size_t                  m_send_low_watermark;
+    size_t                  m_max_buffered_amount;
+    size_t                  m_max_message_size;
 
     /// External connection state
     /**
@@ -1343,16 +1808,39 @@ private:
      * Serializes access to the write queue as well as shared state within the
      * processor.
      */
-    mutex_type              m_write_lock;
+    mutable mutex_type      m_write_lock;
+
+    /// The lock used to protect processor state when framing lock-free sends
+    /**
+     * Only used when config::enable_lockfree_send_queue is set. Held while
+     * framing messages that change processor state and pushing them to the
+     * lock-free send queue so they are queued in the order they were framed.
+     */
+    mutex_type              m_frame_lock;
 
     // connection resources
-    char                    m_buf[config::connection_read_buffer_size];
+    /// Embedded read buffer
+    /**
+     * Reduced to connection_read_probe_size bytes when lazy read buffers are
+     * enabled, m_read_block is used for all other reads.
+     */
+    char                    m_buf[config::enable_lazy_read_buffer ?
+                                config::connection_read_probe_size :
+                                config::connection_read_buffer_size];
+    /// Read buffer borrowed from read_buffer_pool, or NULL
+    char *                  m_read_block;
     size_t                  m_buf_cursor;
     termination_handler     m_termination_handler;
     con_msg_manager_ptr     m_msg_manager;
     timer_ptr               m_handshake_timer;
     timer_ptr               m_ping_timer;
 
+    /// Reusable pong frame
+    /**
+     * Lock: m_write_lock
+     */
+    message_ptr             m_pong_msg;
+
     /// @todo this is not memory efficient. this value is not used after the
     /// handshake.
     std::string m_handshake_buffer;
@@ -1364,21 +1852,46 @@ private:
      * the state necessary to encode and decode the incoming and outgoing
      * WebSocket byte streams
      *
-     * Use of the prepare_data_frame method requires lock: m_write_lock
+     * Use of the prepare_data_frame method requires lock: m_write_lock, or
+     * m_frame_lock if config::enable_lockfree_send_queue is set and the
+     * processor reports that framing the message is stateful.
      */
     processor_ptr           m_processor;
 
-    /// Queue of unsent outgoing messages
+    /// Queue of unsent outgoing messages, one lane per priority
     /**
      * Lock: m_write_lock
      */
-    std::queue<message_ptr> m_send_queue;
+    message_buffer::send_queue<message_ptr> m_send_queue;
+
+    /// Outgoing messages not yet moved to m_send_queue
+    /**
+     * Only used when config::enable_lockfree_send_queue is set. Any thread
+     * may push. Drained into m_send_queue while holding m_write_lock.
+     */
+    concurrency::mpsc_queue<message_ptr> m_send_lockfree;
 
-    /// Size in bytes of the outstanding payloads in the write queue
+    /// Number of messages dropped by drop_expired_messages
     /**
      * Lock: m_write_lock
      */
-    size_t m_send_buffer_size;
+    size_t m_expired_messages;
+
+    /// Size in bytes of the outstanding payloads in both send queues
+    lib::atomic<size_t> m_send_buffer_size;
+
+    /// True after the high watermark handler was called until the buffered
+    /// amount falls to the low watermark
+    lib::atomic<bool> m_above_high_watermark;
+
+    /// True between send_stream_begin and a successful send_stream_end
+    lib::atomic<bool> m_send_stream_active;
+    /// Opcode of the streamed message
+    frame::opcode::value m_send_stream_op;
+    /// Whether the first frame of the streamed message has been queued
+    bool m_send_stream_started;
+    /// UTF8 state of a streamed text message
+    utf8_validator::validator m_send_stream_validator;
 
     /// buffer holding the various parts of the current message being writen
     /**
@@ -1386,9 +1899,12 @@ private:
      */
     std::vector<transport::buffer> m_send_buffer;
 
-    /// a pointer to hold on to the current message being written to keep it
+    /// pointers to hold on to the current messages being written to keep them
     /// from going out of scope before the write is complete.
-    message_ptr m_current_msg;
+    /**
+     * Only the last message in a batch may be terminal.
+     */
+    std::vector<message_ptr> m_current_msgs;
 
     /// True if there is currently an outstanding transport write
     /**
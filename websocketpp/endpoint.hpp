@@ -30,10 +30,13 @@
 
 #include <websocketpp/connection.hpp>
 #include <websocketpp/logger/levels.hpp>
+#include <websocketpp/message_buffer/block_pool.hpp>
 #include <websocketpp/version.hpp>
 
 #include <iostream>
 #include <set>
+#include <utility>
+#include <vector>
 
 namespace websocketpp {
 
@@ -66,6 +69,11 @@ public:
 
     /// Type of message_handler
     typedef typename connection_type::message_handler message_handler;
+    /// Type of message_view_handler
+    typedef typename connection_type::message_view_handler message_view_handler;
+    /// Type of message_chunk_handler
+    typedef typename connection_type::message_chunk_handler
+        message_chunk_handler;
     /// Type of message pointers that this endpoint uses
     typedef typename connection_type::message_ptr message_ptr;
 
@@ -82,11 +90,27 @@ public:
     /// Type of RNG
     typedef typename config::rng_type rng_type;
 
+    /// Type of the message manager that supplies connection message managers
+    typedef typename config::endpoint_msg_manager_type endpoint_msg_manager_type;
+
     // TODO: organize these
     typedef typename connection_type::termination_handler termination_handler;
 
     typedef lib::shared_ptr<connection_weak_ptr> hdl_type;
 
+    /// Type of the per-thread pool connection storage is recycled through
+    /**
+     * A block holds a connection and its shared_ptr control block. The 64
+     * bytes of headroom cover the control blocks of the common standard
+     * library and Boost implementations.
+     */
+    typedef message_buffer::block_pool<sizeof(connection_type) + 64,
+        config::connection_pool_size> connection_pool;
+
+    /// Allocator that places connections in connection_pool blocks
+    typedef message_buffer::block_pool_allocator<connection_type,
+        connection_pool> connection_allocator;
+
     explicit endpoint(bool is_server)
       : m_alog(config::alog_level, &std::cout)
       , m_elog(config::elog_level, &std::cerr)
@@ -94,6 +118,7 @@ public:
       , m_open_handshake_timeout_dur(config::timeout_open_handshake)
       , m_close_handshake_timeout_dur(config::timeout_close_handshake)
       , m_pong_timeout_dur(config::timeout_pong)
+      , m_max_message_size(config::max_message_size)
       , m_is_server(is_server)
     {
         m_alog.set_channels(config::alog_level);
@@ -217,6 +242,18 @@ public:
         return m_elog;
     }
 
+    /// Get reference to the endpoint message manager
+    /**
+     * The endpoint message manager supplies each new connection with its
+     * connection message manager. Pooling managers expose their statistics
+     * through this object.
+     *
+     * @return A reference to the endpoint message manager
+     */
+    endpoint_msg_manager_type & get_msg_manager() {
+        return m_msg_manager;
+    }
+
     /*************************/
     /* Set Handler functions */
     /*************************/
@@ -271,6 +308,26 @@ public:
         scoped_lock_type guard(m_mutex);
         m_message_handler = h;
     }
+    void set_message_view_handler(message_view_handler h) {
+        m_alog.write(log::alevel::devel,"set_message_view_handler");
+        scoped_lock_type guard(m_mutex);
+        m_message_view_handler = h;
+    }
+    void set_message_chunk_handler(message_chunk_handler h) {
+        m_alog.write(log::alevel::devel,"set_message_chunk_handler");
+        scoped_lock_type guard(m_mutex);
+        m_message_chunk_handler = h;
+    }
+    void set_high_watermark_handler(high_watermark_handler h) {
+        m_alog.write(log::alevel::devel,"set_high_watermark_handler");
+        scoped_lock_type guard(m_mutex);
+        m_high_watermark_handler = h;
+    }
+    void set_low_watermark_handler(low_watermark_handler h) {
+        m_alog.write(log::alevel::devel,"set_low_watermark_handler");
+        scoped_lock_type guard(m_mutex);
+        m_low_watermark_handler = h;
+    }
 
     /////////////////////////
     // Connection timeouts //
@@ -348,6 +405,60 @@ public:
         m_pong_timeout_dur = dur;
     }
 
+    /// Get default maximum message size
+    /**
+     * @return The default maximum incoming message size in bytes
+     */
+    size_t get_max_message_size() const {
+        return m_max_message_size;
+    }
+
+    /// Set default maximum message size
+    /**
+     * Set the default maximum incoming message size for connections created
+     * by this endpoint. Connections may override it with
+     * connection::set_max_message_size. Messages that exceed it are rejected
+     * with close code 1009 (message too big).
+     *
+     * The default is set by the `max_message_size` config value. A value of
+     * 0 disables the limit.
+     *
+     * @param new_value The maximum message size in bytes
+     */
+    void set_max_message_size(size_t new_value) {
+        m_max_message_size = new_value;
+    }
+
+    /// Cache storage for new connections on the calling thread
+    /**
+     * Allocates storage for up to n connections, limited by the
+     * `connection_pool_size` config value, so that connections created on
+     * the calling thread don't need to allocate. Call from each thread that
+     * accepts or opens connections, typically before starting to accept.
+     *
+     * Does nothing unless the `enable_connection_pool` config value is set.
+     *
+     * @param n The number of connections to cache storage for
+     */
+    void prewarm_connections(size_t n) {
+        if (config::enable_connection_pool) {
+            connection_pool::reserve(n);
+        }
+    }
+
+    /// Get connection pool counters for the calling thread
+    /**
+     * Hits count connections created in recycled storage and misses those
+     * that needed a new allocation. The pool, and so the counters, are shared
+     * by all endpoints on the thread whose connections have the same size and
+     * `connection_pool_size`.
+     *
+     * @return The connection pool counters of the calling thread
+     */
+    typename connection_pool::stats get_connection_pool_stats() const {
+        return connection_pool::get_stats();
+    }
+
     /*************************************/
     /* Connection pass through functions */
     /*************************************/
@@ -394,6 +505,54 @@ public:
     void send(connection_hdl hdl, message_ptr msg, lib::error_code & ec);
     void send(connection_hdl hdl, message_ptr msg);
 
+    /// Send one message to a group of connections (exception free)
+    /**
+     * The message is validated and framed once for each distinct framing
+     * configuration among the target connections, rather than once per
+     * connection. All connections with the same configuration share the same
+     * immutable header and payload buffers in their send queues. Connections
+     * whose frames can't be shared (client connections, which mask every
+     * frame, or connections compressing the message with their own deflate
+     * context) prepare their own copy as send would.
+     *
+     * Handles that no longer refer to a connection and connections that are
+     * not open are skipped. They do not cause an error.
+     *
+     * @param [in] begin Iterator to the first connection_hdl to send to
+     * @param [in] end Iterator past the last connection_hdl to send to
+     * @param [in] msg The message to send
+     * @param [out] ec Set if the message could not be prepared
+     * @return The number of connections the message was queued on
+     */
+    template <typename iterator_type>
+    size_t broadcast(iterator_type begin, iterator_type end, message_ptr msg,
+        lib::error_code & ec);
+    /// Send one message to a group of connections
+    /**
+     * @see broadcast(iterator_type,iterator_type,message_ptr,lib::error_code&)
+     */
+    template <typename iterator_type>
+    size_t broadcast(iterator_type begin, iterator_type end, message_ptr msg);
+
+    /// Create a message and send it to a group of connections (exception free)
+    /**
+     * Convenience method to broadcast a message given a payload string and an
+     * opcode.
+     *
+     * @see broadcast(iterator_type,iterator_type,message_ptr,lib::error_code&)
+     */
+    template <typename iterator_type>
+    size_t broadcast(iterator_type begin, iterator_type end,
+        std::string const & payload, frame::opcode::value op,
+        lib::error_code & ec);
+    /// Create a message and send it to a group of connections
+    /**
+     * @see broadcast(iterator_type,iterator_type,message_ptr,lib::error_code&)
+     */
+    template <typename iterator_type>
+    size_t broadcast(iterator_type begin, iterator_type end,
+        std::string const & payload, frame::opcode::value op);
+
     void close(connection_hdl hdl, close::status::value const code,
         std::string const & reason, lib::error_code & ec);
     void close(connection_hdl hdl, close::status::value const code,
@@ -493,13 +652,20 @@ private:
     http_handler                m_http_handler;
     validate_handler            m_validate_handler;
     message_handler             m_message_handler;
+    message_view_handler        m_message_view_handler;
+    message_chunk_handler       m_message_chunk_handler;
+    high_watermark_handler      m_high_watermark_handler;
+    low_watermark_handler       m_low_watermark_handler;
 
     long                        m_open_handshake_timeout_dur;
     long                        m_close_handshake_timeout_dur;
     long                        m_pong_timeout_dur;
+    size_t                      m_max_message_size;
 
     rng_type m_rng;
 
+    endpoint_msg_manager_type   m_msg_manager;
+
     // static settings
     bool const                  m_is_server;
 
@@ -44,7 +44,7 @@ enum value {
     /// Catch-all library error
     general = 1,
 
-    /// send attempted when endpoint write queue was full
+    /// send attempted when the connection's send buffer limit was reached
     send_queue_full,
 
     /// Attempted an operation using a payload that was improperly formatted
@@ -114,7 +114,10 @@ enum value {
     close_handshake_timeout,
 
     /// Invalid port in URI
-    invalid_port
+    invalid_port,
+
+    /// A whole message was sent while a streamed message was in progress
+    send_stream_active
 }; // enum value
 
 
@@ -176,6 +179,8 @@ public:
                 return "The closing handshake timed out";
             case error::invalid_port:
                 return "Invalid URI port";
+            case error::send_stream_active:
+                return "A streamed message is in progress";
             default:
                 return "Unknown";
         }
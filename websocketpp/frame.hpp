@@ -32,6 +32,7 @@
 
 #include <websocketpp/common/system_error.hpp>
 #include <websocketpp/common/network.hpp>
+#include <websocketpp/common/cpu.hpp>
 
 #include <websocketpp/utilities.hpp>
 
@@ -703,6 +704,111 @@ void byte_mask(iter_type b, iter_type e, masking_key_type const & key,
     byte_mask(b,e,b,key,key_offset);
 }
 
+/// Word masking kernels
+/**
+ * Each kernel masks `length` bytes of input into output using a prepared key
+ * and returns the prepared key circularly shifted to account for the bytes
+ * consumed. Vector kernels process 16 or 32 bytes per step, both multiples of
+ * the key length, so the key phase only changes in the scalar tail. All
+ * kernels produce byte for byte identical output.
+ *
+ * word_mask_circ and word_mask_exact select the best kernel supported by the
+ * running CPU. The individual kernels are exposed for testing and
+ * benchmarking.
+ */
+namespace simd {
+
+/// Signature shared by all masking kernels
+typedef size_t (*mask_kernel)(uint8_t *, uint8_t *, size_t, size_t);
+
+/// Portable word by word masking kernel
+inline size_t mask_portable(uint8_t * input, uint8_t * output, size_t length,
+    size_t prepared_key)
+{
+    size_t n = length / sizeof(size_t); // whole words
+    size_t l = length - (n * sizeof(size_t)); // remaining bytes
+    size_t * input_word = reinterpret_cast<size_t *>(input);
+    size_t * output_word = reinterpret_cast<size_t *>(output);
+
+    // mask word by word
+    for (size_t i = 0; i < n; i++) {
+        output_word[i] = input_word[i] ^ prepared_key;
+    }
+
+    // mask partial word at the end
+    size_t start = length - l;
+    uint8_t * byte_key = reinterpret_cast<uint8_t *>(&prepared_key);
+    for (size_t i = 0; i < l; ++i) {
+        output[start+i] = input[start+i] ^ byte_key[i];
+    }
+
+    return circshift_prepared_key(prepared_key,l);
+}
+
+#ifdef WEBSOCKETPP_X86_SIMD
+/// SSE2 masking kernel, 16 bytes per step
+WEBSOCKETPP_TARGET_SSE2
+inline size_t mask_sse2(uint8_t * input, uint8_t * output, size_t length,
+    size_t prepared_key)
+{
+    // x86 is little endian so the low 32 bits hold the next four key bytes
+    __m128i const k = _mm_set1_epi32(static_cast<int>(
+        static_cast<uint32_t>(prepared_key)));
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(input+i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output+i),
+            _mm_xor_si128(v,k));
+    }
+
+    return mask_portable(input+i,output+i,length-i,prepared_key);
+}
+
+/// AVX2 masking kernel, 32 bytes per step
+WEBSOCKETPP_TARGET_AVX2
+inline size_t mask_avx2(uint8_t * input, uint8_t * output, size_t length,
+    size_t prepared_key)
+{
+    __m256i const k = _mm256_set1_epi32(static_cast<int>(
+        static_cast<uint32_t>(prepared_key)));
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256(
+            reinterpret_cast<__m256i const *>(input+i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(output+i),
+            _mm256_xor_si256(v,k));
+    }
+
+    return mask_portable(input+i,output+i,length-i,prepared_key);
+}
+#endif // WEBSOCKETPP_X86_SIMD
+
+/// Pick the fastest kernel supported by the running CPU
+inline mask_kernel select_mask_kernel() {
+#ifdef WEBSOCKETPP_X86_SIMD
+    lib::cpu::features const & f = lib::cpu::get_features();
+    if (f.avx2) {
+        return &mask_avx2;
+    } else if (f.sse2) {
+        return &mask_sse2;
+    }
+#endif
+    return &mask_portable;
+}
+
+/// Returns the kernel used by word_mask_circ, selected once per process
+inline mask_kernel get_mask_kernel() {
+    static mask_kernel const kernel = select_mask_kernel();
+    return kernel;
+}
+
+/// Inputs shorter than this skip the dispatch and use mask_portable
+static size_t const min_vector_length = 16;
+
+} // namespace simd
+
 /// Exact word aligned mask/unmask
 /**
  * Balanced combination of byte by byte and circular word by word masking.
@@ -728,16 +834,11 @@ inline void word_mask_exact(uint8_t* input, uint8_t* output, size_t length,
     const masking_key_type& key)
 {
     size_t prepared_key = prepare_masking_key(key);
-    size_t n = length/sizeof(size_t);
-    size_t* input_word = reinterpret_cast<size_t*>(input);
-    size_t* output_word = reinterpret_cast<size_t*>(output);
-
-    for (size_t i = 0; i < n; i++) {
-        output_word[i] = input_word[i] ^ prepared_key;
-    }
 
-    for (size_t i = n*sizeof(size_t); i < length; i++) {
-        output[i] = input[i] ^ key.c[i%4];
+    if (length < simd::min_vector_length) {
+        simd::mask_portable(input,output,length,prepared_key);
+    } else {
+        simd::get_mask_kernel()(input,output,length,prepared_key);
     }
 }
 
@@ -777,6 +878,9 @@ inline void word_mask_exact(uint8_t* data, size_t length, const
  * length value. The returned value may be fed back into word_mask when more
  * data is available.
  *
+ * Inputs of at least simd::min_vector_length bytes are masked with the best
+ * vector kernel the running CPU supports.
+ *
  * input and output must both have length at least:
  *    ceil(length/sizeof(size_t))*sizeof(size_t)
  * Exactly that many bytes will be written, although only exactly length bytes
@@ -793,24 +897,10 @@ inline void word_mask_exact(uint8_t* data, size_t length, const
 inline size_t word_mask_circ(uint8_t * input, uint8_t * output, size_t length,
     size_t prepared_key)
 {
-    size_t n = length / sizeof(size_t); // whole words
-    size_t l = length - (n * sizeof(size_t)); // remaining bytes
-    size_t * input_word = reinterpret_cast<size_t *>(input);
-    size_t * output_word = reinterpret_cast<size_t *>(output);
-
-    // mask word by word
-    for (size_t i = 0; i < n; i++) {
-        output_word[i] = input_word[i] ^ prepared_key;
+    if (length < simd::min_vector_length) {
+        return simd::mask_portable(input,output,length,prepared_key);
     }
-
-    // mask partial word at the end
-    size_t start = length - l;
-    uint8_t * byte_key = reinterpret_cast<uint8_t *>(&prepared_key);
-    for (size_t i = 0; i < l; ++i) {
-        output[start+i] = input[start+i] ^ byte_key[i];
-    }
-
-    return circshift_prepared_key(prepared_key,l);
+    return simd::get_mask_kernel()(input,output,length,prepared_key);
 }
 
 /// Circular word aligned mask/unmask (in place)
@@ -0,0 +1,528 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef HTTP_PARSER_VIEW_REQUEST_IMPL_HPP
+#define HTTP_PARSER_VIEW_REQUEST_IMPL_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include <websocketpp/http/parser.hpp>
+
+namespace websocketpp {
+namespace http {
+namespace parser {
+
+inline bool view_request::parse_complete(std::istream& s) {
+    std::string line;
+
+    while (std::getline(s, line)) {
+        line += '\n';
+
+        try {
+            consume(line.data(),line.size());
+        } catch (exception const &) {
+            return false;
+        }
+
+        if (m_ready) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+inline size_t view_request::consume(char const * buf, size_t len) {
+    if (m_ready) {return 0;}
+
+    if (m_buf.capacity() < initial_buffer_size) {
+        m_buf.reserve(len > initial_buffer_size ? len : initial_buffer_size);
+    }
+
+    // copy new header bytes into buffer. Lines already processed stay in
+    // place as the header entries refer to them by offset.
+    m_buf.append(buf,len);
+
+    for (;;) {
+        char const * data = m_buf.data();
+        size_t const size = m_buf.size();
+
+        // search the bytes not yet scanned for a line delimiter
+        size_t end = no_entry;
+        size_t cursor = m_scan_begin;
+
+        while (cursor + 1 < size) {
+            char const * lf = static_cast<char const *>(
+                std::memchr(data+cursor+1,'\n',size-cursor-1));
+
+            if (lf == NULL) {
+                break;
+            }
+
+            cursor = static_cast<size_t>(lf-data);
+
+            if (data[cursor-1] == '\r') {
+                end = cursor-1;
+                break;
+            }
+        }
+
+        if (end == no_entry) {
+            // we are out of bytes. A trailing \r may be the first half of a
+            // delimiter so it is scanned again with the next bytes.
+            if (size > max_header_size) {
+                throw exception("Maximum header size exceeded.",
+                                status_code::request_header_fields_too_large);
+            }
+
+            m_scan_begin = std::max(m_line_begin,size > 0 ? size-1 : 0);
+            return len;
+        }
+
+        // the range [m_line_begin,end) now represents a line to be processed.
+        if (end == m_line_begin) {
+            // we got a blank line
+            if (m_method.empty() || get_header("Host") == "") {
+                throw exception("Incomplete Request",status_code::bad_request);
+            }
+
+            size_t const header_end = end + sizeof(header_delimiter) - 1;
+
+            if (header_end > max_header_size) {
+                throw exception("Maximum header size exceeded.",
+                                status_code::request_header_fields_too_large);
+            }
+
+            m_ready = true;
+
+            // drop any bytes past the end of the headers, they belong to the
+            // caller.
+            m_buf.resize(header_end);
+
+            // return number of bytes processed (starting bytes - bytes left)
+            return len - (size - header_end);
+        }
+
+        if (m_method.empty()) {
+            process_request_line(m_line_begin,end);
+        } else {
+            process_header_line(m_line_begin,end);
+        }
+
+        m_line_begin = end + sizeof(header_delimiter) - 1;
+        m_scan_begin = m_line_begin;
+    }
+}
+
+inline std::string view_request::raw() const {
+    size_t size = m_method.size() + m_uri.size() + m_version.size() + 6
+                + m_body.size();
+
+    std::vector<entry>::const_iterator it;
+    for (it = m_headers.begin(); it != m_headers.end(); ++it) {
+        size += name_size(*it) + value_size(*it) + 4;
+    }
+
+    std::string raw;
+    raw.reserve(size);
+
+    raw.append(m_method).append(1,' ').append(m_uri).append(1,' ');
+    raw.append(m_version).append("\r\n");
+
+    for (it = m_headers.begin(); it != m_headers.end(); ++it) {
+        raw.append(name_data(*it),name_size(*it)).append(": ");
+        raw.append(value_data(*it),value_size(*it)).append("\r\n");
+    }
+
+    raw.append("\r\n").append(m_body);
+
+    return raw;
+}
+
+inline void view_request::set_method(std::string const & method) {
+    if (std::find_if(method.begin(),method.end(),is_not_token_char) != method.end()) {
+        throw exception("Invalid method token.",status_code::bad_request);
+    }
+
+    m_method = method;
+}
+
+inline std::string const & view_request::get_header(std::string const & key)
+    const
+{
+    size_t i = find(key.data(),key.size(),hash_name(key.data(),key.size()));
+
+    if (i == no_entry) {
+        return empty_header;
+    } else {
+        return get_value(m_headers[i]);
+    }
+}
+
+inline bool view_request::get_header_as_plist(std::string const & key,
+    parameter_list & out) const
+{
+    std::string const & value = get_header(key);
+
+    if (value.size() == 0) {
+        return false;
+    }
+
+    return this->parse_parameter_list(value,out);
+}
+
+inline void view_request::append_header(std::string const & key,
+    std::string const & val)
+{
+    if (std::find_if(key.begin(),key.end(),is_not_token_char) != key.end()) {
+        throw exception("Invalid header name",status_code::bad_request);
+    }
+
+    uint32_t hash = hash_name(key.data(),key.size());
+    size_t i = find(key.data(),key.size(),hash);
+
+    if (i == no_entry) {
+        add_owned(key,val,hash);
+        return;
+    }
+
+    entry & e = m_headers[i];
+    make_owned(e);
+
+    if (e.value.empty()) {
+        e.value = val;
+    } else {
+        e.value.append(", ").append(val);
+    }
+}
+
+inline void view_request::replace_header(std::string const & key,
+    std::string const & val)
+{
+    uint32_t hash = hash_name(key.data(),key.size());
+    size_t i = find(key.data(),key.size(),hash);
+
+    if (i == no_entry) {
+        add_owned(key,val,hash);
+        return;
+    }
+
+    entry & e = m_headers[i];
+    make_owned(e);
+    e.value = val;
+}
+
+inline void view_request::remove_header(std::string const & key) {
+    size_t i = find(key.data(),key.size(),hash_name(key.data(),key.size()));
+
+    if (i == no_entry) {
+        return;
+    }
+
+    m_headers.erase(m_headers.begin()+static_cast<std::ptrdiff_t>(i));
+    rebuild_known();
+}
+
+inline void view_request::set_body(std::string const & value) {
+    if (value.size() == 0) {
+        remove_header("Content-Length");
+        m_body = "";
+        return;
+    }
+
+    std::stringstream len;
+    len << value.size();
+    replace_header("Content-Length", len.str());
+    m_body = value;
+}
+
+inline bool view_request::parse_parameter_list(std::string const & in,
+    parameter_list & out) const
+{
+    if (in.size() == 0) {
+        return false;
+    }
+
+    std::string::const_iterator it;
+    it = extract_parameters(in.begin(),in.end(),out);
+    return (it == in.begin());
+}
+
+inline uint32_t view_request::hash_name(char const * s, size_t len) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c >= 'A' && c <= 'Z') {
+            c |= 0x20;
+        }
+        hash = (hash ^ c) * 16777619u;
+    }
+
+    return hash;
+}
+
+inline bool view_request::equal_name(char const * a, size_t alen,
+    char const * b, size_t blen)
+{
+    if (alen != blen) {
+        return false;
+    }
+
+    for (size_t i = 0; i < alen; ++i) {
+        unsigned char ca = static_cast<unsigned char>(a[i]);
+        unsigned char cb = static_cast<unsigned char>(b[i]);
+
+        if (ca != cb) {
+            if (ca >= 'A' && ca <= 'Z') {ca |= 0x20;}
+            if (cb >= 'A' && cb <= 'Z') {cb |= 0x20;}
+            if (ca != cb) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+inline char const * view_request::known_name(size_t i) {
+    static char const * const names[num_known_headers] = {
+        "Host",
+        "Upgrade",
+        "Connection",
+        "Origin",
+        "User-Agent",
+        "Sec-WebSocket-Key",
+        "Sec-WebSocket-Version",
+        "Sec-WebSocket-Protocol",
+        "Sec-WebSocket-Extensions",
+        "Sec-WebSocket-Origin",
+        "Sec-WebSocket-Key1",
+        "Sec-WebSocket-Key2",
+        "Sec-WebSocket-Key3"
+    };
+
+    return names[i];
+}
+
+inline uint32_t view_request::known_hash(size_t i) {
+    struct table {
+        table() {
+            for (size_t j = 0; j < num_known_headers; ++j) {
+                char const * name = known_name(j);
+                hashes[j] = hash_name(name,std::strlen(name));
+            }
+        }
+        uint32_t hashes[num_known_headers];
+    };
+
+    static table const t;
+    return t.hashes[i];
+}
+
+inline size_t view_request::find_known(char const * name, size_t len,
+    uint32_t hash)
+{
+    for (size_t i = 0; i < num_known_headers; ++i) {
+        if (known_hash(i) != hash) {
+            continue;
+        }
+
+        char const * known = known_name(i);
+        if (equal_name(name,len,known,std::strlen(known))) {
+            return i;
+        }
+    }
+
+    return num_known_headers;
+}
+
+inline void view_request::process_request_line(size_t begin, size_t end) {
+    char const * data = m_buf.data();
+
+    char const * cursor_start = data+begin;
+    char const * line_end = data+end;
+    char const * cursor_end = std::find(cursor_start,line_end,' ');
+
+    if (cursor_end == line_end) {
+        throw exception("Invalid request line1",status_code::bad_request);
+    }
+
+    if (std::find_if(cursor_start,cursor_end,is_not_token_char) != cursor_end) {
+        throw exception("Invalid method token.",status_code::bad_request);
+    }
+
+    m_method.assign(cursor_start,cursor_end);
+
+    cursor_start = cursor_end+1;
+    cursor_end = std::find(cursor_start,line_end,' ');
+
+    if (cursor_end == line_end) {
+        throw exception("Invalid request line2",status_code::bad_request);
+    }
+
+    m_uri.assign(cursor_start,cursor_end);
+    m_version.assign(cursor_end+1,line_end);
+}
+
+inline void view_request::process_header_line(size_t begin, size_t end) {
+    char const * data = m_buf.data();
+
+    char const * colon = static_cast<char const *>(
+        std::memchr(data+begin,header_separator[0],end-begin));
+
+    if (colon == NULL) {
+        throw exception("Invalid header line",status_code::bad_request);
+    }
+
+    size_t name_begin = begin;
+    size_t name_end = static_cast<size_t>(colon-data);
+    size_t value_begin = name_end+1;
+    size_t value_end = end;
+
+    while (name_begin < name_end && is_whitespace_char(
+        static_cast<unsigned char>(data[name_begin]))) {++name_begin;}
+    while (name_end > name_begin && is_whitespace_char(
+        static_cast<unsigned char>(data[name_end-1]))) {--name_end;}
+    while (value_begin < value_end && is_whitespace_char(
+        static_cast<unsigned char>(data[value_begin]))) {++value_begin;}
+    while (value_end > value_begin && is_whitespace_char(
+        static_cast<unsigned char>(data[value_end-1]))) {--value_end;}
+
+    if (name_begin == name_end || std::find_if(data+name_begin,data+name_end,
+        is_not_token_char) != data+name_end)
+    {
+        throw exception("Invalid header name",status_code::bad_request);
+    }
+
+    size_t name_length = name_end-name_begin;
+    uint32_t hash = hash_name(data+name_begin,name_length);
+    size_t i = find(data+name_begin,name_length,hash);
+
+    if (i != no_entry) {
+        // repeated header, fold into the first occurrence like append_header
+        entry & e = m_headers[i];
+        make_owned(e);
+
+        if (!e.value.empty()) {
+            e.value.append(", ");
+        }
+        e.value.append(data+value_begin,value_end-value_begin);
+        return;
+    }
+
+    entry e;
+    e.name_offset = name_begin;
+    e.name_length = name_length;
+    e.value_offset = value_begin;
+    e.value_length = value_end-value_begin;
+    e.hash = hash;
+    m_headers.push_back(e);
+
+    size_t k = find_known(data+name_begin,name_length,hash);
+    if (k != num_known_headers) {
+        m_known[k] = m_headers.size()-1;
+    }
+}
+
+inline size_t view_request::find(char const * name, size_t len, uint32_t hash)
+    const
+{
+    size_t k = find_known(name,len,hash);
+    if (k != num_known_headers) {
+        return m_known[k];
+    }
+
+    for (size_t i = 0; i < m_headers.size(); ++i) {
+        entry const & e = m_headers[i];
+        if (e.hash == hash && equal_name(name_data(e),name_size(e),name,len)) {
+            return i;
+        }
+    }
+
+    return no_entry;
+}
+
+inline std::string const & view_request::get_value(entry const & e) const {
+    if (!e.owned && !e.cached) {
+        e.value.assign(m_buf.data()+e.value_offset,e.value_length);
+        e.cached = true;
+    }
+
+    return e.value;
+}
+
+inline void view_request::make_owned(entry & e) {
+    if (e.owned) {
+        return;
+    }
+
+    e.name.assign(m_buf.data()+e.name_offset,e.name_length);
+    get_value(e);
+    e.owned = true;
+}
+
+inline void view_request::add_owned(std::string const & key,
+    std::string const & val, uint32_t hash)
+{
+    m_headers.push_back(entry());
+
+    entry & e = m_headers.back();
+    e.owned = true;
+    e.cached = true;
+    e.name = key;
+    e.value = val;
+    e.hash = hash;
+
+    size_t k = find_known(key.data(),key.size(),hash);
+    if (k != num_known_headers) {
+        m_known[k] = m_headers.size()-1;
+    }
+}
+
+inline void view_request::rebuild_known() {
+    clear_known();
+
+    for (size_t i = 0; i < m_headers.size(); ++i) {
+        entry const & e = m_headers[i];
+        size_t k = find_known(name_data(e),name_size(e),e.hash);
+
+        if (k != num_known_headers && m_known[k] == no_entry) {
+            m_known[k] = i;
+        }
+    }
+}
+
+} // namespace parser
+} // namespace http
+} // namespace websocketpp
+
+#endif // HTTP_PARSER_VIEW_REQUEST_IMPL_HPP
@@ -494,6 +494,19 @@ public:
      */
     bool parse_parameter_list(std::string const & in, parameter_list & out)
         const;
+
+    /// Exchange contents with another parser
+    /**
+     * Swapping with a default constructed parser releases all of the storage
+     * held by this one, which assignment does not guarantee.
+     *
+     * @param [in] other The parser to swap with.
+     */
+    void swap(parser & other) {
+        m_version.swap(other.m_version);
+        m_headers.swap(other.m_headers);
+        m_body.swap(other.m_body);
+    }
 protected:
     /// Parse headers from an istream
     /**
@@ -526,6 +539,11 @@ protected:
     std::string m_body;
 };
 
+/// Exchange the contents of two parsers
+inline void swap(parser & a, parser & b) {
+    a.swap(b);
+}
+
 } // namespace parser
 } // namespace http
 } // namespace websocketpp
@@ -103,6 +103,15 @@ public:
         return m_uri;
     }
 
+    /// Exchange contents with another request
+    void swap(request & other) {
+        parser::swap(other);
+        m_buf.swap(other.m_buf);
+        m_method.swap(other.m_method);
+        m_uri.swap(other.m_uri);
+        std::swap(m_ready,other.m_ready);
+    }
+
 private:
     /// Helper function for message::consume. Process request line
     void process(std::string::iterator begin, std::string::iterator end);
@@ -113,6 +122,11 @@ private:
     bool                            m_ready;
 };
 
+/// Exchange the contents of two requests
+inline void swap(request & a, request & b) {
+    a.swap(b);
+}
+
 } // namespace parser
 } // namespace http
 } // namespace websocketpp
@@ -137,6 +137,16 @@ public:
     const std::string& get_status_msg() const {
         return m_status_msg;
     }
+
+    /// Exchange contents with another response
+    void swap(response & other) {
+        parser::swap(other);
+        m_status_msg.swap(other.m_status_msg);
+        std::swap(m_read,other.m_read);
+        m_buf.swap(other.m_buf);
+        std::swap(m_status_code,other.m_status_code);
+        std::swap(m_state,other.m_state);
+    }
 private:
     /// Helper function for consume. Process response line
     void process(std::string::iterator begin, std::string::iterator end);
@@ -159,6 +169,11 @@ private:
 
 };
 
+/// Exchange the contents of two responses
+inline void swap(response & a, response & b) {
+    a.swap(b);
+}
+
 } // namespace parser
 } // namespace http
 } // namespace websocketpp
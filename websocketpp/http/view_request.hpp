@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef HTTP_PARSER_VIEW_REQUEST_HPP
+#define HTTP_PARSER_VIEW_REQUEST_HPP
+
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/http/parser.hpp>
+
+#include <string>
+#include <vector>
+
+namespace websocketpp {
+namespace http {
+namespace parser {
+
+/// Stores and parses HTTP requests without per header allocations
+/**
+ * http::parser::view_request is an alternative to http::parser::request with
+ * the same interface. It can be used as the `request_type` of an endpoint
+ * config in place of the default request type.
+ *
+ * The default request copies each header line into temporary strings and
+ * stores the result in a std::map. view_request instead keeps the raw request
+ * in a single buffer and parses it in place into a flat array of header
+ * entries. Each entry holds the offsets of the name and value within the
+ * buffer along with a case insensitive hash of the name. Lookups compare
+ * hashes before comparing names, and the headers used during the WebSocket
+ * handshake are indexed by precomputed hash so finding them does not depend
+ * on the number of headers in the request.
+ *
+ * Header values are only copied into a std::string the first time they are
+ * requested through get_header. Headers that are added or changed after
+ * parsing are stored in owned strings. Headers are written back out by raw()
+ * in the order they were received or added.
+ *
+ * References returned by get_header remain valid until the next call that
+ * adds or removes a header.
+ */
+class view_request {
+public:
+    typedef view_request type;
+    typedef lib::shared_ptr<type> ptr;
+
+    /// Number of header entries to reserve space for up front
+    static size_t const initial_header_count = 24;
+
+    /// Number of bytes of buffer to reserve on the first call to consume
+    static size_t const initial_buffer_size = 1024;
+
+    view_request()
+      : m_line_begin(0)
+      , m_scan_begin(0)
+      , m_ready(false)
+    {
+        m_headers.reserve(initial_header_count);
+        clear_known();
+    }
+
+    /// DEPRECATED parse a complete header (\r\n\r\n MUST be in the istream)
+    bool parse_complete(std::istream& s);
+
+    /// Process bytes in the input buffer
+    /**
+     * Process up to len bytes from input buffer buf. Returns the number of
+     * bytes processed. Bytes left unprocessed means bytes left over after the
+     * final header delimiters.
+     *
+     * Consume is a streaming processor with the same semantics as
+     * request::consume. Only the bytes received since the previous call are
+     * searched for line delimiters.
+     *
+     * Consume will throw an http::exception in the case of an error. Typical
+     * error reasons include malformed requests, incomplete requests, and max
+     * header size being reached.
+     *
+     * @param buf Pointer to byte buffer
+     * @param len Size of byte buffer
+     * @return Number of bytes processed.
+     */
+    size_t consume(char const * buf, size_t len);
+
+    /// Returns whether or not the request is ready for reading.
+    bool ready() const {
+        return m_ready;
+    }
+
+    /// Returns the full raw request
+    std::string raw() const;
+
+    /// Get the HTTP version string
+    std::string const & get_version() const {
+        return m_version;
+    }
+
+    /// Set HTTP parser Version
+    void set_version(std::string const & version) {
+        m_version = version;
+    }
+
+    /// Set the HTTP method. Must be a valid HTTP token
+    void set_method(std::string const & method);
+
+    /// Return the request method
+    std::string const & get_method() const {
+        return m_method;
+    }
+
+    /// Set the HTTP uri. Must be a valid HTTP uri
+    void set_uri(std::string const & uri) {
+        m_uri = uri;
+    }
+
+    /// Return the requested URI
+    std::string const & get_uri() const {
+        return m_uri;
+    }
+
+    /// Get the value of an HTTP header
+    /**
+     * Header names are matched case insensitively.
+     *
+     * @param [in] key The name/key of the header to get.
+     * @return The value associated with the given HTTP header key.
+     */
+    std::string const & get_header(std::string const & key) const;
+
+    /// Extract an HTTP parameter list from a header.
+    /**
+     * @param [in] key The name/key of the HTTP header to use as input.
+     * @param [out] out The parameter list to store extracted parameters in.
+     * @return Whether or not the input was a valid parameter list.
+     */
+    bool get_header_as_plist(std::string const & key, parameter_list & out)
+        const;
+
+    /// Append a value to an existing HTTP header
+    /**
+     * If a header with the name `key` already exists, `val` will be appended
+     * to the existing value separated by a comma.
+     *
+     * @param [in] key The name/key of the header to append to.
+     * @param [in] val The value to append.
+     */
+    void append_header(std::string const & key, std::string const & val);
+
+    /// Set a value for an HTTP header, replacing an existing value
+    /**
+     * @param [in] key The name/key of the header to set.
+     * @param [in] val The value to set.
+     */
+    void replace_header(std::string const & key, std::string const & val);
+
+    /// Remove a header from the request
+    /**
+     * @param [in] key The name/key of the header to remove.
+     */
+    void remove_header(std::string const & key);
+
+    /// Get the HTTP body
+    std::string const & get_body() const {
+        return m_body;
+    }
+
+    /// Set body content
+    /**
+     * Sets the body and the Content-Length header. See parser::set_body.
+     *
+     * @param value String data to include as the body content.
+     */
+    void set_body(std::string const & value);
+
+    /// Extract an HTTP parameter list from a string.
+    /**
+     * @param [in] in The input string.
+     * @param [out] out The parameter list to store extracted parameters in.
+     * @return Whether or not the input was a valid parameter list.
+     */
+    bool parse_parameter_list(std::string const & in, parameter_list & out)
+        const;
+
+    /// Returns the number of headers currently stored
+    size_t get_header_count() const {
+        return m_headers.size();
+    }
+
+    /// Exchange contents with another request
+    /**
+     * Swapping with a default constructed request releases the buffer and
+     * header storage held by this one.
+     *
+     * @param [in] other The request to swap with.
+     */
+    void swap(view_request & other) {
+        m_buf.swap(other.m_buf);
+        m_headers.swap(other.m_headers);
+        std::swap_ranges(m_known,m_known+num_known_headers,other.m_known);
+        std::swap(m_line_begin,other.m_line_begin);
+        std::swap(m_scan_begin,other.m_scan_begin);
+        m_method.swap(other.m_method);
+        m_uri.swap(other.m_uri);
+        m_version.swap(other.m_version);
+        m_body.swap(other.m_body);
+        std::swap(m_ready,other.m_ready);
+    }
+private:
+    /// A single header stored either as offsets into m_buf or owned strings
+    struct entry {
+        entry() : name_offset(0), name_length(0), value_offset(0),
+            value_length(0), hash(0), owned(false), cached(false) {}
+
+        size_t name_offset;
+        size_t name_length;
+        size_t value_offset;
+        size_t value_length;
+        uint32_t hash;
+        bool owned;
+        mutable bool cached;
+        std::string name;
+        mutable std::string value;
+    };
+
+    /// Headers looked up during the WebSocket opening handshake
+    enum known_header {
+        known_host = 0,
+        known_upgrade,
+        known_connection,
+        known_origin,
+        known_user_agent,
+        known_sec_websocket_key,
+        known_sec_websocket_version,
+        known_sec_websocket_protocol,
+        known_sec_websocket_extensions,
+        known_sec_websocket_origin,
+        known_sec_websocket_key1,
+        known_sec_websocket_key2,
+        known_sec_websocket_key3,
+        num_known_headers
+    };
+
+    /// Sentinel for a known header that is not present
+    static size_t const no_entry = static_cast<size_t>(-1);
+
+    /// Case insensitive FNV-1a hash of a header name
+    static uint32_t hash_name(char const * s, size_t len);
+
+    /// Case insensitive comparison of two header names
+    static bool equal_name(char const * a, size_t alen, char const * b,
+        size_t blen);
+
+    /// Returns the name and precomputed hash of a well-known header
+    static char const * known_name(size_t i);
+    static uint32_t known_hash(size_t i);
+
+    /// Returns the index of the known header matching the name, if any
+    static size_t find_known(char const * name, size_t len, uint32_t hash);
+
+    /// Process the request line [begin,end) of m_buf
+    void process_request_line(size_t begin, size_t end);
+
+    /// Process the header line [begin,end) of m_buf
+    void process_header_line(size_t begin, size_t end);
+
+    /// Pointer to the name of an entry
+    char const * name_data(entry const & e) const {
+        return e.owned ? e.name.data() : m_buf.data() + e.name_offset;
+    }
+
+    /// Length of the name of an entry
+    static size_t name_size(entry const & e) {
+        return e.owned ? e.name.size() : e.name_length;
+    }
+
+    /// Pointer to the value of an entry
+    char const * value_data(entry const & e) const {
+        return e.owned ? e.value.data() : m_buf.data() + e.value_offset;
+    }
+
+    /// Length of the value of an entry
+    static size_t value_size(entry const & e) {
+        return e.owned ? e.value.size() : e.value_length;
+    }
+
+    /// Returns the index of the entry with the given name or no_entry
+    size_t find(char const * name, size_t len, uint32_t hash) const;
+
+    /// Returns the value of an entry, materializing it if needed
+    std::string const & get_value(entry const & e) const;
+
+    /// Convert an entry to owned storage so it may be modified
+    void make_owned(entry & e);
+
+    /// Add a new owned header entry
+    void add_owned(std::string const & key, std::string const & val,
+        uint32_t hash);
+
+    /// Reset the index of known headers
+    void clear_known() {
+        for (size_t i = 0; i < num_known_headers; ++i) {
+            m_known[i] = no_entry;
+        }
+    }
+
+    /// Rebuild the index of known headers after entries have moved
+    void rebuild_known();
+
+    std::string         m_buf;
+    std::vector<entry>  m_headers;
+    size_t              m_known[num_known_headers];
+    size_t              m_line_begin;
+    size_t              m_scan_begin;
+    std::string         m_method;
+    std::string         m_uri;
+    std::string         m_version;
+    std::string         m_body;
+    bool                m_ready;
+};
+
+/// Exchange the contents of two requests
+inline void swap(view_request & a, view_request & b) {
+    a.swap(b);
+}
+
+} // namespace parser
+} // namespace http
+} // namespace websocketpp
+
+#include <websocketpp/http/impl/view_request.hpp>
+
+#endif // HTTP_PARSER_VIEW_REQUEST_HPP
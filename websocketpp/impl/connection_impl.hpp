@@ -65,6 +65,20 @@ size_t connection<config>::get_buffered_amount() const {
     return m_send_buffer_size;
 }
 
+template <typename config>
+size_t connection<config>::get_send_queue_depth(
+    message_buffer::lane::value lane) const
+{
+    scoped_lock_type lock(m_write_lock);
+    return m_send_queue.size(lane);
+}
+
+template <typename config>
+size_t connection<config>::get_expired_message_count() const {
+    scoped_lock_type lock(m_write_lock);
+    return m_expired_messages;
+}
+
 template <typename config>
 session::state::value connection<config>::get_state() const {
     //scoped_lock_type lock(m_connection_state_lock);
@@ -95,12 +109,157 @@ template <typename config>
 lib::error_code connection<config>::send(typename config::message_type::ptr msg)
 {
     m_alog.write(log::alevel::devel,"connection send");
-    // TODO:
 
+    // whole messages may not be interleaved with the frames of a stream
+    if (m_send_stream_active.load()) {
+        return error::make_error_code(error::send_stream_active);
+    }
+
+    return this->send_frame(msg);
+}
+
+template <typename config>
+lib::error_code connection<config>::send_stream_begin(frame::opcode::value op)
+{
+    m_alog.write(log::alevel::devel,"connection send_stream_begin");
+
+    if (m_state != session::state::open) {
+       return error::make_error_code(error::invalid_state);
+    }
+
+    if (op != frame::opcode::text && op != frame::opcode::binary) {
+        return processor::error::make_error_code(
+            processor::error::invalid_opcode);
+    }
+
+    // hybi00 has no fragmentation
+    if (m_processor->get_version() == 0) {
+        return processor::error::make_error_code(
+            processor::error::no_protocol_support);
+    }
+
+    if (m_send_stream_active.exchange(true)) {
+        return error::make_error_code(error::send_stream_active);
+    }
+
+    m_send_stream_op = op;
+    m_send_stream_started = false;
+    m_send_stream_validator.reset();
+
+    return lib::error_code();
+}
+
+template <typename config>
+lib::error_code connection<config>::send_stream_append(
+    std::string const & payload)
+{
+    return send_stream_append(payload.data(),payload.size());
+}
+
+template <typename config>
+lib::error_code connection<config>::send_stream_append(void const * payload,
+    size_t len)
+{
+    if (!m_send_stream_active.load()) {
+        return processor::error::make_error_code(
+            processor::error::invalid_continuation);
+    }
+
+    if (len == 0) {
+        return lib::error_code();
+    }
+
+    // only commit the new UTF8 state once the frame has been queued so that
+    // a rejected append can be retried
+    utf8_validator::validator validator = m_send_stream_validator;
+    if (m_send_stream_op == frame::opcode::text &&
+        !validator.decode(static_cast<uint8_t const *>(payload),len))
+    {
+        return error::make_error_code(error::invalid_utf8);
+    }
+
+    message_ptr msg = m_msg_manager->get_message(m_send_stream_started ?
+        frame::opcode::continuation : m_send_stream_op,len);
+    msg->append_payload(payload,len);
+    msg->set_fin(false);
+
+    lib::error_code ec = send_frame(msg);
+    if (!ec) {
+        m_send_stream_started = true;
+        m_send_stream_validator = validator;
+    }
+    return ec;
+}
+
+template <typename config>
+lib::error_code connection<config>::send_stream_end() {
+    if (!m_send_stream_active.load()) {
+        return processor::error::make_error_code(
+            processor::error::invalid_continuation);
+    }
+
+    if (m_send_stream_op == frame::opcode::text &&
+        !m_send_stream_validator.complete())
+    {
+        return error::make_error_code(error::invalid_utf8);
+    }
+
+    message_ptr msg = m_msg_manager->get_message(m_send_stream_started ?
+        frame::opcode::continuation : m_send_stream_op,0);
+    msg->set_fin(true);
+
+    lib::error_code ec = send_frame(msg);
+    if (!ec) {
+        m_send_stream_active = false;
+    }
+    return ec;
+}
+
+template <typename config>
+lib::error_code connection<config>::send_stream_abort() {
+    if (!m_send_stream_active.load()) {
+        return processor::error::make_error_code(
+            processor::error::invalid_continuation);
+    }
+
+    m_send_stream_active = false;
+    if (!m_send_stream_started) {
+        return lib::error_code();
+    }
+
+    // the peer has part of a message that will never be finished
+    close::status::value code = close::status::internal_endpoint_error;
+    if (m_send_stream_op == frame::opcode::text &&
+        !m_send_stream_validator.complete())
+    {
+        code = close::status::invalid_payload;
+    }
+
+    lib::error_code ec;
+    close(code,"Streamed message aborted",ec);
+    return ec;
+}
+
+template <typename config>
+lib::error_code connection<config>::send_frame(message_ptr msg) {
     if (m_state != session::state::open) {
        return error::make_error_code(error::invalid_state);
     }
 
+    if (m_max_buffered_amount > 0 && m_send_buffer_size +
+        msg->get_payload().size() > m_max_buffered_amount)
+    {
+        return error::make_error_code(error::send_queue_full);
+    }
+
+    if (config::enable_lockfree_send_queue) {
+        lib::error_code ec = send_lockfree(msg);
+        if (!ec) {
+            check_high_watermark();
+        }
+        return ec;
+    }
+
     message_ptr outgoing_msg;
     bool needs_writing = false;
 
@@ -109,7 +268,7 @@ lib::error_code connection<config>::send(typename config::message_type::ptr msg)
 
         scoped_lock_type lock(m_write_lock);
         write_push(outgoing_msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        needs_writing = !m_write_flag && m_send_queue.ready();
     } else {
         outgoing_msg = m_msg_manager->get_message();
 
@@ -125,9 +284,11 @@ lib::error_code connection<config>::send(typename config::message_type::ptr msg)
         }
 
         write_push(outgoing_msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        needs_writing = !m_write_flag && m_send_queue.ready();
     }
 
+    check_high_watermark();
+
     if (needs_writing) {
         transport_con_type::dispatch(lib::bind(
             &type::write_frame,
@@ -138,6 +299,120 @@ lib::error_code connection<config>::send(typename config::message_type::ptr msg)
     return lib::error_code();
 }
 
+template <typename config>
+void connection<config>::check_high_watermark() {
+    if (m_send_high_watermark == 0 ||
+        m_send_buffer_size < m_send_high_watermark)
+    {
+        return;
+    }
+
+    // exchange makes sure only one caller reports each crossing
+    if (!m_above_high_watermark.exchange(true)) {
+        m_alog.write(log::alevel::devel,"send buffer above high watermark");
+        if (m_high_watermark_handler) {
+            m_high_watermark_handler(m_connection_hdl);
+        }
+    }
+}
+
+template <typename config>
+void connection<config>::check_low_watermark() {
+    if (!m_above_high_watermark.load() ||
+        m_send_buffer_size > m_send_low_watermark)
+    {
+        return;
+    }
+
+    if (m_above_high_watermark.exchange(false)) {
+        m_alog.write(log::alevel::devel,"send buffer below low watermark");
+        if (m_low_watermark_handler) {
+            m_low_watermark_handler(m_connection_hdl);
+        }
+    }
+}
+
+template <typename config>
+lib::error_code connection<config>::send_lockfree(message_ptr msg) {
+    message_ptr outgoing_msg = msg;
+
+    if (!msg->get_prepared()) {
+        outgoing_msg = m_msg_manager->get_message();
+
+        if (!outgoing_msg) {
+            return error::make_error_code(error::no_outgoing_buffers);
+        }
+
+        if (m_processor->prepare_is_stateful(msg)) {
+            // Frames that advance processor state must be queued in the same
+            // order they were prepared in.
+            scoped_lock_type lock(m_frame_lock);
+            lib::error_code ec = m_processor->prepare_data_frame(msg,
+                outgoing_msg);
+
+            if (ec) {
+                return ec;
+            }
+
+            m_send_buffer_size += outgoing_msg->get_payload().size();
+            if (m_send_lockfree.push(outgoing_msg)) {
+                transport_con_type::dispatch(lib::bind(
+                    &type::write_frame,
+                    type::get_shared()
+                ));
+            }
+            return lib::error_code();
+        }
+
+        lib::error_code ec = m_processor->prepare_data_frame(msg,outgoing_msg);
+
+        if (ec) {
+            return ec;
+        }
+    }
+
+    m_send_buffer_size += outgoing_msg->get_payload().size();
+
+    // Only the producer that finds the queue empty schedules the writer. Later
+    // producers are picked up when that write_frame drains the queue.
+    if (m_send_lockfree.push(outgoing_msg)) {
+        transport_con_type::dispatch(lib::bind(
+            &type::write_frame,
+            type::get_shared()
+        ));
+    }
+
+    return lib::error_code();
+}
+
+template <typename config>
+int connection<config>::get_shared_frame_key(message_ptr msg) {
+    if (m_state != session::state::open || !m_processor) {
+        return -1;
+    }
+    return m_processor->get_shared_frame_key(msg);
+}
+
+template <typename config>
+lib::error_code connection<config>::prepare_data_frame(message_ptr in,
+    message_ptr out)
+{
+    if (m_state != session::state::open) {
+       return error::make_error_code(error::invalid_state);
+    }
+
+    if (config::enable_lockfree_send_queue) {
+        if (m_processor->prepare_is_stateful(in)) {
+            scoped_lock_type lock(m_frame_lock);
+            return m_processor->prepare_data_frame(in,out);
+        }
+        return m_processor->prepare_data_frame(in,out);
+    }
+
+    scoped_lock_type lock(m_write_lock);
+    return m_processor->prepare_data_frame(in,out);
+}
+
 template <typename config>
 void connection<config>::ping(const std::string& payload, lib::error_code& ec) {
     m_alog.write(log::alevel::devel,"connection ping");
@@ -186,7 +461,7 @@ void connection<config>::ping(const std::string& payload, lib::error_code& ec) {
     {
         scoped_lock_type lock(m_write_lock);
         write_push(msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        needs_writing = !m_write_flag && m_send_queue.ready();
     }
 
     if (needs_writing) {
@@ -236,21 +511,9 @@ void connection<config>::pong(const std::string& payload, lib::error_code& ec) {
         return;
     }
 
-    message_ptr msg = m_msg_manager->get_message();
-    if (!msg) {
-        ec = error::make_error_code(error::no_outgoing_buffers);
-        return;
-    }
-
-    ec = m_processor->prepare_pong(payload,msg);
-    if (ec) {return;}
-
     bool needs_writing = false;
-    {
-        scoped_lock_type lock(m_write_lock);
-        write_push(msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
-    }
+    ec = queue_pong(payload,needs_writing);
+    if (ec) {return;}
 
     if (needs_writing) {
         transport_con_type::dispatch(lib::bind(
@@ -258,8 +521,6 @@ void connection<config>::pong(const std::string& payload, lib::error_code& ec) {
             type::get_shared()
         ));
     }
-
-    ec = lib::error_code();
 }
 
 template<typename config>
@@ -657,10 +918,12 @@ void connection<config>::read_handshake(size_t num_bytes) {
         )
     );
 
+    this->acquire_read_buffer();
+
     transport_con_type::async_read_at_least(
         num_bytes,
-        m_buf,
-        config::connection_read_buffer_size,
+        this->get_read_buffer(),
+        this->get_read_buffer_size(),
         lib::bind(
             &type::handle_read_handshake,
             type::get_shared(),
@@ -706,9 +969,11 @@ void connection<config>::handle_read_handshake(const lib::error_code& ec,
         return;
     }
 
+    char * buf = this->get_read_buffer();
+
     size_t bytes_processed = 0;
     try {
-        bytes_processed = m_request.consume(m_buf,bytes_transferred);
+        bytes_processed = m_request.consume(buf,bytes_transferred);
     } catch (http::exception &e) {
         // All HTTP exceptions will result in this request failing and an error
         // response being returned. No more bytes will be read in this con.
@@ -744,7 +1009,7 @@ void connection<config>::handle_read_handshake(const lib::error_code& ec,
             if (bytes_transferred-bytes_processed >= 8) {
                 m_request.replace_header(
                     "Sec-WebSocket-Key3",
-                    std::string(m_buf+bytes_processed,m_buf+bytes_processed+8)
+                    std::string(buf+bytes_processed,buf+bytes_processed+8)
                 );
                 bytes_processed += 8;
             } else {
@@ -764,10 +1029,10 @@ void connection<config>::handle_read_handshake(const lib::error_code& ec,
             }
         }
 
-        // The remaining bytes in m_buf are frame data. Copy them to the
-        // beginning of the buffer and note the length. They will be read after
-        // the handshake completes and before more bytes are read.
-        std::copy(m_buf+bytes_processed,m_buf+bytes_transferred,m_buf);
+        // The remaining bytes in the read buffer are frame data. Copy them to
+        // the beginning of the buffer and note the length. They will be read
+        // after the handshake completes and before more bytes are read.
+        std::copy(buf+bytes_processed,buf+bytes_transferred,buf);
         m_buf_cursor = bytes_transferred-bytes_processed;
 
         this->atomic_state_change(
@@ -783,8 +1048,8 @@ void connection<config>::handle_read_handshake(const lib::error_code& ec,
         // read at least 1 more byte
         transport_con_type::async_read_at_least(
             1,
-            m_buf,
-            config::connection_read_buffer_size,
+            buf,
+            this->get_read_buffer_size(),
             lib::bind(
                 &type::handle_read_handshake,
                 type::get_shared(),
@@ -858,6 +1123,7 @@ void connection<config>::handle_read_frame(const lib::error_code& ec,
         return;
     }*/
 
+    char * buf = this->get_read_buffer();
     size_t p = 0;
 
     if (m_alog.static_test(log::alevel::devel)) {
@@ -877,12 +1143,12 @@ void connection<config>::handle_read_frame(const lib::error_code& ec,
 
         if (m_alog.static_test(log::alevel::devel)) {
             std::stringstream s;
-            s << "Processing Bytes: " << utility::to_hex(reinterpret_cast<uint8_t*>(m_buf)+p,bytes_transferred-p);
+            s << "Processing Bytes: " << utility::to_hex(reinterpret_cast<uint8_t*>(buf)+p,bytes_transferred-p);
             m_alog.write(log::alevel::devel,s.str());
         }
 
         p += m_processor->consume(
-            reinterpret_cast<uint8_t*>(m_buf)+p,
+            reinterpret_cast<uint8_t*>(buf)+p,
             bytes_transferred-p,
             ec
         );
@@ -920,6 +1186,32 @@ void connection<config>::handle_read_frame(const lib::error_code& ec,
                 m_alog.write(log::alevel::devel,s.str());
             }
 
+            message_chunk chunk;
+            if (m_message_chunk_handler &&
+                m_processor->get_message_chunk(chunk))
+            {
+                // streamed data message chunk, payload owned by the processor
+                if (m_state != session::state::open) {
+                    m_elog.write(log::elevel::warn,
+                        "got non-close data frame in state closing");
+                } else {
+                    m_message_chunk_handler(m_connection_hdl, chunk);
+                }
+                continue;
+            }
+
+            message_view view;
+            if (m_message_view_handler && m_processor->get_message_view(view)) {
+                // zero copy data message, view points into the read buffer
+                if (m_state != session::state::open) {
+                    m_elog.write(log::elevel::warn,
+                        "got non-close data frame in state closing");
+                } else {
+                    m_message_view_handler(m_connection_hdl, view);
+                }
+                continue;
+            }
+
             message_ptr msg = m_processor->get_message();
 
             if (!msg) {
@@ -930,6 +1222,10 @@ void connection<config>::handle_read_frame(const lib::error_code& ec,
                 if (m_state != session::state::open) {
                     m_elog.write(log::elevel::warn,
                         "got non-close data frame in state closing");
+                } else if (m_message_view_handler) {
+                    std::string const & payload = msg->get_payload();
+                    m_message_view_handler(m_connection_hdl, message_view(
+                        msg->get_opcode(), payload.data(), payload.size()));
                 } else if (m_message_handler) {
                     m_message_handler(m_connection_hdl, msg);
                 }
@@ -939,6 +1235,19 @@ void connection<config>::handle_read_frame(const lib::error_code& ec,
         }
     }
 
+    if (config::enable_lazy_read_buffer) {
+        // Hold on to a full buffer while a message is partially received or
+        // the last read filled the buffer, otherwise wait for more data with
+        // the embedded probe buffer.
+        if (m_processor->idle() &&
+            bytes_transferred < this->get_read_buffer_size())
+        {
+            this->release_read_buffer();
+        } else {
+            this->acquire_read_buffer();
+        }
+    }
+
     transport_con_type::async_read_at_least(
         // std::min wont work with undefined static const values.
         // TODO: is there a more elegant way to do this?
@@ -948,8 +1257,8 @@ void connection<config>::handle_read_frame(const lib::error_code& ec,
         /*(m_processor->get_bytes_needed() > config::connection_read_buffer_size ?
          config::connection_read_buffer_size : m_processor->get_bytes_needed())*/
         1,
-        m_buf,
-        config::connection_read_buffer_size,
+        this->get_read_buffer(),
+        this->get_read_buffer_size(),
         /*lib::bind(
             &type::handle_read_frame,
             type::get_shared(),
@@ -1219,6 +1528,10 @@ void connection<config>::handle_send_http_response(
         m_open_handler(m_connection_hdl);
     }
 
+    if (config::release_handshake_state) {
+        this->clear_handshake_state();
+    }
+
     this->handle_read_frame(lib::error_code(), m_buf_cursor);
 }
 
@@ -1306,10 +1619,12 @@ void connection<config>::handle_send_http_request(const lib::error_code& ec) {
         "handle_send_http_request must be called from WRITE_HTTP_REQUEST state"
     );
 
+    this->acquire_read_buffer();
+
     transport_con_type::async_read_at_least(
         1,
-        m_buf,
-        config::connection_read_buffer_size,
+        this->get_read_buffer(),
+        this->get_read_buffer_size(),
         lib::bind(
             &type::handle_read_http_response,
             type::get_shared(),
@@ -1336,10 +1651,13 @@ void connection<config>::handle_read_http_response(const lib::error_code& ec,
         this->terminate(ec);
         return;
     }
+
+    char * buf = this->get_read_buffer();
+
     size_t bytes_processed = 0;
     // TODO: refactor this to use error codes rather than exceptions
     try {
-        bytes_processed = m_response.consume(m_buf,bytes_transferred);
+        bytes_processed = m_response.consume(buf,bytes_transferred);
     } catch (http::exception & e) {
         m_elog.write(log::elevel::rerror,
             std::string("error in handle_read_http_response: ")+e.what());
@@ -1396,18 +1714,22 @@ void connection<config>::handle_read_http_response(const lib::error_code& ec,
             m_open_handler(m_connection_hdl);
         }
 
-        // The remaining bytes in m_buf are frame data. Copy them to the
-        // beginning of the buffer and note the length. They will be read after
-        // the handshake completes and before more bytes are read.
-        std::copy(m_buf+bytes_processed,m_buf+bytes_transferred,m_buf);
+        if (config::release_handshake_state) {
+            this->clear_handshake_state();
+        }
+
+        // The remaining bytes in the read buffer are frame data. Copy them to
+        // the beginning of the buffer and note the length. They will be read
+        // after the handshake completes and before more bytes are read.
+        std::copy(buf+bytes_processed,buf+bytes_transferred,buf);
         m_buf_cursor = bytes_transferred-bytes_processed;
 
         this->handle_read_frame(lib::error_code(), m_buf_cursor);
     } else {
         transport_con_type::async_read_at_least(
             1,
-            m_buf,
-            config::connection_read_buffer_size,
+            buf,
+            this->get_read_buffer_size(),
             lib::bind(
                 &type::handle_read_http_response,
                 type::get_shared(),
@@ -1544,6 +1866,10 @@ void connection<config>::write_frame() {
     {
         scoped_lock_type lock(m_write_lock);
 
+        if (config::enable_lockfree_send_queue) {
+            drain_send_queue();
+        }
+
         // Check the write flag. If true, there is an outstanding transport
         // write already. In this case we just return. The write handler will
         // start a new write if the write queue isn't empty. If false, we set
@@ -1554,54 +1880,109 @@ void connection<config>::write_frame() {
 
         // Get the next message in the queue. This will return an empty
         // message if the queue was empty.
-        m_current_msg = write_pop();
+        message_ptr next_message = write_pop();
 
-        if (!m_current_msg) {
+        if (!next_message) {
             return;
         }
 
-        // At this point we own the next message to be sent and are
-        // responsible for holding the write flag until it is successfully
+        // Drain as many additional queued messages as the coalescing limits
+        // allow into the same write. A terminal message ends the batch so that
+        // nothing queued after it reaches the wire.
+        size_t batch_bytes = 0;
+        while (next_message) {
+            m_current_msgs.push_back(next_message);
+            batch_bytes += next_message->get_header().size() +
+                next_message->get_payload().size();
+
+            // so that the peek below sees the message write_pop would return
+            drop_expired_messages();
+
+            if (next_message->get_terminal() ||
+                m_current_msgs.size() >=
+                    config::connection_write_coalesce_messages ||
+                !m_send_queue.ready())
+            {
+                break;
+            }
+
+            message_ptr const & peek = m_send_queue.front();
+            if (batch_bytes + peek->get_header().size() +
+                peek->get_payload().size() >
+                    config::connection_write_coalesce_bytes)
+            {
+                break;
+            }
+
+            next_message = write_pop();
+        }
+
+        // At this point we own the next messages to be sent and are
+        // responsible for holding the write flag until they are successfully
         // sent or there is some error
         m_write_flag = true;
     }
 
-    std::string const & header = m_current_msg->get_header();
-    std::string const & payload = m_current_msg->get_payload();
+    check_low_watermark();
 
-    m_send_buffer.push_back(transport::buffer(header.c_str(),header.size()));
-    m_send_buffer.push_back(transport::buffer(payload.c_str(),payload.size()));
+    typename std::vector<message_ptr>::const_iterator it;
+    for (it = m_current_msgs.begin(); it != m_current_msgs.end(); ++it) {
+        std::string const & header = (*it)->get_header();
+        std::string const & payload = (*it)->get_payload();
 
+        m_send_buffer.push_back(transport::buffer(header.c_str(),header.size()));
+        m_send_buffer.push_back(transport::buffer(payload.c_str(),payload.size()));
 
-    if (m_alog.static_test(log::alevel::frame_header)) {
-    if (m_alog.dynamic_test(log::alevel::frame_header)) {
-        std::stringstream s;
-        s << "Dispatching write with " << header.size()
-          << " header bytes and " << payload.size()
-          << " payload bytes" << std::endl;
-        m_alog.write(log::alevel::frame_header,s.str());
-        m_alog.write(log::alevel::frame_header,"Header: "+utility::to_hex(header));
-    }
-    }
-    if (m_alog.static_test(log::alevel::frame_payload)) {
-    if (m_alog.dynamic_test(log::alevel::frame_payload)) {
-        m_alog.write(log::alevel::frame_payload,"Payload: "+utility::to_hex(payload));
-    }
+        if (m_alog.static_test(log::alevel::frame_header)) {
+        if (m_alog.dynamic_test(log::alevel::frame_header)) {
+            std::stringstream s;
+            s << "Dispatching write with " << header.size()
+              << " header bytes and " << payload.size()
+              << " payload bytes" << std::endl;
+            m_alog.write(log::alevel::frame_header,s.str());
+            m_alog.write(log::alevel::frame_header,"Header: "+utility::to_hex(header));
+        }
+        }
+        if (m_alog.static_test(log::alevel::frame_payload)) {
+        if (m_alog.dynamic_test(log::alevel::frame_payload)) {
+            m_alog.write(log::alevel::frame_payload,"Payload: "+utility::to_hex(payload));
+        }
+        }
     }
 
-
     transport_con_type::async_write(
         m_send_buffer,
-        /*lib::bind(
-            &type::handle_write_frame,
-            type::get_shared(),
-            m_current_msg->get_terminal(),
-            lib::placeholders::_1
-        )*/
         m_write_frame_handler
     );
 }
 
+template <typename config>
+lib::error_code connection<config>::queue_pong(std::string const & payload,
+    bool & needs_writing)
+{
+    scoped_lock_type lock(m_write_lock);
+
+    // Once the write holding the last pong has completed the connection owns
+    // the only reference and the frame can be rewritten in place.
+    if (!m_pong_msg || m_pong_msg.use_count() != 1) {
+        m_pong_msg = m_msg_manager->get_message(frame::opcode::PONG,
+            frame::limits::payload_size_basic);
+        if (!m_pong_msg) {
+            return error::make_error_code(error::no_outgoing_buffers);
+        }
+    }
+
+    lib::error_code ec = m_processor->prepare_pong(payload,m_pong_msg);
+    if (ec) {
+        return ec;
+    }
+
+    write_push(m_pong_msg);
+    needs_writing = !m_write_flag && m_send_queue.ready();
+
+    return lib::error_code();
+}
+
 template <typename config>
 void connection<config>::handle_write_frame(lib::error_code const & ec)
 {
@@ -1609,10 +1990,10 @@ void connection<config>::handle_write_frame(lib::error_code const & ec)
         m_alog.write(log::alevel::devel,"connection handle_write_frame");
     }
 
-    bool terminate = m_current_msg->get_terminal();
+    bool terminate = m_current_msgs.back()->get_terminal();
 
     m_send_buffer.clear();
-    m_current_msg.reset();
+    m_current_msgs.clear();
 
     if (ec) {
         m_elog.write(log::elevel::fatal,"error in handle_write_frame: "+ec.message());
@@ -1632,7 +2013,11 @@ void connection<config>::handle_write_frame(lib::error_code const & ec)
         // release write flag
         m_write_flag = false;
 
-        needs_writing = !m_send_queue.empty();
+        if (config::enable_lockfree_send_queue) {
+            drain_send_queue();
+        }
+
+        needs_writing = m_send_queue.ready();
     }
 
     if (needs_writing) {
@@ -1696,14 +2081,20 @@ template <typename config>
 void connection<config>::process_control_frame(typename
     config::message_type::ptr msg)
 {
-    m_alog.write(log::alevel::devel,"process_control_frame");
+    if (m_alog.static_test(log::alevel::devel)) {
+        m_alog.write(log::alevel::devel,"process_control_frame");
+    }
 
     frame::opcode::value op = msg->get_opcode();
     lib::error_code ec;
 
-    std::stringstream s;
-    s << "Control frame received with opcode " << op;
-    m_alog.write(log::alevel::control,s.str());
+    if (m_alog.static_test(log::alevel::control)) {
+    if (m_alog.dynamic_test(log::alevel::control)) {
+        std::stringstream s;
+        s << "Control frame received with opcode " << op;
+        m_alog.write(log::alevel::control,s.str());
+    }
+    }
 
     if (m_state == session::state::closed) {
         m_elog.write(log::elevel::warn,"got frame in state closed");
@@ -1722,10 +2113,15 @@ void connection<config>::process_control_frame(typename
         }
 
         if (pong) {
-            this->pong(msg->get_payload(),ec);
+            // Already running in the read handler, so the write can start
+            // here rather than going through dispatch.
+            bool needs_writing = false;
+            ec = queue_pong(msg->get_payload(),needs_writing);
             if (ec) {
                 m_elog.write(log::elevel::devel,
                     "Failed to send response pong: "+ec.message());
+            } else if (needs_writing) {
+                this->write_frame();
             }
         }
     } else if (op == frame::opcode::PONG) {
@@ -1908,7 +2304,7 @@ lib::error_code connection<config>::send_close_frame(close::status::value code,
     {
         scoped_lock_type lock(m_write_lock);
         write_push(msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        needs_writing = !m_write_flag && m_send_queue.ready();
     }
 
     if (needs_writing) {
@@ -1924,10 +2320,12 @@ lib::error_code connection<config>::send_close_frame(close::status::value code,
 template <typename config>
 typename connection<config>::processor_ptr
 connection<config>::get_processor(int version) const {
+    processor_ptr ret;
+
     // TODO: allow disabling certain versions
     switch (version) {
         case 0:
-            return processor_ptr(
+            ret.reset(
                 new processor::hybi00<config>(
                     transport_con_type::is_secure(),
                     m_is_server,
@@ -1936,7 +2334,7 @@ connection<config>::get_processor(int version) const {
             );
             break;
         case 7:
-            return processor_ptr(
+            ret.reset(
                 new processor::hybi07<config>(
                     transport_con_type::is_secure(),
                     m_is_server,
@@ -1946,7 +2344,7 @@ connection<config>::get_processor(int version) const {
             );
             break;
         case 8:
-            return processor_ptr(
+            ret.reset(
                 new processor::hybi08<config>(
                     transport_con_type::is_secure(),
                     m_is_server,
@@ -1956,7 +2354,7 @@ connection<config>::get_processor(int version) const {
             );
             break;
         case 13:
-            return processor_ptr(
+            ret.reset(
                 new processor::hybi13<config>(
                     transport_con_type::is_secure(),
                     m_is_server,
@@ -1966,8 +2364,15 @@ connection<config>::get_processor(int version) const {
             );
             break;
         default:
-            return processor_ptr();
+            return ret;
     }
+
+    // Zero copy delivery is only useful if someone will consume the views
+    ret->set_zero_copy(static_cast<bool>(m_message_view_handler));
+    ret->set_streaming(static_cast<bool>(m_message_chunk_handler));
+    ret->set_max_message_size(m_max_message_size);
+
+    return ret;
 }
 
 template <typename config>
@@ -1977,13 +2382,25 @@ void connection<config>::write_push(typename config::message_type::ptr msg)
         return;
     }
 
+    // Anything already sent through the lock-free queue goes first
+    if (config::enable_lockfree_send_queue) {
+        drain_send_queue();
+    }
+
     m_send_buffer_size += msg->get_payload().size();
-    m_send_queue.push(msg);
 
-    std::stringstream s;
-    s << "write_push: message count: " << m_send_queue.size()
-      << " buffer size: " << m_send_buffer_size;
-    m_alog.write(log::alevel::devel,s.str());
+    // a conflated message may replace one that is still queued
+    message_ptr replaced = m_send_queue.push(msg);
+    if (replaced) {
+        m_send_buffer_size -= replaced->get_payload().size();
+    }
+
+    if (m_alog.static_test(log::alevel::devel)) {
+        std::stringstream s;
+        s << "write_push: message count: " << m_send_queue.size()
+          << " buffer size: " << m_send_buffer_size;
+        m_alog.write(log::alevel::devel,s.str());
+    }
 }
 
 template <typename config>
@@ -1991,7 +2408,9 @@ typename config::message_type::ptr connection<config>::write_pop()
 {
     message_ptr msg;
 
-    if (m_send_queue.empty()) {
+    drop_expired_messages();
+
+    if (!m_send_queue.ready()) {
         return msg;
     }
 
@@ -2000,13 +2419,102 @@ typename config::message_type::ptr connection<config>::write_pop()
     m_send_buffer_size -= msg->get_payload().size();
     m_send_queue.pop();
 
-    std::stringstream s;
-    s << "write_pop: message count: " << m_send_queue.size()
-      << " buffer size: " << m_send_buffer_size;
-    m_alog.write(log::alevel::devel,s.str());
+    if (m_alog.static_test(log::alevel::devel)) {
+        std::stringstream s;
+        s << "write_pop: message count: " << m_send_queue.size()
+          << " buffer size: " << m_send_buffer_size;
+        m_alog.write(log::alevel::devel,s.str());
+    }
     return msg;
 }
 
+template <typename config>
+void connection<config>::clear_handshake_state() {
+    // swap with empty values so the storage is released rather than kept
+    // for reuse as assignment might
+    using std::swap;
+
+    request_type empty_request;
+    swap(m_request,empty_request);
+
+    response_type empty_response;
+    swap(m_response,empty_response);
+
+    std::string().swap(m_handshake_buffer);
+    std::vector<std::string>().swap(m_requested_subprotocols);
+}
+
+template <typename config>
+void connection<config>::acquire_read_buffer() {
+    if (config::enable_lazy_read_buffer && !m_read_block) {
+        m_read_block = read_buffer_pool::acquire();
+    }
+}
+
+template <typename config>
+void connection<config>::release_read_buffer() {
+    if (m_read_block) {
+        read_buffer_pool::release(m_read_block);
+        m_read_block = NULL;
+    }
+}
+
+template <typename config>
+void connection<config>::drop_expired_messages()
+{
+    // only read the clock if a message with a deadline is up next
+    uint64_t now = 0;
+
+    while (m_send_queue.ready()) {
+        message_ptr const & msg = m_send_queue.front();
+        frame::opcode::value op = msg->get_opcode();
+
+        // dropping a fragment would corrupt the message it belongs to, and
+        // dropping a deflated frame would desync the peer's inflater
+        if (msg->get_deadline() == 0 ||
+            !msg->get_fin() ||
+            msg->get_compressed() ||
+            (op != frame::opcode::TEXT && op != frame::opcode::BINARY))
+        {
+            return;
+        }
+
+        if (now == 0) {
+            now = lib::now_ms();
+        }
+        if (!msg->get_expired(now)) {
+            return;
+        }
+
+        m_send_buffer_size -= msg->get_payload().size();
+        m_expired_messages++;
+
+        if (m_alog.static_test(log::alevel::devel)) {
+            std::stringstream s;
+            s << "dropping expired message of " << msg->get_payload().size()
+              << " bytes";
+            m_alog.write(log::alevel::devel,s.str());
+        }
+
+        m_send_queue.pop();
+    }
+}
+
+template <typename config>
+void connection<config>::drain_send_queue()
+{
+    // payload sizes were added to m_send_buffer_size when pushed
+    send_queue_appender append(m_send_queue,m_send_buffer_size);
+    size_t count = m_send_lockfree.pop_all(append);
+
+    if (count > 0 && m_alog.static_test(log::alevel::devel)) {
+        std::stringstream s;
+        s << "drain_send_queue: moved " << count << " messages, count: "
+          << m_send_queue.size() << " buffer size: " << m_send_buffer_size;
+        m_alog.write(log::alevel::devel,s.str());
+    }
+}
+
 template <typename config>
 void connection<config>::log_open_result()
 {
@@ -41,9 +41,20 @@ endpoint<connection,config>::create_connection() {
     }*/
 
     //scoped_lock_type guard(m_mutex);
-    // Create a connection on the heap and manage it using a shared pointer
-    connection_ptr con(new connection_type(m_is_server,m_user_agent,m_alog,
-        m_elog, m_rng));
+    connection_ptr con;
+
+    if (config::enable_connection_pool) {
+        // Allocate the connection and its shared_ptr control block together
+        // in a block from this thread's pool. The block goes back to the
+        // pool once the last connection_ptr and connection_hdl are gone.
+        con = lib::allocate_shared<connection_type>(connection_allocator(),
+            m_is_server, m_user_agent, lib::ref(m_alog), lib::ref(m_elog),
+            lib::ref(m_rng), m_msg_manager.get_manager());
+    } else {
+        // Create a connection on the heap and manage it using a shared pointer
+        con.reset(new connection_type(m_is_server,m_user_agent,m_alog,
+            m_elog, m_rng, m_msg_manager.get_manager()));
+    }
 
     connection_weak_ptr w(con);
 
@@ -64,6 +75,10 @@ endpoint<connection,config>::create_connection() {
     con->set_http_handler(m_http_handler);
     con->set_validate_handler(m_validate_handler);
     con->set_message_handler(m_message_handler);
+    con->set_message_view_handler(m_message_view_handler);
+    con->set_message_chunk_handler(m_message_chunk_handler);
+    con->set_high_watermark_handler(m_high_watermark_handler);
+    con->set_low_watermark_handler(m_low_watermark_handler);
     
     if (m_open_handshake_timeout_dur == config::timeout_open_handshake) {
         con->set_open_handshake_timeout(m_open_handshake_timeout_dur);
@@ -74,6 +89,7 @@ endpoint<connection,config>::create_connection() {
     if (m_pong_timeout_dur == config::timeout_pong) {
         con->set_pong_timeout(m_pong_timeout_dur);
     }
+    con->set_max_message_size(m_max_message_size);
 
     lib::error_code ec;
 
@@ -158,6 +174,105 @@ void endpoint<connection,config>::send(connection_hdl hdl, message_ptr msg) {
     if (ec) { throw ec; }
 }
 
+template <typename connection, typename config>
+template <typename iterator_type>
+size_t endpoint<connection,config>::broadcast(iterator_type begin,
+    iterator_type end, message_ptr msg, lib::error_code & ec)
+{
+    typedef std::pair<int,message_ptr> shared_frame;
+
+    // One prepared frame per distinct shared frame key. There are only a
+    // handful of framing configurations so a linear search is fine.
+    std::vector<shared_frame> frames;
+    size_t sent = 0;
+
+    ec = lib::error_code();
+
+    for (; begin != end; ++begin) {
+        lib::error_code con_ec;
+        connection_ptr con = get_con_from_hdl(*begin,con_ec);
+        if (con_ec) {continue;}
+
+        int key = msg->get_prepared() ? -1 : con->get_shared_frame_key(msg);
+
+        if (key < 0) {
+            if (!con->send(msg)) {sent++;}
+            continue;
+        }
+
+        message_ptr frame;
+        for (size_t i = 0; i < frames.size(); i++) {
+            if (frames[i].first == key) {
+                frame = frames[i].second;
+                break;
+            }
+        }
+
+        if (!frame) {
+            frame = con->get_message(msg->get_opcode(),
+                msg->get_payload().size());
+            if (!frame) {
+                ec = error::make_error_code(error::no_outgoing_buffers);
+                return sent;
+            }
+
+            con_ec = con->prepare_data_frame(msg,frame);
+            if (con_ec == error::make_error_code(error::invalid_state)) {
+                continue;
+            } else if (con_ec) {
+                // the message itself is bad, it would fail everywhere.
+                ec = con_ec;
+                return sent;
+            }
+            frames.push_back(shared_frame(key,frame));
+        }
+
+        if (!con->send(frame)) {sent++;}
+    }
+
+    return sent;
+}
+
+template <typename connection, typename config>
+template <typename iterator_type>
+size_t endpoint<connection,config>::broadcast(iterator_type begin,
+    iterator_type end, message_ptr msg)
+{
+    lib::error_code ec;
+    size_t sent = broadcast(begin,end,msg,ec);
+    if (ec) { throw ec; }
+    return sent;
+}
+
+template <typename connection, typename config>
+template <typename iterator_type>
+size_t endpoint<connection,config>::broadcast(iterator_type begin,
+    iterator_type end, std::string const & payload, frame::opcode::value op,
+    lib::error_code & ec)
+{
+    message_ptr msg = m_msg_manager.get_manager()->get_message(op,
+        payload.size());
+    if (!msg) {
+        ec = error::make_error_code(error::no_outgoing_buffers);
+        return 0;
+    }
+    msg->append_payload(payload);
+    msg->set_compressed(true);
+
+    return broadcast(begin,end,msg,ec);
+}
+
+template <typename connection, typename config>
+template <typename iterator_type>
+size_t endpoint<connection,config>::broadcast(iterator_type begin,
+    iterator_type end, std::string const & payload, frame::opcode::value op)
+{
+    lib::error_code ec;
+    size_t sent = broadcast(begin,end,payload,op,ec);
+    if (ec) { throw ec; }
+    return sent;
+}
+
 template <typename connection, typename config>
 void endpoint<connection,config>::close(connection_hdl hdl, close::status::value
     const code, std::string const & reason,
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_MESSAGE_BUFFER_BLOCK_POOL_HPP
+#define WEBSOCKETPP_MESSAGE_BUFFER_BLOCK_POOL_HPP
+
+#include <websocketpp/common/cpp11.hpp>
+
+#include <cstddef>
+#include <new>
+
+namespace websocketpp {
+namespace message_buffer {
+
+/// Per-thread cache of fixed size buffers
+/**
+ * Hands out blocks of block_size bytes for short term use, such as a read in
+ * progress, and keeps up to max_cached released blocks on a free list per
+ * thread so that borrowing a block again doesn't touch the heap or any lock.
+ * A block may be released on a different thread than the one it was acquired
+ * on, it is then cached by the releasing thread.
+ *
+ * Blocks come from new char[] and are suitably aligned for any object that
+ * does not require extended alignment, so they may also hold objects
+ * constructed with placement new.
+ *
+ * When the compiler supports thread_local the blocks cached by a thread are
+ * freed when it exits. Otherwise a thread should call trim before exiting or
+ * its cached blocks are leaked.
+ *
+ * block_size must be at least the size of a pointer.
+ */
+template <size_t block_size, size_t max_cached = 64>
+class block_pool {
+public:
+    /// Size in bytes of the blocks handed out
+    static size_t const size = block_size;
+
+    /// Counters describing the effectiveness of a block pool on one thread
+    struct stats {
+        stats() : hits(0), misses(0), recycled(0), discarded(0) {}
+
+        /// Blocks handed out from the cache
+        size_t hits;
+        /// Blocks that required a new allocation
+        size_t misses;
+        /// Blocks returned to the cache
+        size_t recycled;
+        /// Blocks freed on release because the cache was full
+        size_t discarded;
+    };
+
+    /// Borrow a block
+    /**
+     * @return A block of block_size bytes, to be returned with release
+     */
+    static char * acquire() {
+        free_list & l = local();
+
+        if (!l.head) {
+            ++l.misses;
+            return new char[block_size];
+        }
+
+        node * n = l.head;
+        l.head = n->next;
+        --l.count;
+        ++l.hits;
+        return reinterpret_cast<char *>(n);
+    }
+
+    /// Return a block acquired from this pool
+    /**
+     * The block is cached by the calling thread, or freed if that thread
+     * already caches max_cached blocks.
+     *
+     * @param block The block to return. May be NULL.
+     */
+    static void release(char * block) {
+        if (!block) {
+            return;
+        }
+
+        free_list & l = local();
+
+        if (l.count >= max_cached) {
+            ++l.discarded;
+            delete[] block;
+            return;
+        }
+
+        push(l,block);
+        ++l.recycled;
+    }
+
+    /// Fill the calling thread's cache
+    /**
+     * Allocates blocks until the calling thread caches n blocks, or
+     * max_cached if that is smaller, so that later calls to acquire on this
+     * thread don't need to allocate.
+     *
+     * @param n The number of blocks to cache
+     */
+    static void reserve(size_t n) {
+        free_list & l = local();
+
+        while (l.count < n && l.count < max_cached) {
+            push(l,new char[block_size]);
+        }
+    }
+
+    /// Get the number of blocks cached by the calling thread
+    static size_t cached() {
+        return local().count;
+    }
+
+    /// Get the counters for the calling thread
+    static stats get_stats() {
+        free_list const & l = local();
+
+        stats ret;
+        ret.hits = l.hits;
+        ret.misses = l.misses;
+        ret.recycled = l.recycled;
+        ret.discarded = l.discarded;
+        return ret;
+    }
+
+    /// Free the blocks cached by the calling thread
+    static void trim() {
+        clear(local());
+    }
+private:
+    struct node {
+        node * next;
+    };
+
+    // POD so that it may be stored in __thread storage
+    struct free_list {
+        node * head;
+        size_t count;
+        size_t hits;
+        size_t misses;
+        size_t recycled;
+        size_t discarded;
+    };
+
+    static void push(free_list & l, char * block) {
+        node * n = reinterpret_cast<node *>(block);
+        n->next = l.head;
+        l.head = n;
+        ++l.count;
+    }
+
+    static void clear(free_list & l) {
+        while (l.head) {
+            node * n = l.head;
+            l.head = n->next;
+            delete[] reinterpret_cast<char *>(n);
+        }
+        l.count = 0;
+    }
+
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_
+    struct owner {
+        owner() {
+            free_list empty = {NULL, 0, 0, 0, 0, 0};
+            list = empty;
+        }
+        ~owner() {
+            clear(list);
+        }
+        free_list list;
+    };
+
+    static free_list & local() {
+        static thread_local owner o;
+        return o.list;
+    }
+#else
+    static free_list & local() {
+        // zero initialized
+#ifdef _MSC_VER
+        static __declspec(thread) free_list l;
+#else
+        static __thread free_list l;
+#endif
+        return l;
+    }
+#endif
+};
+
+/// Allocator that takes single objects from a block_pool
+/**
+ * Lets allocate_shared place an object and its shared_ptr control block
+ * together in one pooled block. Requests for more than one object, or for
+ * an object larger than the pool's blocks, are passed to operator new.
+ */
+template <typename T, typename pool>
+class block_pool_allocator {
+public:
+    typedef T value_type;
+    typedef T * pointer;
+    typedef T const * const_pointer;
+    typedef T & reference;
+    typedef T const & const_reference;
+    typedef size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef block_pool_allocator<U,pool> other;
+    };
+
+    block_pool_allocator() {}
+
+    template <typename U>
+    block_pool_allocator(block_pool_allocator<U,pool> const &) {}
+
+    pointer address(reference x) const {
+        return &x;
+    }
+
+    const_pointer address(const_reference x) const {
+        return &x;
+    }
+
+    pointer allocate(size_type n, void const * = 0) {
+        if (pooled(n)) {
+            return reinterpret_cast<pointer>(pool::acquire());
+        }
+        return static_cast<pointer>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(pointer p, size_type n) {
+        if (pooled(n)) {
+            pool::release(reinterpret_cast<char *>(p));
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    size_type max_size() const {
+        return size_type(-1) / sizeof(T);
+    }
+
+    void construct(pointer p, const_reference v) {
+        new (p) T(v);
+    }
+
+    void destroy(pointer p) {
+        p->~T();
+    }
+private:
+    static bool pooled(size_type n) {
+        return n == 1 && sizeof(T) <= pool::size;
+    }
+};
+
+template <typename T, typename U, typename pool>
+bool operator==(block_pool_allocator<T,pool> const &,
+    block_pool_allocator<U,pool> const &)
+{
+    return true;
+}
+
+template <typename T, typename U, typename pool>
+bool operator!=(block_pool_allocator<T,pool> const &,
+    block_pool_allocator<U,pool> const &)
+{
+    return false;
+}
+
+} // namespace message_buffer
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_MESSAGE_BUFFER_BLOCK_POOL_HPP
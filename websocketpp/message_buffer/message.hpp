@@ -28,6 +28,7 @@
 #ifndef WEBSOCKETPP_MESSAGE_BUFFER_MESSAGE_HPP
 #define WEBSOCKETPP_MESSAGE_BUFFER_MESSAGE_HPP
 
+#include <websocketpp/common/chrono.hpp>
 #include <websocketpp/common/memory.hpp>
 #include <websocketpp/frame.hpp>
 
@@ -74,6 +75,68 @@ namespace message_buffer {
  *    of reduced concurrency
  */
 
+/// Send priorities that may be assigned to outgoing data messages
+/**
+ * Each priority has its own lane in the connection's send queue. Higher lanes
+ * are always written first. Messages of the same priority keep their order.
+ */
+namespace priority {
+enum value {
+    high = 0,
+    normal = 1,
+    low = 2
+};
+} // namespace priority
+
+/// Non-owning view of a received message payload
+/**
+ * Used by the zero copy receive path. The payload points into memory owned by
+ * the connection (its read buffer or a message object it holds) and is only
+ * valid for the duration of the handler call the view was passed to.
+ */
+struct message_view {
+    message_view() : opcode(frame::opcode::text), payload(NULL), length(0) {}
+
+    message_view(frame::opcode::value op, char const * p, size_t l)
+      : opcode(op), payload(p), length(l) {}
+
+    /// Opcode of the message (text or binary)
+    frame::opcode::value opcode;
+    /// Pointer to the unmasked payload bytes
+    char const * payload;
+    /// Length of the payload in bytes
+    size_t length;
+};
+
+/// Part of a received message delivered by the streaming receive path
+/**
+ * Data messages are handed out in pieces as their frames are read instead of
+ * being assembled in memory. Text chunks are validated but may end in the
+ * middle of a UTF8 sequence. The payload is only valid for the duration of
+ * the handler call the chunk was passed to.
+ */
+struct message_chunk {
+    message_chunk()
+      : opcode(frame::opcode::text)
+      , payload(NULL)
+      , length(0)
+      , fin(false)
+      , sequence(0)
+      , offset(0) {}
+
+    /// Opcode of the message the chunk belongs to (text or binary)
+    frame::opcode::value opcode;
+    /// Pointer to the unmasked, decompressed payload bytes
+    char const * payload;
+    /// Length of the chunk in bytes
+    size_t length;
+    /// Whether this is the last chunk of the message
+    bool fin;
+    /// Number of the message on this connection, starting at zero
+    uint64_t sequence;
+    /// Offset of the chunk within the message payload
+    uint64_t offset;
+};
 
 /// Represents a buffer for a single WebSocket message.
 /**
@@ -98,7 +161,9 @@ public:
       , m_prepared(false)
       , m_fin(true)
       , m_terminal(false)
-      , m_compressed(false) {}
+      , m_compressed(false)
+      , m_priority(priority::normal)
+      , m_deadline(0) {}
 
     /// Construct a message and fill in some values
     /**
@@ -111,6 +176,8 @@ public:
       , m_fin(true)
       , m_terminal(false)
       , m_compressed(false)
+      , m_priority(priority::normal)
+      , m_deadline(0)
     {
         m_payload.reserve(size);
     }
@@ -206,6 +273,102 @@ public:
         m_fin = value;
     }
 
+    /// Get the send priority
+    /**
+     * @return The send queue lane this message uses if it is a data message
+     */
+    priority::value get_priority() const {
+        return m_priority;
+    }
+
+    /// Set the send priority
+    /**
+     * Data messages with a higher priority are written ahead of lower priority
+     * messages queued earlier on the same connection. Control frames always go
+     * first regardless of this value.
+     *
+     * Messages that end up compressed by permessage-deflate are always sent
+     * in order and ignore this value, as the peer must inflate them in the
+     * order they were deflated. Clear the compressed flag on messages whose
+     * priority matters.
+     *
+     * @param value The priority to send this message with.
+     */
+    void set_priority(priority::value value) {
+        m_priority = value;
+    }
+
+    /// Get the conflation key
+    /**
+     * @return The conflation key, empty if the message isn't conflated
+     */
+    std::string const & get_conflation_key() const {
+        return m_conflation_key;
+    }
+
+    /// Set the conflation key
+    /**
+     * A message sent with a conflation key replaces a message with the same
+     * key and priority that is still waiting in the connection's send queue.
+     * Useful for feeds where only the latest value per key matters, the
+     * queue is then bounded by the number of distinct keys rather than the
+     * update rate. Only whole (fin) text and binary messages are conflated.
+     *
+     * Messages compressed by permessage-deflate are never conflated, since
+     * dropping one would corrupt the deflate stream the peer inflates later
+     * messages against. Clear the compressed flag on conflated messages.
+     *
+     * @param key The key to conflate on, empty to disable conflation
+     */
+    void set_conflation_key(std::string const & key) {
+        m_conflation_key = key;
+    }
+
+    /// Get the send deadline
+    /**
+     * @return The time, in lib::now_ms() milliseconds, after which the message
+     * is dropped instead of sent. Zero means the message never expires.
+     */
+    uint64_t get_deadline() const {
+        return m_deadline;
+    }
+
+    /// Set the send deadline
+    /**
+     * A whole text or binary message that is still in the connection's send
+     * queue after its deadline is discarded without being written. Use for
+     * data that is worthless once late, such as live state updates.
+     *
+     * Messages compressed by permessage-deflate never expire, the peer
+     * inflates later messages against their deflate output. Clear the
+     * compressed flag on messages with a deadline.
+     *
+     * @param deadline The deadline in lib::now_ms() milliseconds, zero to
+     * disable expiry
+     */
+    void set_deadline(uint64_t deadline) {
+        m_deadline = deadline;
+    }
+
+    /// Set the send deadline relative to now
+    /**
+     * @see set_deadline()
+     *
+     * @param ttl Milliseconds from now that the message may wait to be sent
+     */
+    void set_ttl(uint64_t ttl) {
+        m_deadline = lib::now_ms() + ttl;
+    }
+
+    /// Return whether the message has a deadline that has passed
+    /**
+     * @param now The current time from lib::now_ms()
+     * @return Whether the message has expired at the time now
+     */
+    bool get_expired(uint64_t now) const {
+        return m_deadline != 0 && now > m_deadline;
+    }
+
     /// Return the message opcode
     frame::opcode::value get_opcode() const {
         return m_opcode;
@@ -327,11 +490,14 @@ private:
     std::string                 m_header;
     std::string                 m_extension_data;
     std::string                 m_payload;
+    std::string                 m_conflation_key;
     frame::opcode::value        m_opcode;
     bool                        m_prepared;
     bool                        m_fin;
     bool                        m_terminal;
     bool                        m_compressed;
+    priority::value             m_priority;
+    uint64_t                    m_deadline;
 };
 
 } // namespace message_buffer
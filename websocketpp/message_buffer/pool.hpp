@@ -25,54 +25,20 @@
  *
  */
 
-#ifndef WEBSOCKETPP_MESSAGE_BUFFER_ALLOC_HPP
-#define WEBSOCKETPP_MESSAGE_BUFFER_ALLOC_HPP
+#ifndef WEBSOCKETPP_MESSAGE_BUFFER_POOL_HPP
+#define WEBSOCKETPP_MESSAGE_BUFFER_POOL_HPP
 
 #include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/frame.hpp>
+#include <websocketpp/message_buffer/message.hpp>
 
 #include <string>
+#include <vector>
 
 namespace websocketpp {
 namespace message_buffer {
 
-/* # message:
- * object that stores a message while it is being sent or received. Contains
- * the message payload itself, the message header, the extension data, and the
- * opcode.
- *
- * # connection_message_manager:
- * An object that manages all of the message_buffers associated with a given
- * connection. Impliments the get_message_buffer(size) method that returns
- * a message buffer at least size bytes long.
- *
- * Message buffers are reference counted with shared ownership semantics. Once
- * requested from the manager the requester and it's associated downstream code
- * may keep a pointer to the message indefinitely at a cost of extra resource
- * usage. Once the reference count drops to the point where the manager is the
- * only reference the messages is recycled using whatever method is implemented
- * in the manager.
- *
- * # endpoint_message_manager:
- * An object that manages connection_message_managers. Impliments the
- * get_message_manager() method. This is used once by each connection to
- * request the message manager that they are supposed to use to manage message
- * buffers for their own use.
- *
- * TYPES OF CONNECTION_MESSAGE_MANAGERS
- * - allocate a message with the exact size every time one is requested
- * - maintain a pool of pre-allocated messages and return one when needed.
- *   Recycle previously used messages back into the pool
- *
- * TYPES OF ENDPOINT_MESSAGE_MANAGERS
- *  - allocate a new connection manager for each connection. Message pools
- *    become connection specific. This increases memory usage but improves
- *    concurrency.
- *  - allocate a single connection manager and share a pointer to it with all
- *    connections created by this endpoint. The message pool will be shared
- *    among all connections, improving memory usage and performance at the cost
- *    of reduced concurrency
- */
-
 /// Custom deleter for use in shared_ptrs to message.
 /**
  * This is used to catch messages about to be deleted and offer the manager the
@@ -92,133 +58,330 @@ void message_deleter(T* msg) {
     }
 }
 
-/// Represents a buffer for a single WebSocket message.
+namespace pool {
+
+/// Number of payload size classes maintained by a pool
+static size_t const num_size_classes = 5;
+
+/// Returns the payload capacity of the given size class
+/**
+ * Size classes are 256, 1024, 4096, 16384, and 65536 bytes.
+ *
+ * @param c The size class, must be less than num_size_classes
+ * @return The minimum payload capacity of messages in that class
+ */
+inline size_t get_class_size(size_t c) {
+    return size_t(256) << (2*c);
+}
+
+/// Counters describing the effectiveness of a message pool
+struct stats {
+    stats() : hits(0), misses(0), recycled(0), discarded(0) {}
+
+    /// Requests fulfilled from the cache
+    size_t hits;
+    /// Requests that required a new allocation
+    size_t misses;
+    /// Messages returned to the cache after use
+    size_t recycled;
+    /// Messages freed after use because the cache was full or they were too
+    /// large to pool
+    size_t discarded;
+};
+
+/// A connection messages manager that maintains a pool of messages that is
+/// used to fulfill get_message requests.
 /**
+ * Released messages are caught by a custom shared_ptr deleter and, if there
+ * is room, stored in a free list according to their payload capacity. A
+ * request for a message is served from the smallest size class that can hold
+ * the requested number of bytes. Payloads larger than the largest size class
+ * are allocated exactly and never pooled.
  *
+ * The total payload capacity held in the free lists is bounded by
+ * max_cached_bytes. Access is internally synchronized because messages may be
+ * released from any thread.
  *
+ * Note that the shared_ptr control block is still allocated for every
+ * message handed out.
  */
-template <typename con_msg_manager>
-class message {
+template <typename message>
+class con_msg_manager
+  : public lib::enable_shared_from_this<con_msg_manager<message> >
+{
 public:
-    typedef lib::shared_ptr<message> ptr;
+    typedef con_msg_manager<message> type;
+    typedef lib::shared_ptr<con_msg_manager> ptr;
+    typedef lib::weak_ptr<con_msg_manager> weak_ptr;
 
-    typedef typename con_msg_manager::weak_ptr con_msg_man_ptr;
+    typedef typename message::ptr message_ptr;
 
-    message(con_msg_man_ptr manager, size_t size = 128)
-      : m_manager(manager)
-      , m_payload(size) {}
+    /// Default bound on cached payload bytes per manager
+    static size_t const default_max_cached_bytes = 262144;
 
-    frame::opcode::value get_opcode() const {
-        return m_opcode;
-    }
-    const std::string& get_header() const {
-        return m_header;
-    }
-    const std::string& get_extension_data() const {
-        return m_extension_data;
-    }
-    const std::string& get_payload() const {
-        return m_payload;
-    }
-
-    /// Recycle the message
+    /// Construct a message pool
     /**
-     * A request to recycle this message was received. Forward that request to
-     * the connection message manager for processing. Errors and exceptions
-     * from the manager's recycle member function should be passed back up the
-     * call chain. The caller to message::recycle will deal with them.
-     *
-     * Recycle must *only* be called by the message shared_ptr's destructor.
-     * Once recycled successfully, ownership of the memory has been passed to
-     * another system and must not be accessed again.
-     *
-     * @return true if the message was successfully recycled, false otherwise.
+     * @param max_cached_bytes The maximum total payload capacity to keep in
+     * the free lists.
      */
-    bool recycle() {
-        typename con_msg_manager::ptr shared = m_manager.lock();
+    explicit con_msg_manager(size_t max_cached_bytes = default_max_cached_bytes)
+      : m_max_cached_bytes(max_cached_bytes)
+      , m_cached_bytes(0) {}
 
-        if (shared) {
-            return shared->(recycle(this));
-        } else {
-            return false;
+    ~con_msg_manager() {
+        for (size_t c = 0; c < num_size_classes; c++) {
+            for (size_t i = 0; i < m_free[c].size(); i++) {
+                delete m_free[c][i];
+            }
         }
     }
-private:
-    con_msg_man_ptr             m_manager;
-
-    frame::opcode::value        m_opcode;
-    std::string                 m_header;
-    std::string                 m_extension_data;
-    std::string                 m_payload;
-};
-
-namespace alloc {
 
-/// A connection message manager that allocates a new message for each
-/// request.
-template <typename message>
-class con_msg_manager {
-public:
-    typedef lib::shared_ptr<con_msg_manager> ptr;
-    typedef lib::weak_ptr<con_msg_manager> weak_ptr;
-
-    typedef typename message::ptr message_ptr;
+    /// Get an empty message buffer
+    /**
+     * @return A shared pointer to an empty message
+     */
+    message_ptr get_message() {
+        return get_message(frame::opcode::text,0);
+    }
 
-    /// Get a message buffer with specified size
+    /// Get a message buffer with specified size and opcode
     /**
+     * @param op The opcode to use
      * @param size Minimum size in bytes to request for the message payload.
      *
-     * @return A shared pointer to a new message with specified size.
+     * @return A shared pointer to a message with at least the specified
+     * capacity.
      */
-    message_ptr get_message(size_t size) const {
-        return message_ptr(new message(size));
+    message_ptr get_message(frame::opcode::value op, size_t size) {
+        size_t c = class_for_request(size);
+
+        if (c < num_size_classes) {
+            message * msg = NULL;
+            {
+                lib::lock_guard<lib::mutex> lock(m_lock);
+                if (!m_free[c].empty()) {
+                    msg = m_free[c].back();
+                    m_free[c].pop_back();
+                    m_cached_bytes -= msg->get_raw_payload().capacity();
+                    m_stats.hits++;
+                } else {
+                    m_stats.misses++;
+                }
+            }
+
+            if (msg) {
+                msg->set_opcode(op);
+                return message_ptr(msg,&message_deleter<message>);
+            }
+
+            // allocate the full class size so the message can be reused for
+            // any request that maps to this class.
+            size = get_class_size(c);
+        } else {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            m_stats.misses++;
+        }
+
+        return message_ptr(new message(type::shared_from_this(),op,size),
+            &message_deleter<message>);
     }
 
     /// Recycle a message
     /**
-     * This method shouldn't be called. If it is, return false to indicate an
-     * error. The rest of the method recycle chain should notice this and free
-     * the memory.
+     * Resets the message and stores it in the free list for its size class if
+     * there is room. Called by message::recycle from the message deleter.
      *
      * @param msg The message to be recycled.
      *
      * @return true if the message was successfully recycled, false otherwse.
      */
     bool recycle(message * msg) {
-        return false;
+        std::string & payload = msg->get_raw_payload();
+        size_t capacity = payload.capacity();
+        size_t c = class_for_capacity(capacity);
+
+        lib::lock_guard<lib::mutex> lock(m_lock);
+
+        if (c >= num_size_classes ||
+            m_cached_bytes + capacity > m_max_cached_bytes)
+        {
+            m_stats.discarded++;
+            return false;
+        }
+
+        payload.clear();
+        msg->set_header(std::string());
+        msg->set_prepared(false);
+        msg->set_fin(true);
+        msg->set_terminal(false);
+        msg->set_priority(priority::normal);
+        msg->set_conflation_key(std::string());
+        msg->set_deadline(0);
+        msg->set_compressed(false);
+
+        m_free[c].push_back(msg);
+        m_cached_bytes += capacity;
+        m_stats.recycled++;
+
+        return true;
+    }
+
+    /// Get the hit/miss counters for this pool
+    stats get_stats() const {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return m_stats;
+    }
+
+    /// Get the number of messages currently held in the free lists
+    size_t get_cached_count() const {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        size_t count = 0;
+        for (size_t c = 0; c < num_size_classes; c++) {
+            count += m_free[c].size();
+        }
+        return count;
+    }
+private:
+    /// Smallest class whose messages can hold size bytes
+    static size_t class_for_request(size_t size) {
+        size_t c = 0;
+        while (c < num_size_classes && get_class_size(c) < size) {
+            c++;
+        }
+        return c;
     }
+
+    /// Largest class whose minimum capacity is at most capacity
+    static size_t class_for_capacity(size_t capacity) {
+        if (capacity < get_class_size(0)) {
+            return 0;
+        }
+        size_t c = 0;
+        while (c+1 < num_size_classes && get_class_size(c+1) <= capacity) {
+            c++;
+        }
+        // too large to pool
+        if (capacity >= 2*get_class_size(num_size_classes-1)) {
+            return num_size_classes;
+        }
+        return c;
+    }
+
+    size_t const                m_max_cached_bytes;
+    size_t                      m_cached_bytes;
+    std::vector<message *>      m_free[num_size_classes];
+    stats                       m_stats;
+    mutable lib::mutex          m_lock;
 };
 
-/// An endpoint message manager that allocates a new manager for each
-/// connection.
+/// An endpoint manager that maintains a shared pool of connection managers
+/// and returns an appropriate one for the requesting connection.
+/**
+ * Connection managers handed out by get_manager are returned to a bounded
+ * idle list when their connection releases them. New connections reuse idle
+ * managers, and the messages already cached in them, before a new manager is
+ * constructed. This keeps message pools warm across connection churn.
+ */
 template <typename con_msg_manager>
 class endpoint_msg_manager {
 public:
     typedef typename con_msg_manager::ptr con_msg_man_ptr;
 
+    /// Default bound on idle connection managers
+    static size_t const default_max_idle = 64;
+
+    /// Counters describing connection manager reuse
+    struct manager_stats {
+        manager_stats() : created(0), reused(0) {}
+
+        /// Connection managers constructed
+        size_t created;
+        /// Connection managers served from the idle list
+        size_t reused;
+    };
+
+    /// Construct an endpoint manager
+    /**
+     * @param max_idle The maximum number of idle connection managers to keep.
+     * @param max_cached_bytes Bound on cached payload bytes for each
+     * connection manager created.
+     */
+    explicit endpoint_msg_manager(size_t max_idle = default_max_idle,
+        size_t max_cached_bytes = con_msg_manager::default_max_cached_bytes)
+      : m_state(new state(max_idle,max_cached_bytes)) {}
+
     /// Get a pointer to a connection message manager
     /**
      * @return A pointer to the requested connection message manager.
      */
     con_msg_man_ptr get_manager() const {
-        return con_msg_man_ptr(new con_msg_manager());
+        con_msg_man_ptr real;
+        {
+            lib::lock_guard<lib::mutex> lock(m_state->lock);
+            if (!m_state->idle.empty()) {
+                real = m_state->idle.back();
+                m_state->idle.pop_back();
+                m_state->stats.reused++;
+            } else {
+                m_state->stats.created++;
+            }
+        }
+
+        if (!real) {
+            real.reset(new con_msg_manager(m_state->max_cached_bytes));
+        }
+
+        // The returned pointer has its own reference count. When it is
+        // released the real manager goes back to the idle list. Messages keep
+        // referring to the real manager so they recycle normally throughout.
+        return con_msg_man_ptr(real.get(),releaser(real,m_state));
     }
-};
 
-} // namespace alloc
+    /// Get the number of idle connection managers
+    size_t get_idle_count() const {
+        lib::lock_guard<lib::mutex> lock(m_state->lock);
+        return m_state->idle.size();
+    }
 
-namespace pool {
+    /// Get the connection manager reuse counters
+    manager_stats get_stats() const {
+        lib::lock_guard<lib::mutex> lock(m_state->lock);
+        return m_state->stats;
+    }
+private:
+    struct state {
+        state(size_t i, size_t b) : max_idle(i), max_cached_bytes(b) {}
 
-/// A connection messages manager that maintains a pool of messages that is
-/// used to fulfill get_message requests.
-class con_msg_manager {
+        size_t const                    max_idle;
+        size_t const                    max_cached_bytes;
+        std::vector<con_msg_man_ptr>    idle;
+        manager_stats                   stats;
+        lib::mutex                      lock;
+    };
 
-};
+    typedef lib::shared_ptr<state> state_ptr;
+    typedef lib::weak_ptr<state> state_weak_ptr;
 
-/// An endpoint manager that maintains a shared pool of connection managers
-/// and returns an appropriate one for the requesting connection.
-class endpoint_msg_manager {
+    /// Deleter that returns a connection manager to the idle list
+    struct releaser {
+        releaser(con_msg_man_ptr r, state_weak_ptr s) : real(r), st(s) {}
+
+        void operator()(con_msg_manager *) {
+            state_ptr s = st.lock();
+            if (s) {
+                lib::lock_guard<lib::mutex> lock(s->lock);
+                if (s->idle.size() < s->max_idle) {
+                    s->idle.push_back(real);
+                }
+            }
+            real.reset();
+        }
+
+        con_msg_man_ptr real;
+        state_weak_ptr st;
+    };
 
+    state_ptr m_state;
 };
 
 } // namespace pool
@@ -226,4 +389,4 @@ class endpoint_msg_manager {
 } // namespace message_buffer
 } // namespace websocketpp
 
-#endif // WEBSOCKETPP_MESSAGE_BUFFER_ALLOC_HPP
+#endif // WEBSOCKETPP_MESSAGE_BUFFER_POOL_HPP
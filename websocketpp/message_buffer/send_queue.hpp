@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_MESSAGE_BUFFER_SEND_QUEUE_HPP
+#define WEBSOCKETPP_MESSAGE_BUFFER_SEND_QUEUE_HPP
+
+#include <websocketpp/frame.hpp>
+#include <websocketpp/message_buffer/message.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <string>
+
+namespace websocketpp {
+namespace message_buffer {
+
+/// Lanes of the outgoing send queue, in the order they are drained
+namespace lane {
+enum value {
+    /// Ping and pong frames
+    control = 0,
+    /// Data messages with priority::high
+    high = 1,
+    /// Data messages with priority::normal
+    normal = 2,
+    /// Data messages with priority::low
+    low = 3,
+    /// Close frames, written after all queued data
+    close = 4
+};
+
+/// Number of lanes in a send_queue
+static size_t const count = 5;
+} // namespace lane
+
+/// Outgoing message queue with one FIFO lane per priority
+/**
+ * Messages are pushed into the lane for their opcode and priority and popped
+ * from the highest lane that has a message available, so a pong doesn't wait
+ * behind queued bulk data. Close frames use the last lane so that a close
+ * still goes out after the data queued before it.
+ *
+ * Prepared messages flagged compressed were deflated against the
+ * connection's shared compression context, so the peer can only inflate them
+ * in the order they were prepared. They all share the normal lane whatever
+ * their priority.
+ *
+ * Frames of a fragmented message must not be interleaved with other data
+ * messages. Once the first frame of a fragmented message has been popped only
+ * the control and close lanes and the lane of that message are eligible until
+ * its final frame is popped.
+ *
+ * Whole messages with a conflation key replace the queued message with the
+ * same key in their lane, keeping its place in the queue. Compressed messages
+ * are never conflated, later frames may refer back to their deflate output.
+ *
+ * Not thread safe, connections guard it with their write lock.
+ */
+template <typename message_ptr>
+class send_queue {
+public:
+    send_queue() : m_size(0), m_fragment_lane(lane::count) {}
+
+    /// Get the lane a message is queued in
+    static lane::value lane_for(message_ptr const & msg) {
+        frame::opcode::value op = msg->get_opcode();
+
+        if (op == frame::opcode::CLOSE) {
+            return lane::close;
+        } else if (frame::opcode::is_control(op)) {
+            return lane::control;
+        }
+
+        // compressed frames must stay in the order they were deflated
+        if (msg->get_compressed()) {
+            return lane::normal;
+        }
+
+        switch (msg->get_priority()) {
+            case priority::high:
+                return lane::high;
+            case priority::low:
+                return lane::low;
+            default:
+                return lane::normal;
+        }
+    }
+
+    /// Add a message to the back of its lane
+    /**
+     * If the message is conflated and a message with the same key is still
+     * queued in its lane, that message is replaced instead.
+     *
+     * @param msg The message to queue
+     * @return The message that was replaced, or an empty pointer
+     */
+    message_ptr push(message_ptr const & msg) {
+        size_t l = lane_for(msg);
+
+        if (conflatable(msg)) {
+            message_ptr *& slot = m_keys[l][msg->get_conflation_key()];
+            if (slot) {
+                message_ptr replaced = *slot;
+                *slot = msg;
+                return replaced;
+            }
+            // references to deque elements survive pushes and pops at the ends
+            m_lanes[l].push_back(msg);
+            slot = &m_lanes[l].back();
+        } else {
+            m_lanes[l].push_back(msg);
+        }
+
+        m_size++;
+        return message_ptr();
+    }
+
+    /// Whether any lane holds a message that may be written now
+    /**
+     * This can be false while the queue isn't empty if the next frame of a
+     * partially written fragmented message hasn't been queued yet.
+     */
+    bool ready() const {
+        return next_lane() < lane::count;
+    }
+
+    /// The next message to write. Only valid if ready() is true.
+    message_ptr const & front() const {
+        return m_lanes[next_lane()].front();
+    }
+
+    /// Remove the message returned by front()
+    void pop() {
+        size_t l = next_lane();
+        message_ptr const & msg = m_lanes[l].front();
+
+        if (l != lane::control && l != lane::close) {
+            m_fragment_lane = msg->get_fin() ? lane::count : l;
+        }
+
+        if (conflatable(msg)) {
+            m_keys[l].erase(msg->get_conflation_key());
+        }
+
+        m_lanes[l].pop_front();
+        m_size--;
+    }
+
+    /// Whether all lanes are empty
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    /// Total number of queued messages
+    size_t size() const {
+        return m_size;
+    }
+
+    /// Number of messages queued in one lane
+    size_t size(lane::value l) const {
+        return m_lanes[l].size();
+    }
+private:
+    static bool conflatable(message_ptr const & msg) {
+        frame::opcode::value op = msg->get_opcode();
+        return !msg->get_conflation_key().empty() && msg->get_fin() &&
+            !msg->get_compressed() &&
+            (op == frame::opcode::TEXT || op == frame::opcode::BINARY);
+    }
+
+    size_t next_lane() const {
+        for (size_t l = 0; l < lane::count; l++) {
+            if (m_lanes[l].empty()) {
+                continue;
+            }
+            if (m_fragment_lane < lane::count && l != m_fragment_lane &&
+                l != lane::control && l != lane::close)
+            {
+                continue;
+            }
+            return l;
+        }
+        return lane::count;
+    }
+
+    typedef std::map<std::string,message_ptr *> key_map;
+
+    std::deque<message_ptr> m_lanes[lane::count];
+    // Queue slot of the conflated message waiting for each key
+    key_map m_keys[lane::count];
+    size_t m_size;
+    size_t m_fragment_lane;
+};
+
+} // namespace message_buffer
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_MESSAGE_BUFFER_SEND_QUEUE_HPP
@@ -241,6 +241,15 @@ public:
 
                 // Copy payload bytes into message
                 l = static_cast<size_t>(it-(buf+p));
+
+                if (base::m_max_message_size > 0 && l >
+                    base::m_max_message_size - m_msg_ptr->get_payload().size())
+                {
+                    ec = make_error_code(error::message_too_big);
+                    m_state = FATAL_ERROR;
+                    break;
+                }
+
                 m_msg_ptr->append_payload(buf+p,l);
                 p += l;
 
@@ -270,6 +279,10 @@ public:
         return (m_state == READY);
     }
 
+    bool idle() const {
+        return (m_state == HEADER);
+    }
+
     bool get_error() const {
         return false;
     }
@@ -281,6 +294,23 @@ public:
         return ret;
     }
 
+    /// Get a key describing how this processor would frame a data message
+    /**
+     * Hybi00 frames are never masked or compressed, so any prepared frame can
+     * be shared with other hybi00 connections.
+     */
+    int get_shared_frame_key(message_ptr in) const {
+        return this->get_version();
+    }
+
+    /// Returns whether framing a data message changes processor state
+    /**
+     * Hybi00 framing is a pure function of the payload.
+     */
+    bool prepare_is_stateful(message_ptr in) const {
+        return false;
+    }
+
     /// Prepare a message for writing
     /**
      * Performs validation, masking, compression, etc. will return an error if
@@ -299,6 +329,11 @@ public:
             return make_error_code(error::invalid_opcode);
         }
 
+        // there are no fragmented messages in hybi00
+        if (!in->get_fin()) {
+            return make_error_code(error::no_protocol_support);
+        }
+
         std::string& i = in->get_raw_payload();
         //std::string& o = out->get_raw_payload();
 
@@ -317,6 +352,10 @@ public:
         // hybi00 doesn't support compression
         // hybi00 doesn't have masking
 
+        out->set_opcode(frame::opcode::text);
+        out->set_priority(in->get_priority());
+        out->set_conflation_key(in->get_conflation_key());
+        out->set_deadline(in->get_deadline());
         out->set_prepared(true);
 
         return lib::error_code();
@@ -343,6 +382,7 @@ public:
         val.append(1,'\xff');
         val.append(1,'\x00');
         out->set_payload(val);
+        out->set_opcode(frame::opcode::close);
         out->set_prepared(true);
 
         return lib::error_code();
@@ -40,6 +40,7 @@
 #include <websocketpp/sha1/sha1.hpp>
 #include <websocketpp/base64/base64.hpp>
 
+#include <cstring>
 #include <string>
 #include <vector>
 #include <utility>
@@ -58,6 +59,8 @@ public:
 
     typedef typename config::message_type message_type;
     typedef typename message_type::ptr message_ptr;
+    typedef typename base::message_view message_view;
+    typedef typename base::message_chunk message_chunk;
 
     typedef typename config::con_msg_manager_type msg_manager_type;
     typedef typename msg_manager_type::ptr msg_manager_ptr;
@@ -74,6 +77,13 @@ public:
       : processor<config>(secure,server)
       , m_msg_manager(manager)
       , m_rng(rng)
+      , m_zero_copy(false)
+      , m_view_ready(false)
+      , m_streaming(false)
+      , m_chunk_ready(false)
+      , m_chunk_resume(HEADER_BASIC)
+      , m_stream_sequence(0)
+      , m_stream_offset(0)
       , m_mobile_signaling(rng)
     {
         reset_headers();
@@ -452,6 +462,13 @@ public:
                (p < len || m_bytes_needed == 0))
         {
             if (m_state == HEADER_BASIC) {
+                size_t header_len = this->decode_header_in_place(buf+p,len-p,ec);
+                if (header_len > 0) {
+                    p += header_len;
+                    if (ec) {break;}
+                    continue;
+                }
+
                 p += this->copy_basic_header_bytes(buf+p,len-p);
 
                 if (m_bytes_needed > 0) {
@@ -478,18 +495,39 @@ public:
                 ec = validate_incoming_extended_header(m_basic_header,m_extended_header);
                 if (ec){break;}
 
-                m_state = APPLICATION;
-                m_bytes_needed = static_cast<size_t>(get_payload_size(m_basic_header,m_extended_header));
-
                 // check if this frame is the start of a new message and set up
                 // the appropriate message metadata.
                 frame::opcode::value op = frame::get_opcode(m_basic_header);
 
+                uint64_t payload_size = get_payload_size(m_basic_header,
+                    m_extended_header);
+
+                // refuse oversized messages before any payload is buffered
+                if (!frame::opcode::is_control(op)) {
+                    ec = this->check_message_size(payload_size);
+                    if (ec) {break;}
+                }
+
+                m_state = APPLICATION;
+                m_bytes_needed = static_cast<size_t>(payload_size);
+
+                // A whole message already in the buffer can be handed out in
+                // place without allocating or copying.
+                if (m_zero_copy && !m_streaming && m_bytes_needed <= len-p &&
+                    !frame::opcode::is_control(op) && !m_data_msg.msg_ptr &&
+                    frame::get_fin(m_basic_header) &&
+                    !m_permessage_deflate.is_enabled())
+                {
+                    p += this->process_payload_view(buf+p,ec);
+                    if (ec) {break;}
+                    continue;
+                }
+
                 // TODO: get_message failure conditions
 
                 if (frame::opcode::is_control(op)) {
                     m_control_msg = msg_metadata(
-                        m_msg_manager->get_message(op,m_bytes_needed),
+                        this->get_control_message(op),
                         frame::get_masking_key(m_basic_header,m_extended_header)
                     );
 
@@ -497,7 +535,8 @@ public:
                 } else {
                     if (!m_data_msg.msg_ptr) {
                         m_data_msg = msg_metadata(
-                            m_msg_manager->get_message(op,m_bytes_needed),
+                            m_streaming ? this->get_stream_message(op) :
+                                m_msg_manager->get_message(op,m_bytes_needed),
                             frame::get_masking_key(m_basic_header,m_extended_header)
                         );
                     } else {
@@ -517,6 +556,12 @@ public:
                 m_state = APPLICATION;
             } else if (m_state == APPLICATION) {
                 size_t bytes_to_process = std::min(m_bytes_needed,len-p);
+                bool streaming = m_streaming && m_current_msg == &m_data_msg;
+
+                if (streaming) {
+                    // the previous chunk has been handed out already
+                    m_data_msg.msg_ptr->get_raw_payload().clear();
+                }
 
                 if (bytes_to_process > 0) {
                     p += this->process_payload_bytes(buf+p,bytes_to_process,ec);
@@ -525,6 +570,9 @@ public:
                 }
 
                 if (m_bytes_needed > 0) {
+                    if (streaming) {
+                        this->ready_chunk(false);
+                    }
                     continue;
                 }
 
@@ -535,8 +583,14 @@ public:
                     if (ec) {
                         break;
                     }
+                    if (streaming) {
+                        this->ready_chunk(true);
+                    }
                 } else {
                     this->reset_headers();
+                    if (streaming) {
+                        this->ready_chunk(false);
+                    }
                 }
             } else {
                 // shouldn't be here
@@ -596,10 +650,28 @@ public:
         return (m_state == READY);
     }
 
+    /// Test whether or not the processor is between messages
+    bool idle() const {
+        return m_state == HEADER_BASIC &&
+            m_bytes_needed == frame::BASIC_HEADER_LENGTH &&
+            !m_data_msg.msg_ptr;
+    }
+
     message_ptr get_message() {
         if (!ready()) {
             return message_ptr();
         }
+
+        if (m_view_ready) {
+            // caller doesn't know about views, materialize a real message
+            message_ptr ret = m_msg_manager->get_message(m_view.opcode,
+                m_view.length);
+            ret->get_raw_payload().assign(m_view.payload,m_view.length);
+            m_view_ready = false;
+            this->reset_headers();
+            return ret;
+        }
+
         message_ptr ret = m_current_msg->msg_ptr;
         m_current_msg->msg_ptr.reset();
 
@@ -614,6 +686,46 @@ public:
         return ret;
     }
 
+    void set_zero_copy(bool value) {
+        m_zero_copy = value;
+    }
+
+    bool get_message_view(message_view & view) {
+        if (!ready() || !m_view_ready) {
+            return false;
+        }
+
+        view = m_view;
+        m_view_ready = false;
+        this->reset_headers();
+
+        return true;
+    }
+
+    void set_streaming(bool value) {
+        m_streaming = value;
+    }
+
+    bool get_message_chunk(message_chunk & chunk) {
+        if (!ready() || !m_chunk_ready) {
+            return false;
+        }
+
+        chunk = m_chunk;
+        m_chunk_ready = false;
+
+        if (chunk.fin) {
+            // m_stream_msg keeps the payload alive until the next consume
+            m_data_msg.msg_ptr.reset();
+            m_stream_sequence++;
+            this->reset_headers();
+        } else {
+            m_state = m_chunk_resume;
+        }
+
+        return true;
+    }
+
     /// Test whether or not the processor is in a fatal error state.
     bool get_error() const {
         return m_state == FATAL_ERROR;
@@ -623,6 +735,30 @@ public:
         return m_bytes_needed;
     }
 
+    /// Get a key describing how this processor would frame a data message
+    /**
+     * Unmasked frames that don't use the connection's compression context are
+     * a function of the message alone and can be shared between connections
+     * speaking the same protocol version.
+     */
+    int get_shared_frame_key(message_ptr in) const {
+        if (!base::m_server) {
+            return -1;
+        }
+        if (m_permessage_deflate.is_enabled() && in->get_compressed()) {
+            return -1;
+        }
+        return this->get_version();
+    }
+
+    /// Returns whether framing a data message changes processor state
+    /**
+     * Only compression is stateful. The masking key RNG does its own locking.
+     */
+    bool prepare_is_stateful(message_ptr in) const {
+        return m_permessage_deflate.is_enabled() && in->get_compressed();
+    }
+
     /// Prepare a user data message for writing
     /**
      * Performs validation, masking, compression, etc. will return an error if
@@ -663,11 +799,6 @@ public:
         std::string& i = in->get_raw_payload();
         std::string& o = out->get_raw_payload();
 
-        // validate payload utf8
-        if (op == frame::opcode::TEXT && !utf8_validator::validate(i)) {
-            return make_error_code(error::invalid_payload);
-        }
-
         frame::masking_key_type key;
         bool masked = !base::m_server;
         bool compressed = m_permessage_deflate.is_enabled()
@@ -675,6 +806,18 @@ public:
                           
         bool fin = in->get_fin();
 
+        // validate payload utf8. The first frame of a fragmented message may
+        // end in the middle of a sequence, continuation frames are validated
+        // by whoever assembles the stream.
+        if (op == frame::opcode::TEXT) {
+            utf8_validator::validator v;
+            if (!v.decode(reinterpret_cast<uint8_t const *>(i.data()),i.size())
+                || (fin && !v.complete()))
+            {
+                return make_error_code(error::invalid_payload);
+            }
+        }
+
         if (masked) {
             // Generate masking key.
             key.i = m_rng();
@@ -724,6 +867,14 @@ public:
             out->set_header(frame::prepare_header(h,e));
         }
 
+        // the send queue picks lanes based on these. A compressed frame
+        // depends on the deflate context as of the frames before it.
+        out->set_opcode(op);
+        out->set_fin(fin);
+        out->set_compressed(compressed);
+        out->set_priority(in->get_priority());
+        out->set_conflation_key(in->get_conflation_key());
+        out->set_deadline(in->get_deadline());
         out->set_prepared(true);
 
         return lib::error_code();
@@ -785,6 +936,57 @@ protected:
         return lib::error_code();
     }
 
+    /// Decodes a frame header that is entirely contained in the input
+    /**
+     * Fast path for the common case of a header that doesn't straddle reads.
+     * The basic header is validated and the extended header copied with a
+     * single fixed width copy (exact width if fewer than
+     * frame::MAX_HEADER_LENGTH bytes are available) instead of stepping
+     * through the resumable header states. Leaves the processor in the
+     * HEADER_EXTENDED state with no bytes needed.
+     *
+     * @param buf Input buffer positioned at the start of a header
+     * @param len Length of buf
+     * @param ec Set if the basic header is invalid
+     * @return Number of bytes consumed, or zero if the header is incomplete or
+     * partially read already and the state machine must be used instead
+     */
+    size_t decode_header_in_place(uint8_t const * buf, size_t len,
+        lib::error_code & ec)
+    {
+        if (m_bytes_needed != frame::BASIC_HEADER_LENGTH ||
+            len < frame::BASIC_HEADER_LENGTH)
+        {
+            return 0;
+        }
+
+        frame::basic_header h(buf[0],buf[1]);
+        size_t header_len = frame::get_header_len(h);
+        if (len < header_len) {
+            return 0;
+        }
+
+        m_basic_header = h;
+        ec = this->validate_incoming_basic_header(
+            m_basic_header, base::m_server, !m_data_msg.msg_ptr
+        );
+        if (ec) {
+            return frame::BASIC_HEADER_LENGTH;
+        }
+
+        // bytes past the header are ignored by the extended header accessors
+        size_t extended_len = header_len - frame::BASIC_HEADER_LENGTH;
+        std::memcpy(m_extended_header.bytes,buf+frame::BASIC_HEADER_LENGTH,
+            len >= frame::MAX_HEADER_LENGTH ?
+            frame::MAX_EXTENDED_HEADER_LENGTH : extended_len);
+
+        m_state = HEADER_EXTENDED;
+        m_cursor = extended_len;
+        m_bytes_needed = 0;
+
+        return header_len;
+    }
+
     /// Reads bytes from buf into m_basic_header
     size_t copy_basic_header_bytes(uint8_t const * buf, size_t len) {
         if (len == 0 || m_bytes_needed == 0) {
@@ -844,6 +1046,21 @@ protected:
     // TODO: add tests
     size_t process_payload_bytes(uint8_t * buf, size_t len, lib::error_code& ec)
     {
+        bool compressed = m_permessage_deflate.is_enabled() &&
+            frame::get_rsv1(m_basic_header);
+
+        // masked, uncompressed text takes a single fused pass
+        if (frame::get_masked(m_basic_header) && !compressed &&
+            m_current_msg->msg_ptr->get_opcode() == frame::opcode::TEXT)
+        {
+            if (!unmask_validate_append(buf,len)) {
+                ec = make_error_code(error::invalid_utf8);
+                return 0;
+            }
+            m_bytes_needed -= len;
+            return len;
+        }
+
         // unmask if masked
         if (frame::get_masked(m_basic_header)) {
             #ifdef WEBSOCKETPP_STRICT_MASKING
@@ -872,6 +1089,14 @@ protected:
             // Error processing message
             if (ec)
                 return 0;
+
+            // decompression may expand the payload past the limit
+            if (base::m_max_message_size > 0 &&
+                out.size() > base::m_max_message_size)
+            {
+                ec = make_error_code(error::message_too_big);
+                return 0;
+            }
         } else {
             // No compression, straight copy
             out.append(reinterpret_cast<char *>(buf),len);
@@ -879,8 +1104,10 @@ protected:
 
         // validate unmasked, decompressed values
         if (m_current_msg->msg_ptr->get_opcode() == frame::opcode::TEXT) {
-            // TODO: validator decodes the first offset bytes, not the last?
-            if (!m_current_msg->validator.decode(out.begin()+offset,out.end())) {
+            if (!m_current_msg->validator.decode(
+                reinterpret_cast<uint8_t const *>(out.data())+offset,
+                out.size()-offset))
+            {
                 ec = make_error_code(error::invalid_utf8);
                 return 0;
             }
@@ -891,6 +1118,182 @@ protected:
         return len;
     }
 
+    /// Checks a data frame's payload length against the maximum message size
+    /**
+     * The length is added to the bytes already assembled for the message the
+     * frame continues. Streamed messages are not assembled and not limited.
+     *
+     * @param payload_size Announced payload length of the frame
+     * @return message_too_big if the message would exceed the limit
+     */
+    lib::error_code check_message_size(uint64_t payload_size) const {
+        if (base::m_max_message_size == 0 || m_streaming) {
+            return lib::error_code();
+        }
+
+        uint64_t current = 0;
+        if (m_data_msg.msg_ptr) {
+            current = m_data_msg.msg_ptr->get_payload().size();
+        }
+
+        if (payload_size > base::m_max_message_size - current) {
+            return make_error_code(error::message_too_big);
+        }
+        return lib::error_code();
+    }
+
+    /// Returns the reusable control message, reset for a new frame
+    /**
+     * Control payloads are capped at frame::limits::payload_size_basic, so one
+     * message sized for that is reused for every control frame once the
+     * previous one has been released by whoever it was handed to. If it is
+     * still referenced elsewhere a new message replaces it.
+     */
+    message_ptr get_control_message(frame::opcode::value op) {
+        if (!m_control_buffer || m_control_buffer.use_count() != 1) {
+            m_control_buffer = m_msg_manager->get_message(op,
+                frame::limits::payload_size_basic);
+            return m_control_buffer;
+        }
+        m_control_buffer->set_opcode(op);
+        m_control_buffer->get_raw_payload().clear();
+        return m_control_buffer;
+    }
+
+    /// Returns the message object that holds streamed payload chunks
+    /**
+     * A single message object is reused for every streamed message, its
+     * payload only ever holds the bytes decoded from one read.
+     *
+     * @param op The opcode of the new message
+     * @return The emptied stream message
+     */
+    message_ptr get_stream_message(frame::opcode::value op) {
+        if (!m_stream_msg) {
+            m_stream_msg = m_msg_manager->get_message(op,0);
+        }
+        m_stream_msg->set_opcode(op);
+        m_stream_msg->get_raw_payload().clear();
+        m_stream_offset = 0;
+        return m_stream_msg;
+    }
+
+    /// Hands the bytes decoded from the current read out as a chunk
+    /**
+     * Puts the processor in the ready state until the chunk is retrieved with
+     * get_message_chunk. Empty chunks are only produced to finish a message.
+     *
+     * @param fin Whether or not the chunk completes the message
+     */
+    void ready_chunk(bool fin) {
+        std::string const & out = m_data_msg.msg_ptr->get_raw_payload();
+        if (out.empty() && !fin) {
+            return;
+        }
+
+        m_chunk.opcode = m_data_msg.msg_ptr->get_opcode();
+        m_chunk.payload = out.data();
+        m_chunk.length = out.size();
+        m_chunk.fin = fin;
+        m_chunk.sequence = m_stream_sequence;
+        m_chunk.offset = m_stream_offset;
+        m_stream_offset += out.size();
+
+        m_chunk_resume = m_state;
+        m_state = READY;
+        m_chunk_ready = true;
+    }
+
+    /// Unmasks, validates and appends masked text payload bytes
+    /**
+     * Fused form of the unmask, append and validate steps of
+     * process_payload_bytes for uncompressed text. Each block is unmasked
+     * straight from buf into the message buffer and validated while it is
+     * still in L1 cache, so the payload is read from buf once and written to
+     * the message once, with no separate copy pass.
+     *
+     * @param buf Masked input bytes
+     * @param len Length of buf
+     * @return Whether or not the bytes were valid UTF8
+     */
+    bool unmask_validate_append(uint8_t * buf, size_t len) {
+        std::string & out = m_current_msg->msg_ptr->get_raw_payload();
+        size_t offset = out.size();
+
+        // grow once, each block is then sized just before it is written
+        out.reserve(offset + len);
+
+        for (size_t i = 0; i < len; i += fused_block_size) {
+            size_t n = (len - i < fused_block_size ? len - i : fused_block_size);
+
+            out.resize(offset + i + n);
+            uint8_t * block = reinterpret_cast<uint8_t *>(&out[offset+i]);
+
+            #ifdef WEBSOCKETPP_STRICT_MASKING
+                m_current_msg->prepared_key = frame::byte_mask_circ(
+                    buf+i,
+                    block,
+                    n,
+                    m_current_msg->prepared_key
+                );
+            #else
+                m_current_msg->prepared_key = frame::word_mask_circ(
+                    buf+i,
+                    block,
+                    n,
+                    m_current_msg->prepared_key
+                );
+            #endif
+
+            if (!m_current_msg->validator.decode(block,n)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Unmasks and validates a whole message payload in place
+    /**
+     * Zero copy counterpart to process_payload_bytes. The entire payload of a
+     * single frame message (m_bytes_needed bytes) must be present in buf. The
+     * payload is unmasked in place, validated, and recorded in m_view. On
+     * success the processor moves to the READY state.
+     *
+     * @param buf Input/working buffer holding at least m_bytes_needed bytes
+     * @param ec A status code
+     * @return Number of bytes processed or zero in case of an error
+     */
+    size_t process_payload_view(uint8_t * buf, lib::error_code & ec) {
+        size_t len = m_bytes_needed;
+        frame::opcode::value op = frame::get_opcode(m_basic_header);
+
+        if (frame::get_masked(m_basic_header)) {
+            size_t key = prepare_masking_key(
+                frame::get_masking_key(m_basic_header,m_extended_header)
+            );
+            #ifdef WEBSOCKETPP_STRICT_MASKING
+                frame::byte_mask_circ(buf,len,key);
+            #else
+                frame::word_mask_circ(buf,len,key);
+            #endif
+        }
+
+        if (op == frame::opcode::TEXT) {
+            utf8_validator::validator v;
+            if (!v.decode(buf,len) || !v.complete()) {
+                ec = make_error_code(error::invalid_utf8);
+                return 0;
+            }
+        }
+
+        m_view = message_view(op,reinterpret_cast<char const *>(buf),len);
+        m_view_ready = true;
+        m_bytes_needed = 0;
+        m_state = READY;
+
+        return len;
+    }
+
     /// Validate an incoming basic header
     /**
      * Validates an incoming hybi13 basic header.
@@ -1078,11 +1481,15 @@ protected:
             std::copy(payload.begin(),payload.end(),o.begin());
         }
 
+        out->set_opcode(op);
         out->set_prepared(true);
 
         return lib::error_code();
     }
 
+    /// Block size used by unmask_validate_append, small enough to stay in L1
+    static size_t const fused_block_size = 4096;
+
     enum state {
         HEADER_BASIC = 0,
         HEADER_EXTENDED = 1,
@@ -1123,6 +1530,8 @@ protected:
     msg_metadata m_data_msg;
     // Metadata for the current control msg
     msg_metadata m_control_msg;
+    // Message object reused for incoming control frames
+    message_ptr m_control_buffer;
 
     // Pointer to the metadata associated with the frame being read
     msg_metadata * m_current_msg;
@@ -1135,6 +1544,28 @@ protected:
     // Overall state of the processor
     state m_state;
 
+    // Whether whole messages may be delivered in place as views
+    bool m_zero_copy;
+    // Whether the ready message is m_view rather than a message object
+    bool m_view_ready;
+    // View of the most recent zero copy message
+    message_view m_view;
+
+    // Whether data messages are handed out in chunks as they are read
+    bool m_streaming;
+    // Whether the ready state is m_chunk rather than a message
+    bool m_chunk_ready;
+    // Most recent streamed chunk
+    message_chunk m_chunk;
+    // State to continue in once m_chunk has been retrieved
+    state m_chunk_resume;
+    // Message object reused to hold the payload of streamed chunks
+    message_ptr m_stream_msg;
+    // Number of streamed messages completed
+    uint64_t m_stream_sequence;
+    // Bytes of the current streamed message handed out so far
+    uint64_t m_stream_offset;
+
     // Extensions
     permessage_deflate_type m_permessage_deflate;
     mobile_signaling_type m_mobile_signaling;
@@ -32,6 +32,7 @@
 #include <websocketpp/common/system_error.hpp>
 
 #include <websocketpp/close.hpp>
+#include <websocketpp/message_buffer/message.hpp>
 #include <websocketpp/utilities.hpp>
 #include <websocketpp/uri.hpp>
 
@@ -157,17 +158,43 @@ public:
     typedef typename config::request_type request_type;
     typedef typename config::response_type response_type;
     typedef typename config::message_type::ptr message_ptr;
+    typedef message_buffer::message_view message_view;
+    typedef message_buffer::message_chunk message_chunk;
     typedef std::pair<lib::error_code,std::string> err_str_pair;
 
     explicit processor(bool secure, bool server)
       : m_secure(secure)
-      , m_server(server) {}
+      , m_server(server)
+      , m_max_message_size(0) {}
 
     virtual ~processor() {}
 
     /// Get the protocol version of this processor
     virtual int get_version() const = 0;
 
+    /// Get maximum message size
+    /**
+     * @return The maximum size in bytes of an incoming message, 0 if unlimited
+     */
+    size_t get_max_message_size() const {
+        return m_max_message_size;
+    }
+
+    /// Set maximum message size
+    /**
+     * Incoming messages larger than this fail with error::message_too_big,
+     * which maps to close code 1009. The limit is checked against the
+     * announced length of each frame before its payload is buffered and
+     * against the assembled (decompressed) message as it grows. Messages
+     * delivered in chunks via set_streaming are not assembled and only the
+     * bytes decompressed from a single read are limited.
+     *
+     * @param new_value The maximum size in bytes, 0 for no limit
+     */
+    void set_max_message_size(size_t new_value) {
+        m_max_message_size = new_value;
+    }
+
     /// Returns whether or not the permessage_compress extension is implemented
     /**
      * Compile time flag that indicates whether this processor has implemented
@@ -297,6 +324,62 @@ public:
      */
     virtual message_ptr get_message() = 0;
 
+    /// Enables or disables zero copy delivery of whole messages
+    /**
+     * When enabled, processors that support it may complete an unfragmented,
+     * uncompressed data message whose payload is entirely contained in the
+     * buffer passed to consume without copying it into a message object. Such
+     * messages must be retrieved with get_message_view instead of get_message.
+     *
+     * By default zero copy delivery is not supported and this is a no-op.
+     *
+     * @param value Whether or not to enable zero copy delivery
+     */
+    virtual void set_zero_copy(bool value) {}
+
+    /// Retrieves the most recently processed message as a view
+    /**
+     * If the ready message was completed via the zero copy path this fills in
+     * view with the payload location inside the buffer most recently passed
+     * to consume and resets the ready state. The view is valid until that
+     * buffer is modified.
+     *
+     * @param view The view to fill in
+     *
+     * @return Whether or not a view was available. If false the ready message,
+     * if any, must be retrieved with get_message.
+     */
+    virtual bool get_message_view(message_view & view) {
+        return false;
+    }
+
+    /// Enables or disables streaming delivery of data messages
+    /**
+     * When enabled, processors that support it hand data message payloads out
+     * in chunks as they are read instead of assembling whole messages. Chunks
+     * must be retrieved with get_message_chunk. Control messages are still
+     * assembled and retrieved with get_message.
+     *
+     * By default streaming is not supported and this is a no-op.
+     *
+     * @param value Whether or not to enable streaming delivery
+     */
+    virtual void set_streaming(bool value) {}
+
+    /// Retrieves the most recently processed data message chunk
+    /**
+     * If the processor is ready with a chunk this fills it in and resets the
+     * ready state. The chunk payload is valid until the next call to consume.
+     *
+     * @param chunk The chunk to fill in
+     *
+     * @return Whether or not a chunk was available. If false the ready
+     * message, if any, must be retrieved with get_message.
+     */
+    virtual bool get_message_chunk(message_chunk & chunk) {
+        return false;
+    }
+
     /// Tests whether the processor is in a fatal error state
     virtual bool get_error() const = 0;
 
@@ -307,6 +390,21 @@ public:
         return 1;
     }
 
+    /// Tests whether the processor is between messages
+    /**
+     * A processor is idle when it holds no partially received frame or
+     * message, so none of the bytes it has consumed are needed to complete a
+     * future message. The connection uses this to decide when it may give up
+     * its read buffer.
+     *
+     * The default implementation always returns true.
+     *
+     * @return Whether or not the processor is at a message boundary
+     */
+    virtual bool idle() const {
+        return true;
+    }
+
     /// Prepare a data message for writing
     /**
      * Performs validation, masking, compression, etc. will return an error if
@@ -315,6 +413,38 @@ public:
     virtual lib::error_code prepare_data_frame(message_ptr in, message_ptr out)
         = 0;
 
+    /// Get a key describing how this processor would frame a data message
+    /**
+     * Processors that return the same non-negative key for a message produce
+     * identical bytes on the wire for it, so one frame prepared by any of them
+     * may be shared by all of them. A negative key means the frame depends on
+     * state private to this processor, such as a masking key or compression
+     * context, and must be prepared separately.
+     *
+     * @param in The message that would be prepared
+     *
+     * @return The shared framing key, or -1 if the frame can't be shared
+     */
+    virtual int get_shared_frame_key(message_ptr in) const {
+        return -1;
+    }
+
+    /// Returns whether framing a data message changes processor state
+    /**
+     * Messages for which this returns false may be passed to
+     * prepare_data_frame from several threads at once. Messages for which it
+     * returns true, such as those compressed with a shared compression
+     * context, must be prepared one at a time and in the order they will be
+     * sent.
+     *
+     * @param in The message that would be prepared
+     *
+     * @return Whether preparing the message is stateful
+     */
+    virtual bool prepare_is_stateful(message_ptr in) const {
+        return true;
+    }
+
     /// Prepare a ping frame
     /**
      * Ping preparation is entirely state free. There is no payload validation
@@ -363,6 +493,7 @@ public:
 protected:
     bool const m_secure;
     bool const m_server;
+    size_t m_max_message_size;
 };
 
 } // namespace processor
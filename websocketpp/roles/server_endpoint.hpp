@@ -67,7 +67,9 @@ public:
 
     // TODO: clean up these types
 
-    explicit server() : endpoint_type(true)
+    explicit server()
+      : endpoint_type(true)
+      , m_concurrent_accepts(config::concurrent_accepts)
     {
         endpoint_type::m_alog.write(log::alevel::devel,
             "server constructor");
@@ -81,19 +83,34 @@ public:
         return con;
     }
 
-    // Starts the server's async connection acceptance loop.
-    void start_accept() {
-        connection_ptr con = get_connection();
+    /// Set the number of accepts to keep outstanding per transport shard
+    /**
+     * Takes effect on the next call to start_accept. The default is set by
+     * the `concurrent_accepts` config value. Values less than 1 are treated
+     * as 1.
+     *
+     * @param value The number of accepts to keep outstanding per shard
+     */
+    void set_concurrent_accepts(size_t value) {
+        m_concurrent_accepts = (value < 1 ? 1 : value);
+    }
 
-        transport_type::async_accept(
-            lib::static_pointer_cast<transport_con_type>(con),
-            lib::bind(
-                &type::handle_accept,
-                this,
-                con,
-                lib::placeholders::_1
-            )
-        );
+    /// Get the number of accepts kept outstanding per transport shard
+    size_t get_concurrent_accepts() const {
+        return m_concurrent_accepts;
+    }
+
+    // Starts the server's async connection acceptance loop. The configured
+    // number of accepts is kept outstanding for each transport shard.
+    void start_accept() {
+        size_t count = m_concurrent_accepts * transport_type::get_num_shards();
+        for (size_t i = 0; i < count; i++) {
+            lib::error_code ec;
+            start_accept_one(ec);
+            if (ec) {
+                throw ec;
+            }
+        }
     }
 
     void handle_accept(connection_ptr con, const lib::error_code& ec) {
@@ -106,10 +123,35 @@ public:
             con->start();
         }
 
-        // TODO: are there cases where we should terminate this loop?
-        start_accept();
+        // Replace the accept that completed. This fails once the transport
+        // has stopped listening, which ends this accept's loop.
+        lib::error_code start_ec;
+        start_accept_one(start_ec);
+        if (start_ec) {
+            endpoint_type::m_alog.write(log::alevel::devel,
+                "accept loop stopped: "+start_ec.message());
+        }
     }
 private:
+    // Creates a connection and queues an accept for it. Runs on the thread of
+    // the accept that just completed so that in sharded mode the replacement
+    // accept stays on the same shard.
+    void start_accept_one(lib::error_code & ec) {
+        connection_ptr con = get_connection();
+
+        transport_type::async_accept(
+            lib::static_pointer_cast<transport_con_type>(con),
+            lib::bind(
+                &type::handle_accept,
+                this,
+                con,
+                lib::placeholders::_1
+            ),
+            ec
+        );
+    }
+
+    size_t m_concurrent_accepts;
 };
 
 } // namespace websocketpp
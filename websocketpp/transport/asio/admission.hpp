@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_TRANSPORT_ASIO_ADMISSION_HPP
+#define WEBSOCKETPP_TRANSPORT_ASIO_ADMISSION_HPP
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/thread.hpp>
+
+#include <boost/asio.hpp>
+
+#include <map>
+#include <string>
+
+namespace websocketpp {
+namespace transport {
+namespace asio {
+
+/// Handler that decides whether to keep a newly accepted socket
+/**
+ * Called with the remote endpoint of each accepted socket before any
+ * connection state is set up for it. Returning false closes the socket.
+ */
+typedef lib::function<bool(boost::asio::ip::tcp::endpoint const &)>
+    admission_handler;
+
+/// Token bucket refilled continuously at a fixed rate
+/**
+ * Not thread safe, accept_limiter serializes access to its buckets.
+ */
+class token_bucket {
+public:
+    /// Construct a full bucket
+    /**
+     * @param rate Tokens added per second
+     * @param burst Maximum number of tokens held, at least one
+     * @param now Current time in milliseconds
+     */
+    token_bucket(double rate, double burst, uint64_t now)
+      : m_rate(rate)
+      , m_burst(burst < 1 ? 1 : burst)
+      , m_tokens(m_burst)
+      , m_last(now)
+    {}
+
+    /// Add the tokens accrued since the last refill
+    void refill(uint64_t now) {
+        if (now > m_last) {
+            m_tokens += m_rate * (now - m_last) / 1000.0;
+            if (m_tokens > m_burst) {
+                m_tokens = m_burst;
+            }
+        }
+        m_last = now;
+    }
+
+    /// Whether a token is available, as of the last refill
+    bool ready() const {
+        return m_tokens >= 1;
+    }
+
+    /// Take one token, call only when ready() is true
+    void take() {
+        m_tokens -= 1;
+    }
+
+    /// Whether the bucket has refilled completely, as of the last refill
+    bool full() const {
+        return m_tokens >= m_burst;
+    }
+private:
+    double      m_rate;
+    double      m_burst;
+    double      m_tokens;
+    uint64_t    m_last;
+};
+
+/// Accept rate limits, global and per remote address prefix
+/**
+ * Each admitted socket takes a token from the global bucket and from the
+ * bucket of its remote address prefix. A socket is admitted only when both
+ * have a token, so a rejected socket does not use up either budget. Either
+ * limit is disabled while its rate is zero, which is the default.
+ *
+ * IPv4 mapped IPv6 addresses are treated as IPv4. Prefix buckets are created
+ * on demand. Once more than the maximum number of prefixes is tracked, buckets
+ * that have refilled completely are dropped, at most once a second. If that
+ * does not free a slot, new prefixes are checked against the global limit
+ * only until one does.
+ *
+ * All methods are thread safe.
+ */
+class accept_limiter {
+public:
+    accept_limiter()
+      : m_global(0,1,0)
+      , m_global_rate(0)
+      , m_prefix_rate(0)
+      , m_prefix_burst(1)
+      , m_v4_prefix(24)
+      , m_v6_prefix(64)
+      , m_max_prefixes(4096)
+      , m_last_sweep(0)
+      , m_enabled(false)
+    {}
+
+    /// Limit the rate of accepts from all addresses combined
+    /**
+     * @param rate Accepts per second, zero disables the limit
+     * @param burst Number of accepts allowed in a burst above the rate
+     */
+    void set_global_limit(double rate, double burst) {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        m_global_rate = rate;
+        m_global = token_bucket(rate,burst,0);
+        m_enabled = (m_global_rate > 0 || m_prefix_rate > 0);
+    }
+
+    /// Limit the rate of accepts from each remote address prefix
+    /**
+     * Changing the limit forgets the state of all prefixes.
+     *
+     * @param rate Accepts per second per prefix, zero disables the limit
+     * @param burst Number of accepts allowed in a burst above the rate
+     * @param v4_prefix Leading bits of an IPv4 address that form its prefix
+     * @param v6_prefix Leading bits of an IPv6 address that form its prefix
+     */
+    void set_prefix_limit(double rate, double burst, unsigned v4_prefix = 24,
+        unsigned v6_prefix = 64)
+    {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        m_prefix_rate = rate;
+        m_prefix_burst = burst;
+        m_v4_prefix = (v4_prefix > 32 ? 32 : v4_prefix);
+        m_v6_prefix = (v6_prefix > 128 ? 128 : v6_prefix);
+        m_prefixes.clear();
+        m_enabled = (m_global_rate > 0 || m_prefix_rate > 0);
+    }
+
+    /// Set the number of prefixes to track before dropping idle ones
+    void set_max_prefixes(size_t value) {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        m_max_prefixes = value;
+    }
+
+    /// Get the number of prefixes currently tracked
+    size_t get_num_prefixes() const {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return m_prefixes.size();
+    }
+
+    /// Whether either limit is enabled
+    /**
+     * Does not lock, so the accept path pays nothing while no limit is set.
+     */
+    bool enabled() const {
+        return m_enabled;
+    }
+
+    /// Decide whether to admit a socket from the given address
+    /**
+     * Takes a token from each applicable bucket if the socket is admitted.
+     *
+     * @param address The remote address of the socket
+     * @param now Current time in milliseconds
+     * @return Whether the socket is within both limits
+     */
+    bool admit(boost::asio::ip::address const & address, uint64_t now) {
+        if (!m_enabled) {
+            return true;
+        }
+
+        lib::lock_guard<lib::mutex> lock(m_lock);
+
+        token_bucket * global = NULL;
+        if (m_global_rate > 0) {
+            global = &m_global;
+            global->refill(now);
+            if (!global->ready()) {
+                return false;
+            }
+        }
+
+        token_bucket * prefix = NULL;
+        if (m_prefix_rate > 0) {
+            prefix = get_prefix_bucket(address,now);
+            if (prefix) {
+                prefix->refill(now);
+                if (!prefix->ready()) {
+                    return false;
+                }
+            }
+        }
+
+        if (global) {
+            global->take();
+        }
+        if (prefix) {
+            prefix->take();
+        }
+        return true;
+    }
+private:
+    typedef std::map<std::string,token_bucket> prefix_map;
+
+    // Key the address by its family and masked leading bytes
+    std::string prefix_key(boost::asio::ip::address const & address) const {
+        std::string key;
+        unsigned bits;
+
+        if (address.is_v6() && !address.to_v6().is_v4_mapped()) {
+            boost::asio::ip::address_v6::bytes_type b = address.to_v6().to_bytes();
+            key.assign(1,'6');
+            key.append(b.begin(),b.end());
+            bits = m_v6_prefix;
+        } else {
+            boost::asio::ip::address_v4 v4 = (address.is_v6() ?
+                address.to_v6().to_v4() : address.to_v4());
+            boost::asio::ip::address_v4::bytes_type b = v4.to_bytes();
+            key.assign(1,'4');
+            key.append(b.begin(),b.end());
+            bits = m_v4_prefix;
+        }
+
+        size_t bytes = (bits + 7) / 8;
+        key.resize(1 + bytes);
+        if (bits % 8) {
+            key[bytes] = char(key[bytes] & (0xff << (8 - bits % 8)));
+        }
+        return key;
+    }
+
+    // Find or create the bucket for the address, NULL if the table is full
+    token_bucket * get_prefix_bucket(boost::asio::ip::address const &
+        address, uint64_t now)
+    {
+        std::string key = prefix_key(address);
+
+        prefix_map::iterator it = m_prefixes.find(key);
+        if (it != m_prefixes.end()) {
+            return &it->second;
+        }
+
+        if (m_prefixes.size() >= m_max_prefixes) {
+            if (now < m_last_sweep + 1000) {
+                return NULL;
+            }
+            m_last_sweep = now;
+            sweep(now);
+            if (m_prefixes.size() >= m_max_prefixes) {
+                return NULL;
+            }
+        }
+
+        it = m_prefixes.insert(prefix_map::value_type(key,
+            token_bucket(m_prefix_rate,m_prefix_burst,now))).first;
+        return &it->second;
+    }
+
+    // Drop prefixes whose buckets have refilled, they carry no state
+    void sweep(uint64_t now) {
+        prefix_map::iterator it = m_prefixes.begin();
+        while (it != m_prefixes.end()) {
+            it->second.refill(now);
+            if (it->second.full()) {
+                m_prefixes.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    token_bucket        m_global;
+    double              m_global_rate;
+    double              m_prefix_rate;
+    double              m_prefix_burst;
+    unsigned            m_v4_prefix;
+    unsigned            m_v6_prefix;
+    size_t              m_max_prefixes;
+    uint64_t            m_last_sweep;
+    prefix_map          m_prefixes;
+    lib::atomic<bool>   m_enabled;
+    mutable lib::mutex  m_lock;
+};
+
+} // namespace asio
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_ASIO_ADMISSION_HPP
@@ -196,7 +196,16 @@ enum value {
     proxy_invalid,
 
     /// Invalid host or service
-    invalid_host_service
+    invalid_host_service,
+
+    /// Sharded listening requires SO_REUSEPORT, which this platform lacks
+    reuse_port_unsupported,
+
+    /// Outgoing connections are not supported in sharded mode
+    sharded_connect,
+
+    /// Sharded mode requires a config with enable_multithreading
+    sharding_requires_multithreading
 };
 
 /// Asio transport error category
@@ -220,6 +229,12 @@ public:
                 return "Invalid proxy URI";
             case error::invalid_host_service:
                 return "Invalid host or service";
+            case error::reuse_port_unsupported:
+                return "SO_REUSEPORT is not supported on this platform";
+            case error::sharded_connect:
+                return "Outgoing connections are not supported in sharded mode";
+            case error::sharding_requires_multithreading:
+                return "Sharded mode requires a multithreaded config";
             default:
                 return "Unknown";
         }
@@ -34,12 +34,14 @@
 #include <websocketpp/logger/levels.hpp>
 #include <websocketpp/http/constants.hpp>
 #include <websocketpp/transport/asio/base.hpp>
+#include <websocketpp/transport/asio/timer_wheel.hpp>
 #include <websocketpp/transport/base/connection.hpp>
 
 #include <websocketpp/base64/base64.hpp>
 #include <websocketpp/error.hpp>
 
 #include <boost/asio.hpp>
+#include <boost/mpl/if.hpp>
 #include <boost/system/error_code.hpp>
 
 #include <sstream>
@@ -83,8 +85,17 @@ public:
     typedef boost::asio::io_service* io_service_ptr;
     /// Type of a pointer to the ASIO io_service::strand being used
     typedef lib::shared_ptr<boost::asio::io_service::strand> strand_ptr;
+    /// Type of a pointer to the shared timer wheel
+    typedef timer_wheel::ptr timer_wheel_ptr;
     /// Type of a pointer to the ASIO timer class
-    typedef lib::shared_ptr<boost::asio::deadline_timer> timer_ptr;
+    /**
+     * A deadline_timer per timer by default, or an entry in a shared
+     * timer_wheel if the config enables it. Both support cancel and
+     * expires_from_now.
+     */
+    typedef typename boost::mpl::if_c<config::enable_timer_wheel,
+        timer_wheel::timer_ptr,
+        lib::shared_ptr<boost::asio::deadline_timer> >::type timer_ptr;
 
     // connection is friends with its associated endpoint to allow the endpoint
     // to call private/protected utility methods that we don't want to expose
@@ -289,29 +300,8 @@ public:
      * needed.
      */
     timer_ptr set_timer(long duration, timer_handler callback) {
-        timer_ptr new_timer(
-            new boost::asio::deadline_timer(
-                *m_io_service,
-                boost::posix_time::milliseconds(duration)
-            )
-        );
-
-        if (config::enable_multithreading) {
-            new_timer->async_wait(m_strand->wrap(lib::bind(
-                &type::handle_timer, get_shared(),
-                new_timer,
-                callback,
-                lib::placeholders::_1
-            )));
-        } else {
-            new_timer->async_wait(lib::bind(
-                &type::handle_timer, get_shared(),
-                new_timer,
-                callback,
-                lib::placeholders::_1
-            ));
-        }
-
+        timer_ptr new_timer;
+        start_timer(new_timer,duration,callback);
         return new_timer;
     }
 
@@ -326,8 +316,8 @@ public:
      * @param callback The function to call back
      * @param ec The status code
      */
-    void handle_timer(timer_ptr t, timer_handler callback,
-        boost::system::error_code const & ec)
+    void handle_timer(lib::shared_ptr<boost::asio::deadline_timer> t,
+        timer_handler callback, boost::system::error_code const & ec)
     {
         if (ec) {
             if (ec == boost::asio::error::operation_aborted) {
@@ -346,6 +336,11 @@ protected:
         return m_strand;
     }
 
+    /// Get a pointer to the io_service this connection is registered with
+    io_service_ptr get_io_service() const {
+        return m_io_service;
+    }
+
     /// Initialize transport for reading
     /**
      * init_asio is called once immediately after construction to initialize
@@ -412,13 +407,23 @@ protected:
      * @param io_service A pointer to the io_service to register with this
      * connection
      *
+     * @param use_strand Whether to serialize this connection's handlers with a
+     * strand. Only needed when the io_service is run by more than one thread.
+     *
+     * @param wheel The timer wheel to schedule timers on. Required if the
+     * config enables timer wheels, ignored otherwise.
+     *
      * @return Status code for the success or failure of the initialization
      */
-    lib::error_code init_asio (io_service_ptr io_service) {
+    lib::error_code init_asio (io_service_ptr io_service,
+        bool use_strand = config::enable_multithreading,
+        timer_wheel_ptr wheel = timer_wheel_ptr())
+    {
         // do we need to store or use the io_service at this level?
         m_io_service = io_service;
+        m_timer_wheel = wheel;
 
-        if (config::enable_multithreading) {
+        if (use_strand) {
             m_strand.reset(new boost::asio::strand(*io_service));
 
             m_async_read_handler = m_strand->wrap(lib::bind(
@@ -577,7 +582,7 @@ protected:
         );
 
         // Send proxy request
-        if (config::enable_multithreading) {
+        if (m_strand) {
             boost::asio::async_write(
                 socket_con_type::get_next_layer(),
                 m_bufs,
@@ -660,7 +665,7 @@ protected:
             return;
         }
 
-        if (config::enable_multithreading) {
+        if (m_strand) {
             boost::asio::async_read_until(
                 socket_con_type::get_next_layer(),
                 m_proxy_data->read_buf,
@@ -904,7 +909,7 @@ protected:
      * This needs to be thread safe
      */
     lib::error_code interrupt(interrupt_handler handler) {
-        if (config::enable_multithreading) {
+        if (m_strand) {
             m_io_service->post(m_strand->wrap(handler));
         } else {
             m_io_service->post(handler);
@@ -913,7 +918,7 @@ protected:
     }
 
     lib::error_code dispatch(dispatch_handler handler) {
-        if (config::enable_multithreading) {
+        if (m_strand) {
             m_io_service->post(m_strand->wrap(handler));
         } else {
             m_io_service->post(handler);
@@ -1018,6 +1023,46 @@ protected:
         }
     }
 private:
+    /// Start a timer on its own deadline_timer
+    void start_timer(lib::shared_ptr<boost::asio::deadline_timer> & new_timer,
+        long duration, timer_handler callback)
+    {
+        new_timer.reset(
+            new boost::asio::deadline_timer(
+                *m_io_service,
+                boost::posix_time::milliseconds(duration)
+            )
+        );
+
+        if (m_strand) {
+            new_timer->async_wait(m_strand->wrap(lib::bind(
+                &type::handle_timer, get_shared(),
+                new_timer,
+                callback,
+                lib::placeholders::_1
+            )));
+        } else {
+            new_timer->async_wait(lib::bind(
+                &type::handle_timer, get_shared(),
+                new_timer,
+                callback,
+                lib::placeholders::_1
+            ));
+        }
+    }
+
+    /// Start a timer on the shared timer wheel
+    void start_timer(timer_wheel::timer_ptr & new_timer, long duration,
+        timer_handler callback)
+    {
+        if (m_strand) {
+            new_timer = m_timer_wheel->set_timer(duration,
+                m_strand->wrap(callback));
+        } else {
+            new_timer = m_timer_wheel->set_timer(duration,callback);
+        }
+    }
+
     /// Convenience method for logging the code and message for an error_code
     template <typename error_type>
     void log_err(log::level l, const char * msg, const error_type & ec) {
@@ -1048,6 +1093,7 @@ private:
     // transport resources
     io_service_ptr  m_io_service;
     strand_ptr      m_strand;
+    timer_wheel_ptr m_timer_wheel;
     connection_hdl  m_connection_hdl;
 
     std::vector<boost::asio::const_buffer> m_bufs;
@@ -28,9 +28,13 @@
 #ifndef WEBSOCKETPP_TRANSPORT_ASIO_HPP
 #define WEBSOCKETPP_TRANSPORT_ASIO_HPP
 
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/chrono.hpp>
 #include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/thread.hpp>
 #include <websocketpp/logger/levels.hpp>
 #include <websocketpp/transport/base/endpoint.hpp>
+#include <websocketpp/transport/asio/admission.hpp>
 #include <websocketpp/transport/asio/connection.hpp>
 #include <websocketpp/transport/asio/security/none.hpp>
 
@@ -39,6 +43,7 @@
 #include <boost/system/error_code.hpp>
 
 #include <iostream>
+#include <vector>
 
 namespace websocketpp {
 namespace transport {
@@ -83,13 +88,19 @@ public:
     /// Type of a shared pointer to the resolver being used
     typedef lib::shared_ptr<boost::asio::ip::tcp::resolver> resolver_ptr;
     /// Type of timer handle
-    typedef lib::shared_ptr<boost::asio::deadline_timer> timer_ptr;
+    typedef typename transport_con_type::timer_ptr timer_ptr;
+    /// Type of a shared pointer to a timer wheel
+    typedef typename transport_con_type::timer_wheel_ptr timer_wheel_ptr;
     /// Type of a shared pointer to an io_service work object
     typedef lib::shared_ptr<boost::asio::io_service::work> work_ptr;
+    /// Type of a shared pointer to a mutex
+    typedef lib::shared_ptr<lib::mutex> mutex_ptr;
 
     // generate and manage our own io_service
     explicit endpoint()
       : m_external_io_service(false)
+      , m_next_shard(0)
+      , m_rejected_accepts(0)
       , m_listen_backlog(0)
       , m_state(UNINITIALIZED)
     {
@@ -99,9 +110,18 @@ public:
     ~endpoint() {
         // clean up our io_service if we were initialized with an internal one.
         m_acceptor.reset();
+        m_timer_wheel.reset();
+        for (size_t i = 0; i < m_shards.size(); i++) {
+            m_shards[i].acceptor.reset();
+            m_shards[i].timer_wheel.reset();
+        }
         if (m_state != UNINITIALIZED && !m_external_io_service) {
             delete m_io_service;
         }
+        // the first shard's io_service is m_io_service
+        for (size_t i = 1; i < m_shards.size(); i++) {
+            delete m_shards[i].io_service;
+        }
     }
 
     /// transport::asio objects are moveable but not copyable or assignable.
@@ -122,6 +142,8 @@ public:
       : m_io_service(src.m_io_service)
       , m_external_io_service(src.m_external_io_service)
       , m_acceptor(src.m_acceptor)
+      , m_next_shard(0)
+      , m_rejected_accepts(0)
       , m_listen_backlog(0)
       , m_state(src.m_state)
     {
@@ -176,6 +198,7 @@ public:
         m_io_service = ptr;
         m_external_io_service = true;
         m_acceptor.reset(new boost::asio::ip::tcp::acceptor(*m_io_service));
+        m_timer_wheel = make_timer_wheel(*m_io_service);
         m_state = READY;
         ec = lib::error_code();
     }
@@ -222,6 +245,100 @@ public:
         m_external_io_service = false;
     }
 
+    /// Initialize asio transport with an io_service per thread (exception free)
+    /**
+     * Sharded initialization allocates several internally managed io_services.
+     * run() runs each of them on its own thread and listen() opens one
+     * SO_REUSEPORT acceptor per shard on the same address, letting the kernel
+     * spread incoming connections across shards.
+     *
+     * A connection stays on the shard that it was created on. Connections
+     * created from a shard's thread, which includes the connection that a
+     * server creates to accept the next client, are registered with that
+     * shard. Connections created from other threads are assigned round robin.
+     *
+     * Each shard's io_service is only ever run by its own thread, so
+     * connections in sharded mode don't use strands even when the config
+     * enables multithreading.
+     *
+     * Endpoint level timers use the first shard. Sharded mode is for
+     * servers, outgoing connections fail with error::sharded_connect.
+     *
+     * Shared endpoint state is touched from every shard thread, so the config
+     * must enable multithreading. Otherwise this fails with
+     * error::sharding_requires_multithreading.
+     *
+     * @see init_asio()
+     *
+     * @param shards The number of shards to create. Zero creates one per
+     * hardware thread.
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void init_asio_sharded(size_t shards, lib::error_code & ec) {
+        if (m_state != UNINITIALIZED) {
+            m_elog->write(log::elevel::library,
+                "asio::init_asio_sharded called from the wrong state");
+            using websocketpp::error::make_error_code;
+            ec = make_error_code(websocketpp::error::invalid_state);
+            return;
+        }
+
+        if (!config::enable_multithreading) {
+            m_elog->write(log::elevel::library,
+                "asio::init_asio_sharded requires enable_multithreading");
+            ec = make_error_code(error::sharding_requires_multithreading);
+            return;
+        }
+
+        m_alog->write(log::alevel::devel,"asio::init_asio_sharded");
+
+        if (shards == 0) {
+            shards = lib::thread::hardware_concurrency();
+        }
+        if (shards == 0) {
+            shards = 1;
+        }
+
+        m_shards.resize(shards);
+        for (size_t i = 0; i < shards; i++) {
+            m_shards[i].io_service = new boost::asio::io_service();
+            m_shards[i].acceptor.reset(
+                new boost::asio::ip::tcp::acceptor(*m_shards[i].io_service));
+            m_shards[i].accept_lock.reset(new lib::mutex());
+            m_shards[i].timer_wheel = make_timer_wheel(*m_shards[i].io_service);
+        }
+
+        m_io_service = m_shards[0].io_service;
+        m_acceptor = m_shards[0].acceptor;
+        m_timer_wheel = m_shards[0].timer_wheel;
+        m_external_io_service = false;
+        m_state = READY;
+        ec = lib::error_code();
+    }
+
+    /// Initialize asio transport with an io_service per thread
+    /**
+     * @see init_asio_sharded(size_t,lib::error_code &)
+     *
+     * @param shards The number of shards to create. Zero creates one per
+     * hardware thread.
+     */
+    void init_asio_sharded(size_t shards) {
+        lib::error_code ec;
+        init_asio_sharded(shards,ec);
+        if (ec) {
+            throw ec;
+        }
+    }
+
+    /// Get the number of io_service shards
+    /**
+     * @return The number of shards, or 1 if the endpoint is not sharded
+     */
+    size_t get_num_shards() const {
+        return m_shards.empty() ? 1 : m_shards.size();
+    }
+
     /// Sets the tcp pre init handler
     /**
      * The tcp pre init handler is called after the raw tcp connection has been
@@ -288,6 +405,63 @@ public:
         m_listen_backlog = backlog;
     }
 
+    /// Sets the admission handler
+    /**
+     * The admission handler is called with the remote endpoint of each
+     * accepted socket, before the tcp init handlers and before the connection
+     * reads anything. If it returns false the socket is reset and the
+     * connection that was waiting for it is reused for the next accept, so
+     * rejected sockets never cost a connection of their own.
+     *
+     * The handler runs before the accept rate limits are checked and may be
+     * called concurrently from several threads.
+     *
+     * @param h The handler to call for each accepted socket
+     */
+    void set_admission_handler(admission_handler h) {
+        m_admission_handler = h;
+    }
+
+    /// Limit the rate of accepted connections from all addresses combined
+    /**
+     * Sockets accepted over the limit are reset in the same way as those
+     * rejected by the admission handler. The limit is a token bucket that
+     * allows `burst` connections at once and refills at `rate` per second.
+     *
+     * @param rate Connections per second, zero disables the limit (default)
+     * @param burst Number of connections allowed in a burst above the rate
+     */
+    void set_accept_rate_limit(double rate, double burst) {
+        m_accept_limiter.set_global_limit(rate,burst);
+    }
+
+    /// Limit the rate of accepted connections from each address prefix
+    /**
+     * Works like set_accept_rate_limit with a separate bucket for each remote
+     * address prefix, so a single host or subnet reconnecting in a loop is
+     * cut off without affecting others.
+     *
+     * @param rate Connections per second per prefix, zero disables the limit
+     * @param burst Number of connections allowed in a burst above the rate
+     * @param v4_prefix Leading bits of an IPv4 address that form its prefix
+     * @param v6_prefix Leading bits of an IPv6 address that form its prefix
+     */
+    void set_accept_rate_limit_per_prefix(double rate, double burst,
+        unsigned v4_prefix = 24, unsigned v6_prefix = 64)
+    {
+        m_accept_limiter.set_prefix_limit(rate,burst,v4_prefix,v6_prefix);
+    }
+
+    /// Retrieve the accept rate limiter
+    accept_limiter & get_accept_limiter() {
+        return m_accept_limiter;
+    }
+
+    /// Get the number of sockets reset by admission control
+    uint64_t get_rejected_accepts() const {
+        return m_rejected_accepts;
+    }
+
     /// Retrieve a reference to the endpoint's io_service
     /**
      * The io_service may be an internal or external one. This may be used to
@@ -303,6 +477,22 @@ public:
         return *m_io_service;
     }
 
+    /// Retrieve a reference to the io_service of a shard
+    /**
+     * Shard zero is the endpoint's main io_service. If the endpoint is not
+     * sharded that is the only one.
+     *
+     * @param shard The index of the shard, less than get_num_shards()
+     *
+     * @return A reference to the shard's io_service
+     */
+    boost::asio::io_service & get_io_service(size_t shard) {
+        if (m_shards.empty()) {
+            return *m_io_service;
+        }
+        return *m_shards[shard].io_service;
+    }
+
     /// Set up endpoint for listening manually (exception free)
     /**
      * Bind the internal acceptor using the specified settings. The endpoint
@@ -323,13 +513,25 @@ public:
 
         m_alog->write(log::alevel::devel,"asio::listen");
 
-        m_acceptor->open(ep.protocol());
-        m_acceptor->set_option(boost::asio::socket_base::reuse_address(true));
-        m_acceptor->bind(ep);
-        if (m_listen_backlog == 0) {
-            m_acceptor->listen();
+        if (m_shards.empty()) {
+            open_acceptor(*m_acceptor,ep);
         } else {
-            m_acceptor->listen(m_listen_backlog);
+#ifdef SO_REUSEPORT
+            typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET,
+                SO_REUSEPORT> reuse_port;
+
+            for (size_t i = 0; i < m_shards.size(); i++) {
+                boost::asio::ip::tcp::acceptor & a = *m_shards[i].acceptor;
+                a.open(ep.protocol());
+                a.set_option(reuse_port(true));
+                open_acceptor(a,ep);
+            }
+#else
+            m_elog->write(log::elevel::library,
+                "asio::listen sharded mode requires SO_REUSEPORT");
+            ec = make_error_code(error::reuse_port_unsupported);
+            return;
+#endif
         }
         m_state = LISTENING;
         ec = lib::error_code();
@@ -490,17 +692,32 @@ public:
      * @param ec A status code indicating an error, if any.
      */
     void stop_listening(lib::error_code & ec) {
+        // Hold every accept lock so no shard re-arms while the state changes
+        lib::lock_guard<lib::mutex> lock(m_accept_lock);
+        for (size_t i = 0; i < m_shards.size(); i++) {
+            m_shards[i].accept_lock->lock();
+        }
+
         if (m_state != LISTENING) {
             m_elog->write(log::elevel::library,
                 "asio::listen called from the wrong state");
             using websocketpp::error::make_error_code;
             ec = make_error_code(websocketpp::error::invalid_state);
-            return;
+        } else {
+            if (m_shards.empty()) {
+                m_acceptor->close();
+            } else {
+                for (size_t i = 0; i < m_shards.size(); i++) {
+                    m_shards[i].acceptor->close();
+                }
+            }
+            m_state = READY;
+            ec = lib::error_code();
         }
 
-        m_acceptor->close();
-        m_state = READY;
-        ec = lib::error_code();
+        for (size_t i = 0; i < m_shards.size(); i++) {
+            m_shards[i].accept_lock->unlock();
+        }
     }
 
     /// Stop listening
@@ -519,12 +736,38 @@ public:
     }
 
     /// wraps the run method of the internal io_service object
+    /**
+     * In sharded mode this runs every shard on its own thread, using the
+     * calling thread for the first one, and returns once all have stopped.
+     */
     std::size_t run() {
-        return m_io_service->run();
+        if (m_shards.empty()) {
+            return m_io_service->run();
+        }
+
+        std::vector<std::size_t> counts(m_shards.size(),0);
+        std::vector<lib::shared_ptr<lib::thread> > threads;
+
+        for (size_t i = 1; i < m_shards.size(); i++) {
+            threads.push_back(lib::shared_ptr<lib::thread>(new lib::thread(
+                lib::bind(&type::run_shard,this,i,&counts[i])
+            )));
+        }
+
+        run_shard(0,&counts[0]);
+
+        std::size_t total = counts[0];
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i]->join();
+            total += counts[i+1];
+        }
+        return total;
     }
 
     /// wraps the run_one method of the internal io_service object
     /**
+     * In sharded mode this runs the first shard only.
+     *
      * @since 0.3.0-alpha4
      */
     std::size_t run_one() {
@@ -533,27 +776,60 @@ public:
 
     /// wraps the stop method of the internal io_service object
     void stop() {
-        m_io_service->stop();
+        if (m_shards.empty()) {
+            m_io_service->stop();
+            return;
+        }
+        for (size_t i = 0; i < m_shards.size(); i++) {
+            m_shards[i].io_service->stop();
+        }
     }
 
     /// wraps the poll method of the internal io_service object
     std::size_t poll() {
-        return m_io_service->poll();
+        if (m_shards.empty()) {
+            return m_io_service->poll();
+        }
+        std::size_t total = 0;
+        for (size_t i = 0; i < m_shards.size(); i++) {
+            total += m_shards[i].io_service->poll();
+        }
+        return total;
     }
 
     /// wraps the poll_one method of the internal io_service object
+    /**
+     * In sharded mode this polls the first shard only.
+     */
     std::size_t poll_one() {
         return m_io_service->poll_one();
     }
 
     /// wraps the reset method of the internal io_service object
     void reset() {
-        m_io_service->reset();
+        if (m_shards.empty()) {
+            m_io_service->reset();
+            return;
+        }
+        for (size_t i = 0; i < m_shards.size(); i++) {
+            m_shards[i].io_service->reset();
+        }
     }
 
     /// wraps the stopped method of the internal io_service object
+    /**
+     * In sharded mode this is true only once every shard has stopped.
+     */
     bool stopped() const {
-        return m_io_service->stopped();
+        if (m_shards.empty()) {
+            return m_io_service->stopped();
+        }
+        for (size_t i = 0; i < m_shards.size(); i++) {
+            if (!m_shards[i].io_service->stopped()) {
+                return false;
+            }
+        }
+        return true;
     }
 
     /// Marks the endpoint as perpetual, stopping it from exiting when empty
@@ -570,6 +846,10 @@ public:
      */
     void start_perpetual() {
         m_work.reset(new boost::asio::io_service::work(*m_io_service));
+        for (size_t i = 1; i < m_shards.size(); i++) {
+            m_shards[i].work.reset(
+                new boost::asio::io_service::work(*m_shards[i].io_service));
+        }
     }
 
     /// Clears the endpoint's perpetual flag, allowing it to exit when empty
@@ -582,6 +862,9 @@ public:
      */
     void stop_perpetual() {
         m_work.reset();
+        for (size_t i = 1; i < m_shards.size(); i++) {
+            m_shards[i].work.reset();
+        }
     }
 
     /// Call back a function after a period of time.
@@ -597,23 +880,8 @@ public:
      * needed.
      */
     timer_ptr set_timer(long duration, timer_handler callback) {
-        timer_ptr new_timer(
-            new boost::asio::deadline_timer(
-                *m_io_service,
-                boost::posix_time::milliseconds(duration)
-            )
-        );
-
-        new_timer->async_wait(
-            lib::bind(
-                &type::handle_timer,
-                this,
-                new_timer,
-                callback,
-                lib::placeholders::_1
-            )
-        );
-
+        timer_ptr new_timer;
+        start_timer(new_timer,duration,callback);
         return new_timer;
     }
 
@@ -626,8 +894,8 @@ public:
      * @param callback The function to call back
      * @param ec A status code indicating an error, if any.
      */
-    void handle_timer(timer_ptr t, timer_handler callback,
-        boost::system::error_code const & ec)
+    void handle_timer(lib::shared_ptr<boost::asio::deadline_timer> t,
+        timer_handler callback, boost::system::error_code const & ec)
     {
         if (ec) {
             if (ec == boost::asio::error::operation_aborted) {
@@ -652,6 +920,11 @@ public:
     void async_accept(transport_con_ptr tcon, accept_handler callback,
         lib::error_code & ec)
     {
+        // Several accepts may be re-armed at once from handlers running on
+        // different threads, the acceptor itself is not thread safe. Each
+        // shard's acceptor has its own lock, so shards do not contend.
+        lib::lock_guard<lib::mutex> lock(get_accept_lock(tcon));
+
         if (m_state != LISTENING) {
             m_elog->write(log::elevel::library,
                 "asio::async_accept called from the wrong state");
@@ -662,22 +935,26 @@ public:
 
         m_alog->write(log::alevel::devel, "asio::async_accept");
 
-        if (config::enable_multithreading) {
-            m_acceptor->async_accept(
+        acceptor_ptr acceptor = get_acceptor(tcon);
+
+        if (tcon->get_strand()) {
+            acceptor->async_accept(
                 tcon->get_raw_socket(),
                 tcon->get_strand()->wrap(lib::bind(
                     &type::handle_accept,
                     this,
+                    tcon,
                     callback,
                     lib::placeholders::_1
                 ))
             );
         } else {
-            m_acceptor->async_accept(
+            acceptor->async_accept(
                 tcon->get_raw_socket(),
                 lib::bind(
                     &type::handle_accept,
                     this,
+                    tcon,
                     callback,
                     lib::placeholders::_1
                 )
@@ -713,8 +990,8 @@ protected:
         m_elog = e;
     }
 
-    void handle_accept(accept_handler callback, boost::system::error_code const
-        & boost_ec)
+    void handle_accept(transport_con_ptr tcon, accept_handler callback,
+        boost::system::error_code const & boost_ec)
     {
         lib::error_code ret_ec;
 
@@ -723,16 +1000,66 @@ protected:
         if (boost_ec) {
             log_err(log::elevel::devel,"asio handle_accept",boost_ec);
             ret_ec = make_error_code(error::pass_through);
+        } else if (!admit(tcon)) {
+            // Reset the socket and accept the next one into the same
+            // connection, nothing above the transport sees the rejection.
+            ++m_rejected_accepts;
+            boost::system::error_code ignored;
+            tcon->get_raw_socket().set_option(
+                boost::asio::socket_base::linger(true,0),ignored);
+            tcon->get_raw_socket().close(ignored);
+
+            async_accept(tcon,callback,ret_ec);
+            if (!ret_ec) {
+                return;
+            }
         }
 
         callback(ret_ec);
     }
 
+    /// Run admission control on a newly accepted socket
+    bool admit(transport_con_ptr tcon) {
+        if (!m_admission_handler && !m_accept_limiter.enabled()) {
+            return true;
+        }
+
+        boost::system::error_code ec;
+        boost::asio::ip::tcp::endpoint ep =
+            tcon->get_raw_socket().remote_endpoint(ec);
+        if (ec) {
+            // the peer is already gone
+            return false;
+        }
+
+        if (m_admission_handler && !m_admission_handler(ep)) {
+            m_alog->write(log::alevel::devel,
+                "asio::handle_accept rejected by admission handler");
+            return false;
+        }
+
+        if (!m_accept_limiter.admit(ep.address(),lib::now_ms())) {
+            m_alog->write(log::alevel::devel,
+                "asio::handle_accept rejected by accept rate limit");
+            return false;
+        }
+        return true;
+    }
+
     /// Initiate a new connection
     // TODO: there have to be some more failure conditions here
     void async_connect(transport_con_ptr tcon, uri_ptr u, connect_handler cb) {
         using namespace boost::asio::ip;
 
+        // Sharded connections have no strand, the shared resolver and the
+        // connection's timers would race on different shard threads
+        if (!m_shards.empty()) {
+            m_elog->write(log::elevel::library,
+                "asio::async_connect called in sharded mode");
+            cb(make_error_code(error::sharded_connect));
+            return;
+        }
+
         // Create a resolver
         if (!m_resolver) {
             m_resolver.reset(new boost::asio::ip::tcp::resolver(*m_io_service));
@@ -785,7 +1112,7 @@ protected:
             )
         );
 
-        if (config::enable_multithreading) {
+        if (tcon->get_strand()) {
             m_resolver->async_resolve(
                 query,
                 tcon->get_strand()->wrap(lib::bind(
@@ -884,7 +1211,7 @@ protected:
             )
         );
 
-        if (config::enable_multithreading) {
+        if (tcon->get_strand()) {
             boost::asio::async_connect(
                 tcon->get_raw_socket(),
                 iterator,
@@ -986,7 +1313,13 @@ protected:
 
         lib::error_code ec;
 
-        ec = tcon->init_asio(m_io_service);
+        if (m_shards.empty()) {
+            ec = tcon->init_asio(m_io_service,config::enable_multithreading,
+                m_timer_wheel);
+        } else {
+            shard & s = m_shards[select_shard()];
+            ec = tcon->init_asio(s.io_service,false,s.timer_wheel);
+        }
         if (ec) {return ec;}
 
         tcon->set_tcp_pre_init_handler(m_tcp_pre_init_handler);
@@ -995,6 +1328,110 @@ protected:
         return lib::error_code();
     }
 private:
+    /// Create the timer wheel for an io_service, if the config uses them
+    timer_wheel_ptr make_timer_wheel(boost::asio::io_service & service) {
+        if (!config::enable_timer_wheel) {
+            return timer_wheel_ptr();
+        }
+        return timer_wheel_ptr(new timer_wheel(service,
+            config::timer_wheel_resolution,config::timer_wheel_slots));
+    }
+
+    /// Start a timer on its own deadline_timer
+    void start_timer(lib::shared_ptr<boost::asio::deadline_timer> & new_timer,
+        long duration, timer_handler callback)
+    {
+        new_timer.reset(
+            new boost::asio::deadline_timer(
+                *m_io_service,
+                boost::posix_time::milliseconds(duration)
+            )
+        );
+
+        new_timer->async_wait(
+            lib::bind(
+                &type::handle_timer,
+                this,
+                new_timer,
+                callback,
+                lib::placeholders::_1
+            )
+        );
+    }
+
+    /// Start a timer on the shared timer wheel
+    void start_timer(timer_wheel::timer_ptr & new_timer, long duration,
+        timer_handler callback)
+    {
+        new_timer = m_timer_wheel->set_timer(duration,callback);
+    }
+
+    /// Bind and listen on an open or closed acceptor
+    void open_acceptor(boost::asio::ip::tcp::acceptor & a,
+        boost::asio::ip::tcp::endpoint const & ep)
+    {
+        if (!a.is_open()) {
+            a.open(ep.protocol());
+        }
+        a.set_option(boost::asio::socket_base::reuse_address(true));
+        a.bind(ep);
+        if (m_listen_backlog == 0) {
+            a.listen();
+        } else {
+            a.listen(m_listen_backlog);
+        }
+    }
+
+    /// Get the acceptor on the same io_service as a connection
+    acceptor_ptr get_acceptor(transport_con_ptr tcon) {
+        for (size_t i = 0; i < m_shards.size(); i++) {
+            if (m_shards[i].io_service == tcon->get_io_service()) {
+                return m_shards[i].acceptor;
+            }
+        }
+        return m_acceptor;
+    }
+
+    /// Get the lock that serializes accepts on a connection's acceptor
+    lib::mutex & get_accept_lock(transport_con_ptr tcon) {
+        for (size_t i = 0; i < m_shards.size(); i++) {
+            if (m_shards[i].io_service == tcon->get_io_service()) {
+                return *m_shards[i].accept_lock;
+            }
+        }
+        return m_accept_lock;
+    }
+
+    /// Pick the shard for a new connection
+    /**
+     * The shard whose thread is calling, otherwise the next one round robin.
+     */
+    size_t select_shard() {
+        lib::lock_guard<lib::mutex> lock(m_shard_lock);
+
+        lib::thread::id id = lib::this_thread::get_id();
+        for (size_t i = 0; i < m_shards.size(); i++) {
+            if (m_shards[i].running && m_shards[i].thread == id) {
+                return i;
+            }
+        }
+        return m_next_shard++ % m_shards.size();
+    }
+
+    /// Run one shard's io_service on the calling thread
+    void run_shard(size_t i, std::size_t * count) {
+        {
+            lib::lock_guard<lib::mutex> lock(m_shard_lock);
+            m_shards[i].thread = lib::this_thread::get_id();
+            m_shards[i].running = true;
+        }
+
+        *count = m_shards[i].io_service->run();
+
+        lib::lock_guard<lib::mutex> lock(m_shard_lock);
+        m_shards[i].running = false;
+    }
+
     /// Convenience method for logging the code and message for an error_code
     template <typename error_type>
     void log_err(log::level l, char const * msg, error_type const & ec) {
@@ -1009,17 +1446,44 @@ private:
         LISTENING = 2
     };
 
+    /// Resources belonging to one io_service in sharded mode
+    struct shard {
+        shard() : io_service(NULL), running(false) {}
+
+        io_service_ptr      io_service;
+        acceptor_ptr        acceptor;
+        mutex_ptr           accept_lock;
+        timer_wheel_ptr     timer_wheel;
+        work_ptr            work;
+        lib::thread::id     thread;
+        bool                running;
+    };
+
     // Handlers
     tcp_init_handler    m_tcp_pre_init_handler;
     tcp_init_handler    m_tcp_post_init_handler;
+    admission_handler   m_admission_handler;
 
     // Network Resources
     io_service_ptr      m_io_service;
     bool                m_external_io_service;
     acceptor_ptr        m_acceptor;
     resolver_ptr        m_resolver;
+    timer_wheel_ptr     m_timer_wheel;
     work_ptr            m_work;
 
+    // Sharded mode, empty unless initialized with init_asio_sharded
+    std::vector<shard>  m_shards;
+    size_t              m_next_shard;
+    lib::mutex          m_shard_lock;
+
+    // Serializes async_accept calls on m_acceptor, shards have their own
+    lib::mutex          m_accept_lock;
+
+    // Admission control
+    accept_limiter      m_accept_limiter;
+    lib::atomic<uint64_t> m_rejected_accepts;
+
     // Network constants
     int                 m_listen_backlog;
 
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_ASIO_TIMER_WHEEL_HPP
+#define WEBSOCKETPP_TRANSPORT_ASIO_TIMER_WHEEL_HPP
+
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/transport/base/connection.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <list>
+#include <vector>
+
+namespace websocketpp {
+namespace transport {
+namespace asio {
+
+class timer_wheel;
+
+/// Handle to a timer scheduled on a timer_wheel
+/**
+ * Provides the subset of the boost::asio::deadline_timer interface that the
+ * asio transport uses, so either may be used as the transport's timer type.
+ */
+class wheel_timer {
+public:
+    typedef lib::shared_ptr<wheel_timer> ptr;
+
+    /// Cancel the timer
+    /**
+     * If the timer is still pending its handler is invoked asynchronously with
+     * transport::error::operation_aborted. Cancelling a timer that has already
+     * expired or been cancelled has no effect.
+     */
+    void cancel();
+
+    /// Time remaining until the timer's deadline
+    /**
+     * Negative once the deadline has passed.
+     */
+    boost::posix_time::time_duration expires_from_now() const {
+        return m_deadline - boost::posix_time::microsec_clock::universal_time();
+    }
+private:
+    friend class timer_wheel;
+
+    typedef std::list<ptr> slot_type;
+
+    enum state {
+        PENDING,
+        EXPIRED,
+        CANCELLED
+    };
+
+    wheel_timer(lib::weak_ptr<timer_wheel> wheel, timer_handler handler,
+        boost::posix_time::ptime deadline)
+      : m_wheel(wheel)
+      , m_handler(handler)
+      , m_deadline(deadline)
+      , m_rounds(0)
+      , m_slot(0)
+      , m_state(PENDING) {}
+
+    lib::weak_ptr<timer_wheel>  m_wheel;
+    timer_handler               m_handler;
+    boost::posix_time::ptime    m_deadline;
+    size_t                      m_rounds;
+    size_t                      m_slot;
+    slot_type::iterator         m_pos;
+    state                       m_state;
+};
+
+/// Hashed timer wheel driven by a single asio timer
+/**
+ * Timers are stored in a ring of slots, each covering one tick of
+ * `resolution` milliseconds. Timers further away than one revolution carry a
+ * count of remaining rounds. Scheduling and cancelling are constant time and
+ * allocate no asio objects. The underlying deadline_timer only runs while
+ * there are pending timers, so an idle wheel does not keep its io_service
+ * from running out of work.
+ *
+ * Expiry is rounded up to the next tick. Handlers are invoked from the
+ * io_service running the wheel, and may be called from any thread that runs
+ * it, so the wheel is internally synchronized.
+ */
+class timer_wheel : public lib::enable_shared_from_this<timer_wheel> {
+public:
+    typedef lib::shared_ptr<timer_wheel> ptr;
+    typedef wheel_timer::ptr timer_ptr;
+
+    /// Construct a timer wheel
+    /**
+     * @param service The io_service to run the wheel's timer on
+     * @param resolution Length of one tick in milliseconds
+     * @param slots Number of ticks in one revolution of the wheel
+     */
+    timer_wheel(boost::asio::io_service & service, long resolution,
+        size_t slots)
+      : m_service(service)
+      , m_timer(service)
+      , m_resolution(resolution > 0 ? resolution : 1)
+      , m_slots(slots > 0 ? slots : 1)
+      , m_wheel(m_slots)
+      , m_cursor(0)
+      , m_pending(0)
+      , m_ticking(false) {}
+
+    /// Schedule a handler to be called after a period of time
+    /**
+     * @param duration Length of time to wait in milliseconds
+     * @param handler The function to call when the timer expires or is
+     * cancelled
+     * @return A handle that can be used to cancel the timer
+     */
+    timer_ptr set_timer(long duration, timer_handler handler) {
+        using boost::posix_time::milliseconds;
+
+        boost::posix_time::ptime now =
+            boost::posix_time::microsec_clock::universal_time();
+
+        timer_ptr t(new wheel_timer(shared_from_this(), handler,
+            now + milliseconds(duration)));
+
+        lib::lock_guard<lib::mutex> lock(m_lock);
+
+        if (!m_ticking) {
+            m_next_tick = now + milliseconds(m_resolution);
+            m_timer.expires_at(m_next_tick);
+            m_timer.async_wait(lib::bind(
+                &timer_wheel::handle_tick,
+                shared_from_this(),
+                lib::placeholders::_1
+            ));
+            m_ticking = true;
+        }
+
+        // the first tick at or after the deadline, counting the upcoming tick
+        // as tick 1.
+        long until = (t->m_deadline - m_next_tick).total_milliseconds();
+        size_t ticks = 1;
+        if (until > 0) {
+            ticks += (until + m_resolution - 1) / m_resolution;
+        }
+
+        t->m_slot = (m_cursor + ticks) % m_slots;
+        t->m_rounds = (ticks - 1) / m_slots;
+
+        m_wheel[t->m_slot].push_front(t);
+        t->m_pos = m_wheel[t->m_slot].begin();
+        m_pending++;
+
+        return t;
+    }
+
+    /// Get the number of pending timers
+    size_t get_pending() const {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return m_pending;
+    }
+private:
+    friend class wheel_timer;
+
+    /// Remove a pending timer and queue its handler with operation_aborted
+    void cancel(wheel_timer & t) {
+        timer_handler handler;
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            if (t.m_state != wheel_timer::PENDING) {
+                return;
+            }
+            t.m_state = wheel_timer::CANCELLED;
+            handler.swap(t.m_handler);
+
+            m_wheel[t.m_slot].erase(t.m_pos);
+            m_pending--;
+        }
+
+        m_service.post(lib::bind(handler, transport::error::make_error_code(
+            transport::error::operation_aborted)));
+    }
+
+    void handle_tick(boost::system::error_code const & ec) {
+        if (ec) {
+            return;
+        }
+
+        std::vector<timer_handler> expired;
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+
+            m_cursor = (m_cursor + 1) % m_slots;
+            wheel_timer::slot_type & slot = m_wheel[m_cursor];
+
+            wheel_timer::slot_type::iterator it = slot.begin();
+            while (it != slot.end()) {
+                if ((*it)->m_rounds > 0) {
+                    (*it)->m_rounds--;
+                    ++it;
+                    continue;
+                }
+                (*it)->m_state = wheel_timer::EXPIRED;
+                expired.push_back(timer_handler());
+                expired.back().swap((*it)->m_handler);
+                it = slot.erase(it);
+                m_pending--;
+            }
+
+            if (m_pending > 0) {
+                m_next_tick += boost::posix_time::milliseconds(m_resolution);
+                m_timer.expires_at(m_next_tick);
+                m_timer.async_wait(lib::bind(
+                    &timer_wheel::handle_tick,
+                    shared_from_this(),
+                    lib::placeholders::_1
+                ));
+            } else {
+                m_ticking = false;
+            }
+        }
+
+        for (size_t i = 0; i < expired.size(); i++) {
+            expired[i](lib::error_code());
+        }
+    }
+
+    boost::asio::io_service &       m_service;
+    boost::asio::deadline_timer     m_timer;
+    long const                      m_resolution;
+    size_t const                    m_slots;
+    std::vector<wheel_timer::slot_type> m_wheel;
+    size_t                          m_cursor;
+    size_t                          m_pending;
+    bool                            m_ticking;
+    boost::posix_time::ptime        m_next_tick;
+    mutable lib::mutex              m_lock;
+};
+
+inline void wheel_timer::cancel() {
+    timer_wheel::ptr wheel = m_wheel.lock();
+    if (wheel) {
+        wheel->cancel(*this);
+    }
+}
+
+} // namespace asio
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_ASIO_TIMER_WHEEL_HPP
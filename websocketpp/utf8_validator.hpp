@@ -29,8 +29,12 @@
 #ifndef UTF8_VALIDATOR_HPP
 #define UTF8_VALIDATOR_HPP
 
+#include <websocketpp/common/cpu.hpp>
 #include <websocketpp/common/stdint.hpp>
 
+#include <cstring>
+#include <string>
+
 namespace websocketpp {
 namespace utf8_validator {
 
@@ -75,6 +79,296 @@ inline uint32_t decode(uint32_t * state, uint32_t * codep, uint8_t byte) {
   return *state;
 }
 
+namespace simd {
+
+/// Signature shared by all buffer validation kernels
+/**
+ * A kernel advances the DFA state and codepoint over the whole buffer and
+ * leaves them exactly as the byte by byte decoder would have, so validation
+ * can resume with the next fragment of the same message.
+ *
+ * @return false if the input was rejected
+ */
+typedef bool (*utf8_kernel)(uint8_t const *, size_t, uint32_t &, uint32_t &);
+
+/// Length of the all-ASCII prefix of a buffer, one word per step
+inline size_t ascii_prefix_portable(uint8_t const * data, size_t length) {
+    size_t const high_bits = ~static_cast<size_t>(0) / 0xFF * 0x80;
+
+    size_t i = 0;
+    for (; i + sizeof(size_t) <= length; i += sizeof(size_t)) {
+        size_t word;
+        std::memcpy(&word,data+i,sizeof(size_t));
+        if (word & high_bits) {
+            break;
+        }
+    }
+    while (i < length && data[i] < 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+/// Run the DFA over the next multibyte run
+/**
+ * Consumes at least one byte starting at index i and stops at the first
+ * ASCII byte reached in the accept state or at the end of the buffer.
+ *
+ * @return false if the input was rejected
+ */
+inline bool dfa_multibyte_run(uint8_t const * data, size_t length, size_t & i,
+    uint32_t & state, uint32_t & codepoint)
+{
+    do {
+        if (decode(&state,&codepoint,data[i++]) == utf8_reject) {
+            return false;
+        }
+    } while (i < length && (state != utf8_accept || data[i] >= 0x80));
+    return true;
+}
+
+/// Portable kernel, skips ASCII a word at a time and runs the DFA otherwise
+inline bool validate_portable(uint8_t const * data, size_t length,
+    uint32_t & state, uint32_t & codepoint)
+{
+    size_t i = 0;
+    while (i < length) {
+        if (state == utf8_accept) {
+            i += ascii_prefix_portable(data+i,length-i);
+            if (i == length) {
+                break;
+            }
+        }
+        if (!dfa_multibyte_run(data,length,i,state,codepoint)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef WEBSOCKETPP_X86_SIMD
+/// Validate whole 32 byte blocks with AVX2 lookup tables
+/**
+ * Classifies each byte against its predecessors with three nibble lookups
+ * (Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per
+ * Byte"). All-ASCII blocks only check that the previous block did not end in
+ * the middle of a sequence. Must be entered at a codepoint boundary.
+ *
+ * @param [in] data Buffer to validate
+ * @param [in] length Length of data
+ * @param [out] valid Set to false if an error was found in the blocks
+ * @return Number of bytes validated. Always ends on a codepoint boundary: a
+ * sequence left open by the last block is backed out so the caller can
+ * finish it with the DFA.
+ */
+WEBSOCKETPP_TARGET_AVX2
+inline size_t validate_blocks_avx2(uint8_t const * data, size_t length,
+    bool & valid)
+{
+    // error classes, one bit each, for a (previous byte, current byte) pair
+    uint8_t const too_short = 1<<0;  // 11______ 0_______, 11______ 11______
+    uint8_t const too_long = 1<<1;   // 0_______ 10______
+    uint8_t const overlong_3 = 1<<2; // 11100000 100_____
+    uint8_t const too_large = 1<<3;  // 11110100 1001____ and above
+    uint8_t const surrogate = 1<<4;  // 11101101 101_____
+    uint8_t const overlong_2 = 1<<5; // 1100000_ 10______
+    uint8_t const too_large_1000 = 1<<6; // 11110101 1000____ and above
+    uint8_t const overlong_4 = 1<<6; // 11110000 1000____
+    uint8_t const two_conts = 1<<7;  // 10______ 10______
+    uint8_t const carry = too_short | too_long | two_conts;
+
+    __m256i const byte_1_high_table = _mm256_setr_epi8(
+        too_long, too_long, too_long, too_long,
+        too_long, too_long, too_long, too_long,
+        two_conts, two_conts, two_conts, two_conts,
+        too_short | overlong_2,
+        too_short,
+        too_short | overlong_3 | surrogate,
+        too_short | too_large | too_large_1000 | overlong_4,
+        too_long, too_long, too_long, too_long,
+        too_long, too_long, too_long, too_long,
+        two_conts, two_conts, two_conts, two_conts,
+        too_short | overlong_2,
+        too_short,
+        too_short | overlong_3 | surrogate,
+        too_short | too_large | too_large_1000 | overlong_4
+    );
+    __m256i const byte_1_low_table = _mm256_setr_epi8(
+        carry | overlong_3 | overlong_2 | overlong_4,
+        carry | overlong_2,
+        carry,
+        carry,
+        carry | too_large,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000 | surrogate,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | overlong_3 | overlong_2 | overlong_4,
+        carry | overlong_2,
+        carry,
+        carry,
+        carry | too_large,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000 | surrogate,
+        carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000
+    );
+    uint8_t const cont_1000 = too_long | overlong_2 | two_conts | overlong_3
+        | too_large_1000 | overlong_4;
+    uint8_t const cont_1001 = too_long | overlong_2 | two_conts | overlong_3
+        | too_large;
+    uint8_t const cont_101 = too_long | overlong_2 | two_conts | surrogate
+        | too_large;
+    __m256i const byte_2_high_table = _mm256_setr_epi8(
+        too_short, too_short, too_short, too_short,
+        too_short, too_short, too_short, too_short,
+        cont_1000, cont_1001, cont_101, cont_101,
+        too_short, too_short, too_short, too_short,
+        too_short, too_short, too_short, too_short,
+        too_short, too_short, too_short, too_short,
+        cont_1000, cont_1001, cont_101, cont_101,
+        too_short, too_short, too_short, too_short
+    );
+
+    // a block ending in any of the last three positions with a lead byte that
+    // needs more continuation bytes than remain is incomplete
+    __m256i const incomplete_max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xf0-1),
+        static_cast<char>(0xe0-1),
+        static_cast<char>(0xc0-1)
+    );
+    __m256i const low_nibble = _mm256_set1_epi8(0x0F);
+    __m256i const third_byte = _mm256_set1_epi8(static_cast<char>(0xe0-0x80));
+    __m256i const fourth_byte = _mm256_set1_epi8(static_cast<char>(0xf0-0x80));
+    __m256i const high_bit = _mm256_set1_epi8(static_cast<char>(0x80));
+
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    __m256i error = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i input = _mm256_loadu_si256(
+            reinterpret_cast<__m256i const *>(data+i));
+
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error,prev_incomplete);
+            prev_input = input;
+            continue;
+        }
+
+        // the input shifted back by one, two and three bytes, pulling the
+        // tail of the previous block in
+        __m256i carried = _mm256_permute2x128_si256(prev_input,input,0x21);
+        __m256i prev1 = _mm256_alignr_epi8(input,carried,15);
+        __m256i prev2 = _mm256_alignr_epi8(input,carried,14);
+        __m256i prev3 = _mm256_alignr_epi8(input,carried,13);
+
+        __m256i byte_1_high = _mm256_shuffle_epi8(byte_1_high_table,
+            _mm256_and_si256(_mm256_srli_epi16(prev1,4),low_nibble));
+        __m256i byte_1_low = _mm256_shuffle_epi8(byte_1_low_table,
+            _mm256_and_si256(prev1,low_nibble));
+        __m256i byte_2_high = _mm256_shuffle_epi8(byte_2_high_table,
+            _mm256_and_si256(_mm256_srli_epi16(input,4),low_nibble));
+        __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high,
+            byte_1_low),byte_2_high);
+
+        // third and fourth bytes of a sequence must be continuations
+        __m256i must_be_cont = _mm256_and_si256(_mm256_or_si256(
+            _mm256_subs_epu8(prev2,third_byte),
+            _mm256_subs_epu8(prev3,fourth_byte)),high_bit);
+
+        error = _mm256_or_si256(error,_mm256_xor_si256(must_be_cont,special));
+        prev_incomplete = _mm256_subs_epu8(input,incomplete_max);
+        prev_input = input;
+    }
+
+    if (!_mm256_testz_si256(error,error)) {
+        valid = false;
+        return i;
+    }
+
+    // back out a sequence left open by the last block
+    for (size_t k = 1; k <= 3 && k <= i; ++k) {
+        uint8_t b = data[i-k];
+        if (b < 0x80) {
+            break;
+        } else if (b >= 0xC0) {
+            size_t needed = (b >= 0xF0 ? 4 : (b >= 0xE0 ? 3 : 2));
+            if (needed > k) {
+                i -= k;
+            }
+            break;
+        }
+    }
+    return i;
+}
+
+/// AVX2 kernel, validates ASCII and multibyte text 32 bytes per step
+WEBSOCKETPP_TARGET_AVX2
+inline bool validate_avx2(uint8_t const * data, size_t length,
+    uint32_t & state, uint32_t & codepoint)
+{
+    size_t i = 0;
+
+    // finish a sequence carried over from the previous fragment
+    while (i < length && state != utf8_accept) {
+        if (decode(&state,&codepoint,data[i++]) == utf8_reject) {
+            return false;
+        }
+    }
+
+    if (length - i >= 32) {
+        bool valid = true;
+        i += validate_blocks_avx2(data+i,length-i,valid);
+        if (!valid) {
+            state = utf8_reject;
+            return false;
+        }
+    }
+
+    return validate_portable(data+i,length-i,state,codepoint);
+}
+#endif // WEBSOCKETPP_X86_SIMD
+
+/// Pick the fastest kernel supported by the running CPU
+inline utf8_kernel select_utf8_kernel() {
+#ifdef WEBSOCKETPP_X86_SIMD
+    lib::cpu::features const & f = lib::cpu::get_features();
+    if (f.avx2) {
+        return &validate_avx2;
+    }
+#endif
+    return &validate_portable;
+}
+
+/// Returns the kernel used by validator::decode, selected once per process
+inline utf8_kernel get_utf8_kernel() {
+    static utf8_kernel const kernel = select_utf8_kernel();
+    return kernel;
+}
+
+/// Inputs shorter than this skip the dispatch and run the DFA directly
+static size_t const min_vector_length = 16;
+
+} // namespace simd
+
 /// Provides streaming UTF8 validation functionality
 class validator {
 public:
@@ -115,6 +409,31 @@ public:
         return true;
     }
 
+    /// Advance validator state with a contiguous buffer
+    /**
+     * Buffers of at least simd::min_vector_length bytes are validated with
+     * the best vector kernel the running CPU supports. The validator state is
+     * carried between calls exactly as with the iterator version, so a
+     * message may be fed in arbitrarily split fragments.
+     *
+     * @param data Pointer to the start of the input
+     * @param length Number of bytes to validate
+     * @return Whether or not decoding the bytes resulted in a validation error.
+     */
+    bool decode (uint8_t const * data, size_t length) {
+        if (length >= simd::min_vector_length) {
+            return simd::get_utf8_kernel()(data,length,m_state,m_codepoint);
+        }
+        for (size_t i = 0; i < length; ++i) {
+            if (utf8_validator::decode(&m_state,&m_codepoint,data[i])
+                == utf8_reject)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
     /// Return whether the input sequence ended on a valid utf8 codepoint
     /**
      * @return Whether or not the input sequence ended on a valid codepoint.
@@ -140,7 +459,7 @@ private:
  */
 inline bool validate(std::string const & s) {
     validator v;
-    if (!v.decode(s.begin(),s.end())) {
+    if (!v.decode(reinterpret_cast<uint8_t const *>(s.data()),s.size())) {
         return false;
     }
     return v.complete();